@@ -0,0 +1,393 @@
+/*
+ * Baking benchmark: bakes a ttf (and optionally a bdf) over several ranges.
+ *
+ * Build (ftb has to be on the include path):
+ *
+ *   c++ -O2 -std=c++17 -I.. -I<dir containing ftb> bake_bench.cpp -o bake_bench -lpthread
+ *
+ * Usage:
+ *
+ *   bake_bench [--min-time s] [--filter str] [--json] [--no-counters] font.ttf [font.bdf]
+ *
+ * First checks that supersampled bakes put the glyphs where a bake without
+ * supersampling does: at 2x and 4x the ink box of every ASCII glyph (float
+ * and fixed point rasterizer, at 24 and 300 px) may differ from the 1x one
+ * by at most a pixel on each side. Then that 300 px glyphs rasterized in
+ * strips match whole ones at 2x and 4x: the fixed point rasterizer bit for
+ * bit, stb_truetype's up to a few pixels at the threshold per glyph. And
+ * that the glyph metrics baked at 1x, 2x and 4x describe the pixels in the
+ * table: every set pixel inside the glyph's ink box, give or take a pixel,
+ * and the boxes and advances within a pixel of the 1x ones. Exits with 1 if
+ * any of them does not hold.
+ *
+ * Every case runs in its own child process, so peak_rss is the high-water
+ * mark of that case alone. Where perf_event_open is allowed, the hardware
+ * counters (cycles, instructions, branch and cache misses) are reported per
+ * glyph, summed over all threads of the bake.
+ */
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#define PIXEL_FONT_BAKER_IMPL
+#include "../pixel_font_baker.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct Ttf_Case {
+    const char* name;
+    u16 height;
+    u32 cp_start;
+    u32 cp_end;
+    bool threaded;
+    bool stream;
+    u8  supersample;
+    u32 strip_bytes;
+};
+
+// NOTE: The h300 cases are signage sized glyphs, supersampled 4 times: whole
+//   gray bitmaps of about 1.2 MB a glyph against 32 KiB strips.
+static const Ttf_Case ttf_cases[] = {
+    { "bake.ttf.ascii.h16",             16, 0x20, 0x7e,   false, false, 1, 0 },
+    { "bake.ttf.latin.h24",             24, 0x20, 0x24f,  false, false, 1, 0 },
+    { "bake.ttf.bmp.h16",               16, 0x0,  0xffff, false, false, 1, 0 },
+    { "bake.ttf.bmp.h16.threaded",      16, 0x0,  0xffff, true,  false, 1, 0 },
+    { "bake.ttf.bmp.h16.stream",        16, 0x0,  0xffff, false, true,  1, 0 },
+    { "bake.ttf.bmp.h16.threaded_stream", 16, 0x0, 0xffff, true, true,  1, 0 },
+    { "bake.ttf.ascii.h300.ss4",        300, 0x20, 0x7e,  false, false, 4, 0 },
+    { "bake.ttf.ascii.h300.ss4.strips", 300, 0x20, 0x7e,  false, false, 4, 32 << 10 },
+    { "bake.ttf.ascii.h300.ss4.threaded",        300, 0x20, 0x7e, true, false, 4, 0 },
+    { "bake.ttf.ascii.h300.ss4.threaded_strips", 300, 0x20, 0x7e, true, false, 4, 32 << 10 },
+};
+
+//
+//  Checks
+//
+
+static u32 failures = 0;
+
+struct Ink_Box {
+    s32 x0, y0, x1, y1; // x1, y1 exclusive, empty if x0 >= x1
+};
+
+static Ink_Box ink_box(const Pixel_Font* font, u32 cp) {
+    Ink_Box box = { font->char_px_width, font->char_px_height, 0, 0 };
+    const u8* glyph = font->table + (u64)(cp - font->unicode_cp_start) * font->bytes_per_glyph;
+    for (s32 y = 0; y < font->char_px_height; ++y) {
+        for (s32 x = 0; x < font->char_px_width; ++x) {
+            if (glyph[y * font->bytes_per_line + x / 8] & (0x80 >> (x % 8))) {
+                box.x0 = std::min(box.x0, x);
+                box.y0 = std::min(box.y0, y);
+                box.x1 = std::max(box.x1, x + 1);
+                box.y1 = std::max(box.y1, y + 1);
+            }
+        }
+    }
+    return box;
+}
+
+static bool boxes_match(Ink_Box a, Ink_Box b, s32 tolerance) {
+    return abs(a.x0 - b.x0) <= tolerance && abs(a.y0 - b.y0) <= tolerance &&
+           abs(a.x1 - b.x1) <= tolerance && abs(a.y1 - b.y1) <= tolerance;
+}
+
+static void check_supersample_placement(const char* font_path) {
+    for (u16 height : { 24, 300 }) {
+        for (bool fixed : { false, true }) {
+            Pixel_Font_Bake_Options options;
+            options.fixed_point_rasterizer = fixed;
+
+            Pixel_Font reference;
+            if (create_pixel_font_from_ttf(font_path, height, 0x21, 0x7e, 128, 1, &reference, &options) !=
+                Pixel_Font_Baker_Error::SUCCESS)
+            {
+                fprintf(stderr, "PLACEMENT %s: could not bake at 1x\n", font_path);
+                ++failures;
+                return;
+            }
+
+            for (u8 supersample : { 2, 4 }) {
+                Pixel_Font font;
+                if (create_pixel_font_from_ttf(font_path, height, 0x21, 0x7e, 128, supersample, &font, &options) !=
+                    Pixel_Font_Baker_Error::SUCCESS)
+                {
+                    fprintf(stderr, "PLACEMENT %s: could not bake at %ux\n", font_path, supersample);
+                    ++failures;
+                    continue;
+                }
+
+                for (u32 cp = 0x21; cp <= 0x7e; ++cp) {
+                    Ink_Box a = ink_box(&reference, cp);
+                    Ink_Box b = ink_box(&font, cp);
+                    if (!boxes_match(a, b, 1) && failures++ < 16) {
+                        fprintf(stderr, "PLACEMENT U+%04X %upx %ux %s: ink (%d,%d)-(%d,%d), at 1x (%d,%d)-(%d,%d)\n",
+                                cp, height, supersample, fixed ? "fixed" : "float",
+                                b.x0, b.y0, b.x1, b.y1, a.x0, a.y0, a.x1, a.y1);
+                    }
+                }
+                destroy_pixel_font(&font);
+            }
+            destroy_pixel_font(&reference);
+        }
+    }
+}
+
+// NOTE: stb_truetype restarts its edges at every strip, which may flip a
+//   pixel whose coverage sits right at the threshold, see
+//   Pixel_Font_Bake_Options::raster_strip_bytes.
+static const u32 float_strip_tolerance_bits = 4;
+
+static void check_strip_bakes(const char* font_path) {
+    for (u8 supersample : { 2, 4 }) {
+        for (bool fixed : { false, true }) {
+            Pixel_Font_Bake_Options options;
+            options.fixed_point_rasterizer = fixed;
+
+            Pixel_Font whole;
+            if (create_pixel_font_from_ttf(font_path, 300, 0x21, 0x7e, 128, supersample, &whole, &options) !=
+                Pixel_Font_Baker_Error::SUCCESS)
+            {
+                fprintf(stderr, "STRIPS %s: could not bake whole glyphs at %ux\n", font_path, supersample);
+                ++failures;
+                return;
+            }
+
+            for (u32 strip_bytes : { 4u << 10, 32u << 10 }) {
+                options.raster_strip_bytes = strip_bytes;
+
+                Pixel_Font font;
+                if (create_pixel_font_from_ttf(font_path, 300, 0x21, 0x7e, 128, supersample, &font, &options) !=
+                    Pixel_Font_Baker_Error::SUCCESS)
+                {
+                    fprintf(stderr, "STRIPS %s: could not bake in %u byte strips at %ux\n",
+                            font_path, strip_bytes, supersample);
+                    ++failures;
+                    continue;
+                }
+
+                for (u32 cp = 0x21; cp <= 0x7e; ++cp) {
+                    const u8* a = whole.table + (u64)(cp - whole.unicode_cp_start) * whole.bytes_per_glyph;
+                    const u8* b = font.table + (u64)(cp - font.unicode_cp_start) * font.bytes_per_glyph;
+                    u32 bits = 0;
+                    for (u32 i = 0; i < font.bytes_per_glyph; ++i)
+                        bits += __builtin_popcount(a[i] ^ b[i]);
+                    if (bits > (fixed ? 0 : float_strip_tolerance_bits) && failures++ < 16) {
+                        fprintf(stderr, "STRIPS U+%04X %ux %s, %u byte strips: %u pixels differ from the whole glyph\n",
+                                cp, supersample, fixed ? "fixed" : "float", strip_bytes, bits);
+                    }
+                }
+                destroy_pixel_font(&font);
+            }
+            destroy_pixel_font(&whole);
+        }
+    }
+}
+
+static Ink_Box metrics_box(const Pixel_Font* font, u32 cp) {
+    const Pixel_Font_Glyph_Metrics* m = &font->glyph_metrics[cp - font->unicode_cp_start];
+    s32 x = m->ink_x - font->cell_x;
+    s32 y = font->baseline + m->ink_y;
+    return { x, y, x + m->ink_width, y + m->ink_height };
+}
+
+// NOTE: The metrics give the outline's pixel box, which thin strokes and
+//   serifs below the threshold do not fill, so the pixels only have to lie
+//   inside it (give or take a pixel). That it is not too large is checked
+//   against the metrics baked without supersampling.
+static void check_glyph_metrics(const char* font_path) {
+    for (u16 height : { 16, 48 }) {
+        for (bool fixed : { false, true }) {
+            Pixel_Font_Bake_Options options;
+            options.fixed_point_rasterizer = fixed;
+            options.glyph_metrics          = true;
+
+            Pixel_Font reference;
+            if (create_pixel_font_from_ttf(font_path, height, 0x21, 0x7e, 128, 1, &reference, &options) !=
+                Pixel_Font_Baker_Error::SUCCESS)
+            {
+                fprintf(stderr, "METRICS %s: could not bake at 1x\n", font_path);
+                ++failures;
+                return;
+            }
+
+            for (u8 supersample : { 1, 2, 4 }) {
+                Pixel_Font font;
+                if (create_pixel_font_from_ttf(font_path, height, 0x21, 0x7e, 128, supersample, &font, &options) !=
+                    Pixel_Font_Baker_Error::SUCCESS)
+                {
+                    fprintf(stderr, "METRICS %s: could not bake at %ux\n", font_path, supersample);
+                    ++failures;
+                    continue;
+                }
+
+                for (u32 cp = 0x21; cp <= 0x7e; ++cp) {
+                    Ink_Box ink = ink_box(&font, cp);
+                    Ink_Box box = metrics_box(&font, cp);
+                    Ink_Box at1 = metrics_box(&reference, cp);
+                    s32 advance    = font.glyph_metrics[cp - font.unicode_cp_start].advance;
+                    s32 advance_1x = reference.glyph_metrics[cp - reference.unicode_cp_start].advance;
+
+                    bool inside = ink.x0 >= ink.x1 ||
+                        (ink.x0 >= box.x0 - 1 && ink.y0 >= box.y0 - 1 && ink.x1 <= box.x1 + 1 && ink.y1 <= box.y1 + 1);
+                    if ((!inside || !boxes_match(box, at1, 1) || abs(advance - advance_1x) > 1) && failures++ < 16) {
+                        fprintf(stderr, "METRICS U+%04X %upx %ux %s: metrics (%d,%d)-(%d,%d) advance %d, "
+                                "ink (%d,%d)-(%d,%d), metrics at 1x (%d,%d)-(%d,%d) advance %d\n",
+                                cp, height, supersample, fixed ? "fixed" : "float",
+                                box.x0, box.y0, box.x1, box.y1, advance, ink.x0, ink.y0, ink.x1, ink.y1,
+                                at1.x0, at1.y0, at1.x1, at1.y1, advance_1x);
+                    }
+                }
+                destroy_pixel_font(&font);
+            }
+            destroy_pixel_font(&reference);
+        }
+    }
+}
+
+//
+//  Benchmarks
+//
+
+// NOTE: Runs body in a forked child. The child reports its own results, the
+//   parent adds the peak resident set size of the child.
+template <typename Body>
+static void run_in_child(const char* name, Body body) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        body();
+        fflush(stdout);
+        _exit(0);
+    }
+
+    int status;
+    struct rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: child failed\n", name);
+        return;
+    }
+    bench_report(name, "peak_rss", (f64)usage.ru_maxrss * 1024, "bytes", false);
+}
+
+static void bench_ttf(const char* font_path, const Ttf_Case* c) {
+    if (!bench_selected(c->name))
+        return;
+
+    run_in_child(c->name, [&]() {
+        Pixel_Font_Bake_Stats stats;
+        Pixel_Font_Bake_Options options;
+        options.stats             = &stats;
+        options.rasterize_threads = c->threaded ? std::max(1u, std::thread::hardware_concurrency()) : 0;
+        options.raster_strip_bytes = c->strip_bytes;
+
+        char stream_path[] = "/tmp/pixel_font_bake_bench_XXXXXX";
+        if (c->stream)
+            close(mkstemp(stream_path));
+
+        Pixel_Font_Baker_Error error = Pixel_Font_Baker_Error::SUCCESS;
+        f64 first_glyph_seconds = 1e30;
+
+        Bench_Counter_Values counters;
+        bench_counters_start(&counters);
+
+        u64 glyphs;
+        f64 seconds = bench_run([&]() -> u64 {
+            if (c->stream) {
+                error = bake_pixel_font_file_from_ttf(font_path, c->height, c->cp_start, c->cp_end,
+                                                      128, c->supersample, stream_path, &options);
+            } else {
+                Pixel_Font font;
+                error = create_pixel_font_from_ttf(font_path, c->height, c->cp_start, c->cp_end,
+                                                   128, c->supersample, &font, &options);
+                if (error == Pixel_Font_Baker_Error::SUCCESS)
+                    destroy_pixel_font(&font);
+            }
+            first_glyph_seconds = std::min(first_glyph_seconds, stats.first_glyph_seconds);
+            return (u64)c->cp_end - c->cp_start + 1;
+        }, &glyphs);
+
+        bench_counters_stop(&counters);
+
+        if (c->stream)
+            unlink(stream_path);
+
+        if (error != Pixel_Font_Baker_Error::SUCCESS) {
+            fprintf(stderr, "%s: %s\n", c->name, pixel_font_baker_error_to_string(error));
+            _exit(1);
+        }
+
+        bench_report(c->name, "glyphs_per_second", glyphs / seconds, "glyphs/s");
+        bench_report(c->name, "time_to_first_glyph", first_glyph_seconds, "s", false);
+        bench_report(c->name, "rasterize_glyphs_per_second",
+                     stats.rasterize.items / std::max(stats.rasterize.busy_seconds, 1e-9), "glyphs/s");
+        bench_report(c->name, "pack_glyphs_per_second",
+                     stats.pack.items / std::max(stats.pack.busy_seconds, 1e-9), "glyphs/s");
+        bench_report_counters(c->name, &counters, glyphs, "glyph");
+    });
+}
+
+static void bench_bdf(const char* font_path) {
+    const char* name = "bake.bdf.bmp";
+    if (!bench_selected(name))
+        return;
+
+    run_in_child(name, [&]() {
+        Pixel_Font_Baker_Error error = Pixel_Font_Baker_Error::SUCCESS;
+        Bench_Counter_Values counters;
+        bench_counters_start(&counters);
+
+        u64 glyphs;
+        f64 seconds = bench_run([&]() -> u64 {
+            Pixel_Font font;
+            error = create_pixel_font_from_bdf(font_path, 0, 0xffff, &font);
+            if (error == Pixel_Font_Baker_Error::SUCCESS)
+                destroy_pixel_font(&font);
+            return 0x10000;
+        }, &glyphs);
+
+        bench_counters_stop(&counters);
+
+        if (error != Pixel_Font_Baker_Error::SUCCESS) {
+            fprintf(stderr, "%s: %s\n", name, pixel_font_baker_error_to_string(error));
+            _exit(1);
+        }
+
+        bench_report(name, "glyphs_per_second", glyphs / seconds, "glyphs/s");
+        bench_report_counters(name, &counters, glyphs, "glyph");
+    });
+}
+
+int main(int argc, char** argv) {
+    int first = bench_parse_options(argc, argv);
+    if (first >= argc || argc - first > 2) {
+        fprintf(stderr, "usage: %s [--min-time s] [--filter str] [--json] [--no-counters] font.ttf [font.bdf]\n",
+                argv[0]);
+        return 2;
+    }
+
+    check_supersample_placement(argv[first]);
+    if (failures) {
+        fprintf(stderr, "%u glyphs placed differently when supersampled\n", failures);
+        return 1;
+    }
+    check_strip_bakes(argv[first]);
+    if (failures) {
+        fprintf(stderr, "%u glyphs baked differently in strips\n", failures);
+        return 1;
+    }
+    check_glyph_metrics(argv[first]);
+    if (failures) {
+        fprintf(stderr, "%u glyph metrics do not match the baked pixels\n", failures);
+        return 1;
+    }
+
+    for (const Ttf_Case& c : ttf_cases)
+        bench_ttf(argv[first], &c);
+
+    if (argc - first == 2)
+        bench_bdf(argv[first + 1]);
+
+    return 0;
+}
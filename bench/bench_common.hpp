@@ -0,0 +1,233 @@
+/*
+ * Shared helpers for the benchmarks in this directory.
+ *
+ * Every benchmark accepts:
+ *   --min-time <s>   run every case for at least this long (default 0.25)
+ *   --filter <str>   only run cases whose name contains <str>
+ *   --json           print one JSON object per result line instead of a table
+ *   --no-counters    do not read the hardware performance counters
+ */
+#pragma once
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct Bench_Options {
+    f64 min_seconds = 0.25;
+    const char* filter = nullptr;
+    bool json = false;
+    bool counters = true;
+};
+
+static Bench_Options bench_options;
+
+// NOTE: Parses the common options, returns the index of the first argument it
+//   did not understand (argc if all were consumed).
+static inline int bench_parse_options(int argc, char** argv) {
+    int i = 1;
+    for (; i < argc; ++i) {
+        if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            bench_options.min_seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            bench_options.filter = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0)
+            bench_options.json = true;
+        else if (strcmp(argv[i], "--no-counters") == 0)
+            bench_options.counters = false;
+        else
+            break;
+    }
+    return i;
+}
+
+static inline bool bench_selected(const char* name) {
+    return !bench_options.filter || strstr(name, bench_options.filter);
+}
+
+static inline f64 bench_seconds_now() {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// NOTE: Time stamp counter ticks on x86 (reference cycles, not core cycles
+//   under frequency scaling), nanoseconds elsewhere.
+static inline u64 bench_cycles_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// NOTE: Calls body until min_seconds have passed. body returns how many items
+//   (glyphs, bytes, ...) it processed, the sum ends up in out_items.
+template <typename Body>
+static inline f64 bench_run(Body body, u64* out_items) {
+    u64 items = 0;
+    f64 start = bench_seconds_now();
+    f64 now   = start;
+    do {
+        items += body();
+        now = bench_seconds_now();
+    } while (now - start < bench_options.min_seconds);
+
+    *out_items = items;
+    return now - start;
+}
+
+static inline void bench_report(const char* name, const char* metric, f64 value, const char* unit,
+                         bool higher_is_better = true)
+{
+    if (bench_options.json) {
+        printf("{\"name\": \"%s\", \"metric\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", "
+               "\"higher_is_better\": %s}\n",
+               name, metric, value, unit, higher_is_better ? "true" : "false");
+    } else {
+        printf("%-44s %-28s %18.3f %s\n", name, metric, value, unit);
+    }
+    fflush(stdout);
+}
+
+// NOTE: xorshift, so inputs are the same on every run
+static u64 bench_random_state = 0x9e3779b97f4a7c15ull;
+static inline u64 bench_random() {
+    bench_random_state ^= bench_random_state << 13;
+    bench_random_state ^= bench_random_state >> 7;
+    bench_random_state ^= bench_random_state << 17;
+    return bench_random_state;
+}
+
+// NOTE: Hardware performance counters through perf_event_open (Linux only).
+//   Counters are opened with inherit set, so threads started while they run
+//   (the bake's rasterizer and write threads) are counted too, and only user
+//   space is counted, which perf_event_paranoid <= 2 allows. Counters the
+//   kernel or the CPU refuse are left out, without any the benches report
+//   wall time only.
+struct Bench_Counter {
+    const char* name;
+    u32 type;
+    u64 config;
+};
+
+static const Bench_Counter bench_counters[] = {
+#if defined(__linux__)
+    { "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "l1d_misses",    PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { "llc_misses",    PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_LL  | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    { "dtlb_misses",   PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+#else
+    { nullptr, 0, 0 },
+#endif
+};
+
+static const u32 bench_counter_count = sizeof(bench_counters) / sizeof(bench_counters[0]);
+
+struct Bench_Counter_Values {
+    int  fds[bench_counter_count];
+    f64  values[bench_counter_count];
+    bool valid[bench_counter_count];
+};
+
+static inline void bench_counters_start(Bench_Counter_Values* c) {
+    for (u32 i = 0; i < bench_counter_count; ++i) {
+        c->fds[i]   = -1;
+        c->valid[i] = false;
+    }
+#if defined(__linux__)
+    if (!bench_options.counters)
+        return;
+
+    for (u32 i = 0; i < bench_counter_count; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = bench_counters[i].type;
+        attr.config         = bench_counters[i].config;
+        attr.disabled       = 1;
+        attr.inherit        = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        c->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    for (u32 i = 0; i < bench_counter_count; ++i) {
+        if (c->fds[i] >= 0) {
+            ioctl(c->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+static inline void bench_counters_stop(Bench_Counter_Values* c) {
+#if defined(__linux__)
+    for (u32 i = 0; i < bench_counter_count; ++i) {
+        if (c->fds[i] >= 0)
+            ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (u32 i = 0; i < bench_counter_count; ++i) {
+        if (c->fds[i] < 0)
+            continue;
+
+        // NOTE: value, time enabled, time running. With more counters than
+        //   the PMU has, they are multiplexed and the value is scaled up.
+        u64 data[3];
+        if (read(c->fds[i], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] > 0) {
+            c->values[i] = (f64)data[0] * ((f64)data[1] / (f64)data[2]);
+            c->valid[i]  = true;
+        }
+        close(c->fds[i]);
+        c->fds[i] = -1;
+    }
+#endif
+
+    static bool warned = false;
+    if (bench_options.counters && !warned) {
+        bool any = false;
+        for (u32 i = 0; i < bench_counter_count; ++i)
+            any |= c->valid[i];
+        if (!any) {
+            fprintf(stderr, "hardware counters are not available, reporting wall time only\n");
+            warned = true;
+        }
+    }
+}
+
+// NOTE: Reports every counter that could be read as <counter>_per_<item>,
+//   plus instructions per cycle when both were read.
+static inline void bench_report_counters(const char* name, const Bench_Counter_Values* c, u64 items, const char* item) {
+    if (items == 0)
+        return;
+
+    for (u32 i = 0; i < bench_counter_count; ++i) {
+        if (!c->valid[i])
+            continue;
+        char metric[64];
+        char unit[64];
+        snprintf(metric, sizeof(metric), "%s_per_%s", bench_counters[i].name, item);
+        snprintf(unit,   sizeof(unit),   "%s/%s",     bench_counters[i].name, item);
+        bench_report(name, metric, c->values[i] / (f64)items, unit, false);
+    }
+
+#if defined(__linux__)
+    if (c->valid[0] && c->valid[1] && c->values[0] > 0)
+        bench_report(name, "instructions_per_cycle", c->values[1] / c->values[0], "ipc");
+#endif
+}
@@ -0,0 +1,451 @@
+/*
+ * Cold start benchmark: time from process start to the first drawn glyph and
+ * to the full table, per font source format.
+ *
+ * Build (ftb has to be on the include path):
+ *
+ *   c++ -O2 -std=c++17 -I.. -I<dir containing ftb> cold_start_bench.cpp -o cold_start_bench -lpthread
+ *
+ * Usage:
+ *
+ *   cold_start_bench [--min-time s] [--filter str] [--json] [--eviction method] font.ttf [font.bdf]
+ *
+ * Every sample starts a fresh process (this binary again, in child mode) with
+ * the font file evicted from the page cache and measures until that process
+ * has drawn a glyph. time_to_first_glyph loads only the range holding 'A',
+ * time_to_full_table the whole range of the case, both include the process
+ * start itself (see cold.process for that alone).
+ *
+ * The bundle cases open one bundle holding ten ascii fonts (10 to 28 px) and
+ * the whole BMP at 16 px, and look up one of them. time_to_first_glyph draws
+ * 'A' only, time_to_full_table also reads every byte of the font's table.
+ * Both include the checksum checks (lazy, only the blocks that are read).
+ *
+ * Eviction, in order of preference:
+ *   drop_caches - writes 1 to /proc/sys/vm/drop_caches (needs root), so the
+ *                 binary and its libraries start cold as well
+ *   fadvise     - POSIX_FADV_DONTNEED on the font file
+ *   copy        - a fresh copy of the font file for every sample, when
+ *                 neither of the above is possible
+ * The chosen method is printed to stderr, --eviction forces one.
+ */
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#define PIXEL_FONT_BAKER_IMPL
+#include "../pixel_font_baker.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+enum struct Source_Format {
+    NONE, // process start only
+    TTF,
+    BDF,
+    PXFT,
+    BUNDLE,
+};
+
+struct Cold_Case {
+    const char*   name;
+    Source_Format format;
+    u32 cp_start;
+    u32 cp_end;
+};
+
+static const Cold_Case cold_cases[] = {
+    { "cold.process",          Source_Format::NONE,   0,    0      },
+    { "cold.ttf.h16.ascii",    Source_Format::TTF,    0x20, 0x7e   },
+    { "cold.ttf.h16.bmp",      Source_Format::TTF,    0x0,  0xffff },
+    { "cold.bdf.ascii",        Source_Format::BDF,    0x20, 0x7e   },
+    { "cold.bdf.bmp",          Source_Format::BDF,    0x0,  0xffff },
+    { "cold.pxft.h16.ascii",   Source_Format::PXFT,   0x20, 0x7e   },
+    { "cold.pxft.h16.bmp",     Source_Format::PXFT,   0x0,  0xffff },
+    { "cold.bundle.h16.ascii", Source_Format::BUNDLE, 0x20, 0x7e   },
+    { "cold.bundle.h16.bmp",   Source_Format::BUNDLE, 0x0,  0xffff },
+};
+
+enum struct Eviction {
+    DROP_CACHES,
+    FADVISE,
+    COPY,
+};
+
+static f64 monotonic_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+//  Child: load, draw one glyph, print the time
+//
+
+static int run_child(char** argv) {
+    Source_Format format = (Source_Format)atoi(argv[0]);
+    const char*   path   = argv[1];
+    u32 cp_start = (u32)strtoul(argv[2], nullptr, 0);
+    u32 cp_end   = (u32)strtoul(argv[3], nullptr, 0);
+    bool full    = atoi(argv[4]) != 0;
+
+    if (format == Source_Format::NONE) {
+        printf("%.9f\n", monotonic_seconds());
+        return 0;
+    }
+
+    Pixel_Font        font;
+    Pixel_Font_Bundle bundle;
+    Pixel_Font_Baker_Error error = Pixel_Font_Baker_Error::SUCCESS;
+    switch (format) {
+        case Source_Format::TTF:  error = create_pixel_font_from_ttf(path, 16, cp_start, cp_end, 128, 1, &font); break;
+        case Source_Format::BDF:  error = create_pixel_font_from_bdf(path, cp_start, cp_end, &font);            break;
+        case Source_Format::PXFT: error = load_pixel_font(path, &font);                                         break;
+        case Source_Format::BUNDLE: {
+            error = open_pixel_font_bundle(path, &bundle);
+            if (error == Pixel_Font_Baker_Error::SUCCESS)
+                error = find_pixel_font_in_bundle(&bundle, cp_end > 0x7e ? "bmp" : "ascii", 16, 0, &font);
+            if (error == Pixel_Font_Baker_Error::SUCCESS)
+                error = full
+                    ? verify_pixel_font_bundle_glyphs(&bundle, &font, font.unicode_cp_start, font.unicode_cp_end)
+                    : verify_pixel_font_bundle_glyphs(&bundle, &font, 'A', 'A');
+        } break;
+        default: break;
+    }
+    if (error != Pixel_Font_Baker_Error::SUCCESS) {
+        fprintf(stderr, "%s: %s\n", path, pixel_font_baker_error_to_string(error));
+        return 1;
+    }
+
+    u8 pixels[64 * 8] = {};
+    Pixel_Font_Framebuffer fb = { pixels, 64, 64, 8 };
+    pixel_font_draw_glyph(&fb, &font, 'A', 0, 0);
+
+    // NOTE: A mapped table is only read in when touched.
+    if (full) {
+        u64 table_size = (u64)(font.unicode_cp_end - font.unicode_cp_start + 1) * font.bytes_per_glyph;
+        u8 sum = 0;
+        for (u64 i = 0; i < table_size; ++i)
+            sum += font.table[i];
+        volatile u8 sink = sum;
+        (void)sink;
+    }
+
+    printf("%.9f\n", monotonic_seconds());
+    destroy_pixel_font(&font);
+    if (format == Source_Format::BUNDLE)
+        close_pixel_font_bundle(&bundle);
+    return 0;
+}
+
+//
+//  Parent
+//
+
+static bool copy_file(const char* from, const char* to) {
+    FILE* in  = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    bool ok = in && out;
+    char buffer[1 << 16];
+    u64 n;
+    while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        ok = fwrite(buffer, 1, n, out) == n;
+    if (in)  fclose(in);
+    if (out) ok = (fclose(out) == 0) && ok;
+    return ok;
+}
+
+static bool evict_with_fadvise(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = fdatasync(fd) == 0 || errno == EINVAL;
+    ok = ok && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+}
+
+// NOTE: Fraction of the file's pages that are still in the page cache.
+static f64 resident_fraction(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    f64 fraction = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            u64 page  = (u64)sysconf(_SC_PAGESIZE);
+            u64 pages = ((u64)st.st_size + page - 1) / page;
+            unsigned char* vec = (unsigned char*)malloc(pages);
+            if (vec && mincore(map, st.st_size, vec) == 0) {
+                u64 resident = 0;
+                for (u64 i = 0; i < pages; ++i)
+                    resident += vec[i] & 1;
+                fraction = (f64)resident / pages;
+            }
+            free(vec);
+            munmap(map, st.st_size);
+        }
+    }
+    close(fd);
+    return fraction;
+}
+
+static bool drop_caches() {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd < 0)
+        return false;
+    bool ok = write(fd, "1", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+static Eviction choose_eviction(const char* probe_path) {
+    if (drop_caches())
+        return Eviction::DROP_CACHES;
+    if (evict_with_fadvise(probe_path) && resident_fraction(probe_path) < 0.5)
+        return Eviction::FADVISE;
+    return Eviction::COPY;
+}
+
+// NOTE: Makes path cold and returns the path the child should load, which is
+//   a fresh copy for Eviction::COPY.
+static const char* make_cold(Eviction eviction, const char* path, char* copy_path, u64 sample) {
+    switch (eviction) {
+        case Eviction::DROP_CACHES: drop_caches();              return path;
+        case Eviction::FADVISE:     evict_with_fadvise(path);   return path;
+        case Eviction::COPY: {
+            const char* dot = strrchr(path, '.');
+            sprintf(copy_path, "/tmp/pixel_font_cold_%d_%llu%s", (int)getpid(),
+                    (unsigned long long)sample, dot ? dot : "");
+            if (!copy_file(path, copy_path))
+                return nullptr;
+            return copy_path;
+        }
+    }
+    return path;
+}
+
+// NOTE: Spawns the child and returns the seconds from just before the spawn
+//   until the child had drawn its glyph, < 0 on failure.
+static f64 spawn_child(const char* self, Source_Format format, const char* path, u32 cp_start, u32 cp_end,
+                       bool full)
+{
+    char format_arg[16], start_arg[16], end_arg[16];
+    snprintf(format_arg, sizeof(format_arg), "%d", (int)format);
+    snprintf(start_arg,  sizeof(start_arg),  "%u", cp_start);
+    snprintf(end_arg,    sizeof(end_arg),    "%u", cp_end);
+    char* child_argv[] = {
+        (char*)self, (char*)"--child", format_arg, (char*)path, start_arg, end_arg, (char*)(full ? "1" : "0"), nullptr
+    };
+
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+        return -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], 1);
+    posix_spawn_file_actions_addclose(&actions, pipe_fds[0]);
+
+    f64 start = monotonic_seconds();
+    pid_t pid;
+    int spawned = posix_spawn(&pid, self, &actions, nullptr, child_argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(pipe_fds[1]);
+
+    char line[64] = {};
+    u64 length = 0;
+    ssize_t n;
+    while (spawned == 0 && length < sizeof(line) - 1 &&
+           (n = read(pipe_fds[0], line + length, sizeof(line) - 1 - length)) > 0)
+    {
+        length += n;
+    }
+    close(pipe_fds[0]);
+
+    if (spawned != 0)
+        return -1;
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+
+    return atof(line) - start;
+}
+
+static f64 median(f64* values, u64 count) {
+    std::sort(values, values + count);
+    return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// NOTE: At least 5 samples, more until min_seconds have passed.
+static f64 measure(const char* self, Eviction eviction, Source_Format format, const char* path,
+                   u32 cp_start, u32 cp_end, bool full)
+{
+    const u64 max_samples = 256;
+    f64 samples[max_samples];
+    u64 count = 0;
+
+    f64 begin = monotonic_seconds();
+    while (count < max_samples && (count < 5 || monotonic_seconds() - begin < bench_options.min_seconds)) {
+        char copy_path[512];
+        const char* cold_path = path;
+        if (format != Source_Format::NONE || eviction == Eviction::DROP_CACHES)
+            cold_path = make_cold(eviction, path, copy_path, count);
+        if (!cold_path)
+            return -1;
+
+        f64 seconds = spawn_child(self, format, cold_path, cp_start, cp_end, full);
+        if (cold_path != path)
+            unlink(cold_path);
+        if (seconds < 0)
+            return -1;
+        samples[count++] = seconds;
+    }
+
+    return median(samples, count);
+}
+
+// NOTE: Ten ascii fonts plus the one the case looks up, so the directory has
+//   to be searched and the other tables are never touched.
+static bool make_bundle(const char* ttf_path, u32 cp_start, u32 cp_end, const char* out_path) {
+    const u32 ascii_count = 10;
+    Pixel_Font             fonts[ascii_count + 1]   = {};
+    Pixel_Font_Bundle_Font entries[ascii_count + 1] = {};
+
+    bool ok = true;
+    u32 count = 0;
+    for (u32 i = 0; i < ascii_count && ok; ++i, ++count) {
+        entries[count] = { "ascii", (u16)(10 + 2 * i), 0, &fonts[count] };
+        ok = create_pixel_font_from_ttf(ttf_path, entries[count].size, 0x20, 0x7e, 128, 1, &fonts[count]) ==
+             Pixel_Font_Baker_Error::SUCCESS;
+    }
+    if (ok && cp_end > 0x7e) {
+        entries[count] = { "bmp", 16, 0, &fonts[count] };
+        ok = create_pixel_font_from_ttf(ttf_path, 16, cp_start, cp_end, 128, 1, &fonts[count]) ==
+             Pixel_Font_Baker_Error::SUCCESS;
+        ++count;
+    }
+
+    ok = ok && write_pixel_font_bundle(entries, count, out_path) == Pixel_Font_Baker_Error::SUCCESS;
+
+    for (u32 i = 0; i < count; ++i)
+        destroy_pixel_font(&fonts[i]);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 7 && strcmp(argv[1], "--child") == 0)
+        return run_child(argv + 2);
+
+    const char* eviction_names[] = { "drop_caches", "fadvise", "copy" };
+    s32 forced_eviction = -1;
+
+    int first = bench_parse_options(argc, argv);
+    if (first + 1 < argc && strcmp(argv[first], "--eviction") == 0) {
+        for (u32 i = 0; i < 3; ++i) {
+            if (strcmp(argv[first + 1], eviction_names[i]) == 0)
+                forced_eviction = (s32)i;
+        }
+        first += forced_eviction >= 0 ? 2 : 0;
+    }
+    if (first >= argc || argc - first > 2) {
+        fprintf(stderr, "usage: %s [--min-time s] [--filter str] [--json] [--eviction drop_caches|fadvise|copy] "
+                "font.ttf [font.bdf]\n", argv[0]);
+        return 2;
+    }
+    const char* ttf_path = argv[first];
+    const char* bdf_path = argc - first == 2 ? argv[first + 1] : nullptr;
+
+    char self[4096];
+    ssize_t self_length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (self_length <= 0) {
+        fprintf(stderr, "could not find the own executable\n");
+        return 1;
+    }
+    self[self_length] = '\0';
+
+    Eviction eviction = forced_eviction >= 0 ? (Eviction)forced_eviction : choose_eviction(ttf_path);
+    fprintf(stderr, "page cache eviction: %s\n", eviction_names[(u32)eviction]);
+
+    for (const Cold_Case& c : cold_cases) {
+        if (!bench_selected(c.name))
+            continue;
+        if (c.format == Source_Format::BDF && !bdf_path)
+            continue;
+
+        const char* path = c.format == Source_Format::BDF ? bdf_path : ttf_path;
+
+        // NOTE: The baked files are made up front from the ttf, once for the
+        //   first glyph and once for the whole range.
+        char first_path[] = "/tmp/pixel_font_cold_first_XXXXXX";
+        char full_path[]  = "/tmp/pixel_font_cold_full_XXXXXX";
+        const char* first_glyph_path = path;
+        const char* full_table_path  = path;
+        if (c.format == Source_Format::PXFT) {
+            close(mkstemp(first_path));
+            close(mkstemp(full_path));
+            if (bake_pixel_font_file_from_ttf(ttf_path, 16, 'A', 'A', 128, 1, first_path) !=
+                    Pixel_Font_Baker_Error::SUCCESS ||
+                bake_pixel_font_file_from_ttf(ttf_path, 16, c.cp_start, c.cp_end, 128, 1, full_path) !=
+                    Pixel_Font_Baker_Error::SUCCESS)
+            {
+                fprintf(stderr, "%s: could not bake the pxft files\n", c.name);
+                unlink(first_path);
+                unlink(full_path);
+                continue;
+            }
+            first_glyph_path = first_path;
+            full_table_path  = full_path;
+        }
+        if (c.format == Source_Format::BUNDLE) {
+            close(mkstemp(full_path));
+            if (!make_bundle(ttf_path, c.cp_start, c.cp_end, full_path)) {
+                fprintf(stderr, "%s: could not write the bundle\n", c.name);
+                unlink(full_path);
+                continue;
+            }
+            first_glyph_path = full_path;
+            full_table_path  = full_path;
+        }
+
+        if (c.format == Source_Format::NONE) {
+            f64 seconds = measure(self, eviction, c.format, path, 0, 0, false);
+            if (seconds >= 0)
+                bench_report(c.name, "time_to_main", seconds, "s", false);
+            else
+                fprintf(stderr, "%s: child failed\n", c.name);
+            continue;
+        }
+
+        // NOTE: A bundle has the whole range already, the lookup goes by it.
+        f64 first_glyph = c.format == Source_Format::BUNDLE
+            ? measure(self, eviction, c.format, first_glyph_path, c.cp_start, c.cp_end, false)
+            : measure(self, eviction, c.format, first_glyph_path, 'A', 'A', false);
+        f64 full_table  = measure(self, eviction, c.format, full_table_path, c.cp_start, c.cp_end, true);
+
+        if (c.format == Source_Format::PXFT)
+            unlink(first_path);
+        if (c.format == Source_Format::PXFT || c.format == Source_Format::BUNDLE)
+            unlink(full_path);
+
+        if (first_glyph < 0 || full_table < 0) {
+            fprintf(stderr, "%s: child failed\n", c.name);
+            continue;
+        }
+        bench_report(c.name, "time_to_first_glyph", first_glyph, "s", false);
+        bench_report(c.name, "time_to_full_table",  full_table,  "s", false);
+    }
+
+    return 0;
+}
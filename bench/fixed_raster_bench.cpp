@@ -0,0 +1,307 @@
+/*
+ * Fixed point rasterizer check and benchmark.
+ *
+ * Build (ftb has to be on the include path):
+ *
+ *   c++ -O2 -std=c++17 -I.. -I<dir containing ftb> fixed_raster_bench.cpp -o fixed_raster_bench -lpthread
+ *
+ * Integer only configuration, as a firmware build without an FPU would use
+ * it (the fixed point rasterizer is the default and the SSE2 paths are out):
+ *
+ *   c++ -O2 -std=c++17 -DPIXEL_FONT_BAKER_FIXED_POINT=1 -DPIXEL_FONT_BAKER_NO_SIMD -I.. \
+ *       -I<dir containing ftb> fixed_raster_bench.cpp -o fixed_raster_bench_int -lpthread
+ *
+ * In that configuration a ttf (glyf) bake does its float math once per font
+ * (the cell size), every glyph is decoded, measured, rasterized and packed
+ * with integers only. stb_truetype's CFF outline decoder uses floats.
+ *
+ * Usage: fixed_raster_bench [options] font.ttf...
+ *
+ * First rasterizes codepoints 0x20-0x24f of every font at several heights
+ * with stb_truetype's float rasterizer and with pfb__rasterize_fixed, once
+ * from the font's outlines and once with every quadratic curve raised to a
+ * cubic (the path CFF fonts take), and thresholds both at 128. Every height
+ * is also rasterized supersampled 2 and 4 times and box filtered the way
+ * the bake does it (stb_truetype's prefilter for the float bitmap,
+ * pfb__box_prefilter for the fixed point one). A pixel may only differ
+ * where the float coverage is within tolerance_gray (16 of 255) of the
+ * threshold, otherwise the check fails and the program exits with 1. The
+ * differing pixels are reported per size as a share of the ink pixels.
+ *
+ * The check is run on the DejaVu family, Lato and Source Code Pro, all of
+ * which have to pass:
+ *
+ *   fixed_raster_bench /usr/share/fonts/truetype/dejavu/DejaVuSans.ttf \
+ *       /usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf \
+ *       /usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf \
+ *       /usr/share/fonts/truetype/dejavu/DejaVuSansMono-Bold.ttf \
+ *       /usr/share/fonts/truetype/dejavu/DejaVuSerif.ttf \
+ *       /usr/share/fonts/truetype/dejavu/DejaVuSerif-Bold.ttf \
+ *       Lato-Regular.ttf SourceCodePro-Regular.ttf
+ *
+ * Then reports glyphs/s of both rasterizers (outline decode, box and
+ * rasterization) and of whole create_pixel_font_from_ttf bakes with and
+ * without Pixel_Font_Bake_Options::fixed_point_rasterizer.
+ */
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#define PIXEL_FONT_BAKER_IMPL
+#include "../pixel_font_baker.hpp"
+#include "bench_common.hpp"
+
+static const s32 sizes[]        = { 8, 12, 16, 24, 32, 48 };
+static const s32 supersamples[] = { 1, 2, 4 };
+static const u32 first_cp       = 0x20;
+static const u32 last_cp        = 0x24f;
+static const u8  threshold      = 128;
+static const s32 tolerance_gray = 16; // one of the PFB__FIXED_SUBROWS sample rows
+
+static u32 failures = 0;
+
+struct Gray_Bitmap {
+    u8* pixels;
+    s32 x0, y0; // of the top left pixel in the glyph's pixel space
+    s32 width, height;
+};
+
+static u8 gray_at(const Gray_Bitmap* b, s32 x, s32 y) {
+    x -= b->x0;
+    y -= b->y0;
+    if (x < 0 || y < 0 || x >= b->width || y >= b->height)
+        return 0;
+    return b->pixels[y * b->width + x];
+}
+
+// NOTE: Every quadratic raised to the cubic with the same curve, control
+//   points rounded to font units.
+static stbtt_vertex* raise_to_cubics(const stbtt_vertex* vertices, s32 vertex_count) {
+    stbtt_vertex* raised = (stbtt_vertex*)malloc(sizeof(stbtt_vertex) * (u64)std::max(1, vertex_count));
+    s32 x = 0, y = 0;
+    for (s32 i = 0; i < vertex_count; ++i) {
+        raised[i] = vertices[i];
+        if (vertices[i].type == STBTT_vcurve) {
+            const stbtt_vertex* v = vertices + i;
+            raised[i].type = STBTT_vcubic;
+            raised[i].cx   = (stbtt_vertex_type)(x    + (2 * (v->cx - x)    + (v->cx > x    ? 1 : -1)) / 3);
+            raised[i].cy   = (stbtt_vertex_type)(y    + (2 * (v->cy - y)    + (v->cy > y    ? 1 : -1)) / 3);
+            raised[i].cx1  = (stbtt_vertex_type)(v->x + (2 * (v->cx - v->x) + (v->cx > v->x ? 1 : -1)) / 3);
+            raised[i].cy1  = (stbtt_vertex_type)(v->y + (2 * (v->cy - v->y) + (v->cy > v->y ? 1 : -1)) / 3);
+        }
+        x = vertices[i].x;
+        y = vertices[i].y;
+    }
+    return raised;
+}
+
+// NOTE: What stbtt_MakeGlyphBitmapSubpixelPrefilter does (without a
+//   subpixel shift), with the outline's quadratics optionally raised to
+//   cubics. scale is the supersampled one, the bitmap gets the prefilter's
+//   supersample - 1 extra columns and rows.
+static void rasterize_float(const stbtt_fontinfo* font, s32 glyph, f32 scale, s32 supersample, bool cubics,
+                            Gray_Bitmap* out)
+{
+    s32 x1, y1;
+    stbtt_GetGlyphBitmapBox(font, glyph, scale, scale, &out->x0, &out->y0, &x1, &y1);
+    out->width  = x1 - out->x0 + supersample - 1;
+    out->height = y1 - out->y0 + supersample - 1;
+    out->pixels = (u8*)calloc((u64)std::max(1, out->width * out->height), 1);
+
+    stbtt_vertex* vertices = nullptr;
+    s32 vertex_count = stbtt_GetGlyphShape(font, glyph, &vertices);
+    stbtt_vertex* shape = cubics ? raise_to_cubics(vertices, vertex_count) : vertices;
+    stbtt__bitmap bitmap = { x1 - out->x0, y1 - out->y0, out->width, out->pixels };
+    stbtt_Rasterize(&bitmap, 0.35f, shape, vertex_count, scale, scale, 0, 0, out->x0, out->y0, 1, nullptr);
+    if (supersample > 1) {
+        stbtt__h_prefilter(out->pixels, out->width, out->height, out->width, (u32)supersample);
+        stbtt__v_prefilter(out->pixels, out->width, out->height, out->width, (u32)supersample);
+    }
+    if (cubics)
+        free(shape);
+    if (vertices)
+        stbtt_FreeShape(font, vertices);
+}
+
+// NOTE: Like the bake: rasterized into the glyph box, then box filtered.
+static void rasterize_fixed(const stbtt_fontinfo* font, s32 glyph, s64 scale, s32 supersample, bool cubics,
+                            Gray_Bitmap* out)
+{
+    s32 x1, y1;
+    pfb__fixed_glyph_box(font, glyph, scale, &out->x0, &out->y0, &x1, &y1);
+    out->width  = x1 - out->x0 + supersample - 1;
+    out->height = y1 - out->y0 + supersample - 1;
+    out->pixels = (u8*)calloc((u64)std::max(1, out->width * out->height), 1);
+
+    stbtt_vertex* vertices = nullptr;
+    s32 vertex_count = stbtt_GetGlyphShape(font, glyph, &vertices);
+    stbtt_vertex* shape = cubics ? raise_to_cubics(vertices, vertex_count) : vertices;
+    pfb__rasterize_fixed(shape, vertex_count, scale, out->x0, out->y0, out->pixels, x1 - out->x0, y1 - out->y0,
+                         out->width);
+    if (supersample > 1) {
+        pfb__box_prefilter(out->pixels, out->width, 1, out->height, out->width, supersample);
+        pfb__box_prefilter(out->pixels, out->height, out->width, out->width, 1, supersample);
+    }
+    if (cubics)
+        free(shape);
+    if (vertices)
+        stbtt_FreeShape(font, vertices);
+}
+
+//
+//  Check
+//
+
+static void check_size(const char* path, const stbtt_fontinfo* font, s32 size, s32 supersample, bool cubics) {
+    f32 scale       = stbtt_ScaleForPixelHeight(font, (f32)(size * supersample));
+    s64 fixed_scale = pfb__fixed_font_scale(font, nullptr, size * supersample, supersample);
+
+    u64 ink        = 0;
+    u64 differing  = 0;
+    s32 worst      = 0; // largest |float gray - threshold| of a differing pixel
+    s32 worst_gray = 0; // largest |float gray - fixed gray|
+    for (u32 cp = first_cp; cp <= last_cp; ++cp) {
+        s32 glyph = stbtt_FindGlyphIndex(font, (s32)cp);
+        if (glyph == 0)
+            continue;
+
+        Gray_Bitmap f, x;
+        rasterize_float(font, glyph, scale, supersample, cubics, &f);
+        rasterize_fixed(font, glyph, fixed_scale, supersample, cubics, &x);
+
+        s32 left   = std::min(f.x0, x.x0);
+        s32 top    = std::min(f.y0, x.y0);
+        s32 right  = std::max(f.x0 + f.width,  x.x0 + x.width);
+        s32 bottom = std::max(f.y0 + f.height, x.y0 + x.height);
+        for (s32 py = top; py < bottom; ++py) {
+            for (s32 px = left; px < right; ++px) {
+                s32 a = gray_at(&f, px, py);
+                s32 b = gray_at(&x, px, py);
+                ink       += a >= threshold;
+                worst_gray = std::max(worst_gray, abs(a - b));
+                if ((a >= threshold) != (b >= threshold)) {
+                    ++differing;
+                    worst = std::max(worst, abs(a - threshold));
+                    if (abs(a - threshold) > tolerance_gray && failures++ < 16) {
+                        fprintf(stderr, "OUT OF TOLERANCE %s U+%04X %dpx %dx%s: pixel (%d, %d) float %d fixed %d\n",
+                                path, cp, size, supersample, cubics ? " cubic" : "", px, py, a, b);
+                    }
+                }
+            }
+        }
+        free(f.pixels);
+        free(x.pixels);
+    }
+
+    char name[128];
+    snprintf(name, sizeof(name), "fixed_raster.check.%dpx%s%s", size,
+             supersample == 2 ? ".ss2" : supersample == 4 ? ".ss4" : "", cubics ? ".cubic" : "");
+    bench_report(name, "differing_pixels_per_ink", ink ? (f64)differing / (f64)ink : 0, "ratio", false);
+    bench_report(name, "worst_distance_to_threshold", (f64)worst, "gray", false);
+    bench_report(name, "worst_gray_difference", (f64)worst_gray, "gray", false);
+}
+
+static void check_font(const char* path, const stbtt_fontinfo* font) {
+    for (bool cubics : { false, true }) {
+        for (s32 supersample : supersamples) {
+            for (s32 size : sizes)
+                check_size(path, font, size, supersample, cubics);
+        }
+    }
+}
+
+//
+//  Timing
+//
+
+static void time_font(const char* path, const stbtt_fontinfo* font) {
+    for (s32 size : { 16, 48 }) {
+        f32 scale       = stbtt_ScaleForPixelHeight(font, (f32)size);
+        s64 fixed_scale = pfb__fixed_font_scale(font, nullptr, size, 1);
+
+        for (bool fixed : { false, true }) {
+            char name[128];
+            snprintf(name, sizeof(name), "fixed_raster.glyph.%dpx.%s", size, fixed ? "fixed" : "float");
+            if (!bench_selected(name))
+                continue;
+
+            Bench_Counter_Values counters;
+            bench_counters_start(&counters);
+            u64 glyphs;
+            f64 seconds = bench_run([&]() -> u64 {
+                u64 count = 0;
+                for (u32 cp = 0x20; cp <= 0x7e; ++cp) {
+                    s32 glyph = stbtt_FindGlyphIndex(font, (s32)cp);
+                    Gray_Bitmap b;
+                    if (fixed)
+                        rasterize_fixed(font, glyph, fixed_scale, 1, false, &b);
+                    else
+                        rasterize_float(font, glyph, scale, 1, false, &b);
+                    free(b.pixels);
+                    ++count;
+                }
+                return count;
+            }, &glyphs);
+            bench_counters_stop(&counters);
+
+            bench_report(name, "glyphs_per_second", (f64)glyphs / seconds, "glyphs/s");
+            bench_report_counters(name, &counters, glyphs, "glyph");
+        }
+
+        for (bool fixed : { false, true }) {
+            char name[128];
+            snprintf(name, sizeof(name), "fixed_raster.bake.%dpx.%s", size, fixed ? "fixed" : "float");
+            if (!bench_selected(name))
+                continue;
+
+            Pixel_Font_Bake_Options options;
+            options.fixed_point_rasterizer = fixed;
+            options.embedded_bitmaps       = false;
+
+            u64 glyphs;
+            f64 seconds = bench_run([&]() -> u64 {
+                Pixel_Font baked;
+                Pixel_Font_Baker_Error error =
+                    create_pixel_font_from_ttf(path, (u16)size, 0x20, 0x7e, threshold, 1, &baked, &options);
+                if (error != Pixel_Font_Baker_Error::SUCCESS) {
+                    fprintf(stderr, "could not bake %s: %s\n", path, pixel_font_baker_error_to_string(error));
+                    exit(1);
+                }
+                destroy_pixel_font(&baked);
+                return 0x7e - 0x20 + 1;
+            }, &glyphs);
+
+            bench_report(name, "glyphs_per_second", (f64)glyphs / seconds, "glyphs/s");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int first_font = bench_parse_options(argc, argv);
+    if (first_font == argc) {
+        fprintf(stderr, "usage: %s [--min-time s] [--filter str] [--json] [--no-counters] font.ttf...\n", argv[0]);
+        return 2;
+    }
+
+    if (!bench_options.json) {
+        printf("rasterizer default: %s\n",
+               Pixel_Font_Bake_Options().fixed_point_rasterizer ? "fixed point" : "stb_truetype");
+    }
+
+    for (int i = first_font; i < argc; ++i) {
+        stbtt_fontinfo font;
+        if (pfb__read_ttf(argv[i], &font) != Pixel_Font_Baker_Error::SUCCESS) {
+            fprintf(stderr, "could not read %s\n", argv[i]);
+            return 1;
+        }
+
+        check_font(argv[i], &font);
+        if (failures) {
+            fprintf(stderr, "%u pixels differ by more than %d gray from the threshold\n", failures, tolerance_gray);
+            return 1;
+        }
+        time_font(argv[i], &font);
+
+        pfb__free_ttf(&font);
+    }
+
+    return 0;
+}
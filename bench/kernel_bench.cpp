@@ -0,0 +1,631 @@
+/*
+ * Kernel benchmark and conformance check.
+ *
+ * Build (ftb has to be on the include path):
+ *
+ *   c++ -O2 -std=c++17 -I.. -I<dir containing ftb> kernel_bench.cpp -o kernel_bench -lpthread
+ *
+ * First runs every kernel of pixel_font_baker.hpp against its *_reference
+ * version on randomized inputs and edge sizes (widths 1-64, odd strides,
+ * every bit offset) and exits with 1 on the first mismatch. Then reports
+ * cycles per byte of both versions.
+ *
+ * Kernels: bdf hex decode, gray threshold/pack, glyph row blit (packed and
+ * word rows), 1-bpp to 2-bpp and 4-bpp expansion, CRC32C (reference,
+ * table and hardware where available) and UTF-8 decode (pixel_font_decode_utf8
+ * and the ASCII fast path in front of it that the string drawing uses,
+ * checked against a decoder written from the table of well-formed byte
+ * sequences in the Unicode standard).
+ */
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#define PIXEL_FONT_BAKER_IMPL
+#include "../pixel_font_baker.hpp"
+#include "bench_common.hpp"
+
+static u32 mismatches = 0;
+
+static void mismatch(const char* kernel, const char* what) {
+    if (mismatches++ < 16)
+        fprintf(stderr, "MISMATCH %s: %s\n", kernel, what);
+}
+
+//
+//  Conformance
+//
+
+static void check_hex() {
+    const char digits[] = "0123456789abcdefABCDEF";
+    char src[129];
+    u8 expected[64], actual[64];
+
+    for (u32 byte_count = 1; byte_count <= 64; ++byte_count) {
+        for (u32 round = 0; round < 64; ++round) {
+            for (u32 i = 0; i < 2 * byte_count; ++i)
+                src[i] = digits[bench_random() % (sizeof(digits) - 1)];
+            src[2 * byte_count] = '\n';
+
+            bool e = pfb__decode_hex_reference(src, expected, byte_count);
+            bool a = pfb__decode_hex(src, actual, byte_count);
+            if (!e || !a || memcmp(expected, actual, byte_count) != 0) {
+                char what[64];
+                snprintf(what, sizeof(what), "valid input, %u bytes", byte_count);
+                mismatch("hex", what);
+            }
+
+            // NOTE: anything that is not a hex digit has to be rejected
+            char bad = "gxZ \t-+\n"[bench_random() % 8];
+            src[bench_random() % (2 * byte_count)] = bad;
+            if (pfb__decode_hex(src, actual, byte_count))
+                mismatch("hex", "accepted a non hex digit");
+        }
+    }
+}
+
+static void check_threshold_pack() {
+    u8 src[64 * 7];
+    u8 expected[16], actual[16];
+
+    for (u32 count = 1; count <= 64; ++count) {
+        for (u32 step : { 1u, 2u, 3u, 5u, 7u }) {
+            for (u32 dst_bit = 0; dst_bit < 16; ++dst_bit) {
+                for (u8 threshold : { (u8)0, (u8)1, (u8)127, (u8)128, (u8)255, (u8)bench_random() }) {
+                    for (u32 i = 0; i < count * step; ++i) {
+                        // NOTE: mostly values right around the threshold
+                        u64 r = bench_random();
+                        src[i] = (r & 3) ? (u8)(threshold + (s32)((r >> 8) % 3) - 1) : (u8)(r >> 16);
+                    }
+                    for (u32 i = 0; i < sizeof(expected); ++i)
+                        expected[i] = actual[i] = (u8)bench_random();
+
+                    pfb__threshold_pack_reference(src, step, count, threshold, expected, dst_bit);
+                    pfb__threshold_pack(src, step, count, threshold, actual, dst_bit);
+                    if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                        char what[96];
+                        snprintf(what, sizeof(what), "count %u, step %u, dst_bit %u, threshold %u",
+                                 count, step, dst_bit, threshold);
+                        mismatch("threshold_pack", what);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void check_blit() {
+    u8 glyph_row[8];
+    u8 expected[32], actual[32];
+
+    for (s32 width = 1; width <= 64; ++width) {
+        for (s32 fb_width : { 1, 7, 9, 63, 65, 127, 130 }) {
+            for (s32 x = -width - 1; x <= fb_width + 1; ++x) {
+                s32 col_begin = x < 0 ? -x : 0;
+                s32 col_end   = fb_width - x < width ? fb_width - x : width;
+                if (col_begin >= col_end)
+                    continue;
+
+                for (u32 i = 0; i < sizeof(glyph_row); ++i)
+                    glyph_row[i] = (u8)bench_random();
+                // NOTE: guard bytes around the row catch writes outside of it
+                for (u32 i = 0; i < sizeof(expected); ++i)
+                    expected[i] = actual[i] = (u8)bench_random();
+
+                u8* e = expected + 8;
+                u8* a = actual   + 8;
+                pfb__blit_row_reference(e, x, glyph_row, col_begin, col_end);
+                pfb__blit_row(a, x, glyph_row, col_begin, col_end);
+                if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                    char what[96];
+                    snprintf(what, sizeof(what), "width %d, framebuffer width %d, x %d", width, fb_width, x);
+                    mismatch("blit_row", what);
+                }
+            }
+        }
+    }
+}
+
+static void check_blit_word() {
+    alignas(8) u8 glyph_row[8];
+    u8 expected[48], actual[48];
+
+    for (u32 row_bytes : { 1u, 2u, 4u, 8u }) {
+        for (s32 width = 1; width <= (s32)row_bytes * 8; ++width) {
+            for (s32 fb_width : { 1, 7, 9, 63, 65, 127, 130 }) {
+                u32 fb_bytes = (u32)(fb_width + 7) / 8;
+                for (s32 x = -width - 1; x <= fb_width + 1; ++x) {
+                    s32 col_begin = x < 0 ? -x : 0;
+                    s32 col_end   = fb_width - x < width ? fb_width - x : width;
+                    if (col_begin >= col_end)
+                        continue;
+
+                    for (u32 i = 0; i < sizeof(glyph_row); ++i)
+                        glyph_row[i] = (u8)bench_random();
+                    for (u32 i = 0; i < sizeof(expected); ++i)
+                        expected[i] = actual[i] = (u8)bench_random();
+
+                    u8* e = expected + 8;
+                    u8* a = actual   + 8;
+                    pfb__blit_row_reference(e, x, glyph_row, col_begin, col_end);
+                    pfb__blit_row_word(a, fb_bytes, x, glyph_row, row_bytes, col_begin, col_end);
+                    if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                        char what[96];
+                        snprintf(what, sizeof(what), "row bytes %u, width %d, framebuffer width %d, x %d",
+                                 row_bytes, width, fb_width, x);
+                        mismatch("blit_row_word", what);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void check_expand() {
+    u8 src[48];
+    u8 expected[48 * 4 + 16], actual[48 * 4 + 16];
+
+    for (u32 bpp : { 2u, 4u }) {
+        const char* kernel = bpp == 2 ? "expand_2bpp" : "expand_4bpp";
+        for (u32 pixel_count = 1; pixel_count <= 48 * 8; pixel_count += pixel_count < 160 ? 1 : 7) {
+            for (u32 round = 0; round < 4; ++round) {
+                u8 foreground = (u8)bench_random();
+                u8 background = (u8)bench_random();
+                for (u32 i = 0; i < sizeof(src); ++i)
+                    src[i] = (u8)bench_random();
+                // NOTE: guard bytes after the row catch writes past it
+                for (u32 i = 0; i < sizeof(expected); ++i)
+                    expected[i] = actual[i] = (u8)bench_random();
+
+                if (bpp == 2) {
+                    pfb__expand_row_2bpp_reference(src, pixel_count, foreground, background, expected);
+                    pfb__expand_row_2bpp(src, pixel_count, foreground, background, actual);
+                } else {
+                    pfb__expand_row_4bpp_reference(src, pixel_count, foreground, background, expected);
+                    pfb__expand_row_4bpp(src, pixel_count, foreground, background, actual);
+                }
+                if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                    char what[96];
+                    snprintf(what, sizeof(what), "%u pixels, foreground %u, background %u",
+                             pixel_count, foreground, background);
+                    mismatch(kernel, what);
+                }
+            }
+        }
+    }
+}
+
+static void check_crc32c() {
+    // NOTE: the check value of the CRC-32C catalogue entry
+    if (pfb__crc32c(0, (const u8*)"123456789", 9) != 0xe3069283u)
+        mismatch("crc32c", "check value of \"123456789\"");
+
+    u8 data[1024 + 8];
+    for (u32 i = 0; i < sizeof(data); ++i)
+        data[i] = (u8)bench_random();
+
+    for (u32 length = 0; length <= 1024; length += length < 64 ? 1 : 61) {
+        for (u32 misalign = 0; misalign < 8; ++misalign) {
+            const u8* src = data + misalign;
+            u32 seed = (u32)bench_random();
+            u32 e = pfb__crc32c_reference(seed, src, length);
+            // NOTE: split in two, the second call continues the first
+            u32 split = length ? (u32)(bench_random() % length) : 0;
+            u32 t = pfb__crc32c_table(pfb__crc32c_table(seed, src, split), src + split, length - split);
+            u32 a = pfb__crc32c(pfb__crc32c(seed, src, split), src + split, length - split);
+            if (e != t || e != a) {
+                char what[64];
+                snprintf(what, sizeof(what), "%u bytes, misaligned by %u", length, misalign);
+                mismatch("crc32c", what);
+            }
+        }
+    }
+}
+
+// NOTE: Table 3-7 of the Unicode standard, every byte range spelled out. Ill
+//   formed input decodes to U+FFFD and skips one byte, like the library does.
+static u32 utf8_reference(const u8** cursor) {
+    const u8* c = *cursor;
+    u32 length = 1;
+    u8 lo = 0x80, hi = 0xbf;
+    if      (c[0] < 0x80)                  length = 1;
+    else if (c[0] >= 0xc2 && c[0] <= 0xdf) length = 2;
+    else if (c[0] == 0xe0)                 { length = 3; lo = 0xa0; }
+    else if (c[0] >= 0xe1 && c[0] <= 0xec) length = 3;
+    else if (c[0] == 0xed)                 { length = 3; hi = 0x9f; }
+    else if (c[0] >= 0xee && c[0] <= 0xef) length = 3;
+    else if (c[0] == 0xf0)                 { length = 4; lo = 0x90; }
+    else if (c[0] >= 0xf1 && c[0] <= 0xf3) length = 4;
+    else if (c[0] == 0xf4)                 { length = 4; hi = 0x8f; }
+    else                                   { *cursor += 1; return 0xfffd; }
+
+    if (length == 1) {
+        *cursor += 1;
+        return c[0];
+    }
+    if (c[1] < lo || c[1] > hi) {
+        *cursor += 1;
+        return 0xfffd;
+    }
+    for (u32 i = 2; i < length; ++i) {
+        if (c[i] < 0x80 || c[i] > 0xbf) {
+            *cursor += 1;
+            return 0xfffd;
+        }
+    }
+
+    u32 cp = c[0] & (0x7f >> length);
+    for (u32 i = 1; i < length; ++i)
+        cp = (cp << 6) | (c[i] & 0x3f);
+    *cursor += length;
+    return cp;
+}
+
+// NOTE: valid sequences of every length (the first utf8_valid_pieces),
+//   overlong encodings, surrogates, values past U+10FFFF, truncated sequences
+//   and bytes that never start one
+static const u32 utf8_valid_pieces = 18;
+static const char* const utf8_pieces[] = {
+    "a", "Z", " ", "\n", "plain ascii run ",
+    "\xc2\x80", "\xc3\xa4", "\xce\xa9", "\xdf\xbf",
+    "\xe0\xa0\x80", "\xe2\x82\xac", "\xe6\x9d\xb1", "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbd",
+    "\xf0\x90\x80\x80", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",
+    "\xc0\xaf", "\xc1\xbf", "\xe0\x80\xaf", "\xe0\x9f\xbf", "\xf0\x80\x80\xaf", "\xf0\x8f\xbf\xbf",
+    "\xed\xa0\x80", "\xed\xbf\xbf",
+    "\xf4\x90\x80\x80", "\xf7\xbf\xbf\xbf", "\xf8\x88\x80\x80\x80",
+    "\xc3", "\xe2\x82", "\xf0\x9f\x98", "\xe2", "\xf0\x9f",
+    "\x80", "\xbf", "\xfe", "\xff",
+};
+
+static u32 random_utf8(u8* dst, u32 capacity) {
+    u32 length = 0;
+    while (true) {
+        const u8* piece;
+        u8 byte;
+        u32 piece_length;
+        if (bench_random() % 4 == 0) {
+            byte = (u8)(1 + bench_random() % 255);
+            piece = &byte;
+            piece_length = 1;
+        } else {
+            piece = (const u8*)utf8_pieces[bench_random() % (sizeof(utf8_pieces) / sizeof(utf8_pieces[0]))];
+            piece_length = (u32)strlen((const char*)piece);
+        }
+        if (length + piece_length >= capacity)
+            break;
+        memcpy(dst + length, piece, piece_length);
+        length += piece_length;
+    }
+    return length;
+}
+
+// NOTE: decodes up to the NUL with all three decoders and compares the
+//   codepoints and where each one leaves the cursor
+static void compare_utf8(const u8* src, u32 length, const char* what) {
+    const u8* e = src;
+    const char* a = (const char*)src;
+    const char* f = (const char*)src;
+    while (*e) {
+        u32 expected = utf8_reference(&e);
+        u32 actual = pixel_font_decode_utf8(&a);
+        u32 fast = (u8)*f < 0x80 ? (u8)*f++ : pixel_font_decode_utf8(&f);
+        if (actual != expected || (const u8*)a != e) {
+            mismatch("utf8.decode", what);
+            return;
+        }
+        if (fast != expected || (const u8*)f != e) {
+            mismatch("utf8.ascii_fast_path", what);
+            return;
+        }
+    }
+    if (e != src + length)
+        mismatch("utf8.decode", "stopped before the NUL");
+}
+
+static void check_utf8() {
+    u8 src[257];
+
+    // NOTE: every one and two byte string, then every lead byte followed by
+    //   every second byte and a NUL in place of the third and fourth
+    for (u32 b0 = 1; b0 < 256; ++b0) {
+        src[0] = (u8)b0;
+        src[1] = 0;
+        compare_utf8(src, 1, "single byte");
+        for (u32 b1 = 1; b1 < 256; ++b1) {
+            src[1] = (u8)b1;
+            src[2] = 0;
+            char what[64];
+            snprintf(what, sizeof(what), "bytes %02x %02x", b0, b1);
+            compare_utf8(src, 2, what);
+            src[2] = 0xbf;
+            src[3] = 0;
+            compare_utf8(src, 3, what);
+            src[3] = 0x80;
+            src[4] = 0;
+            compare_utf8(src, 4, what);
+        }
+    }
+
+    // NOTE: every scalar value round trips, surrogates excluded
+    for (u32 cp = 1; cp <= 0x10ffff; ++cp) {
+        if (cp >= 0xd800 && cp <= 0xdfff)
+            continue;
+        u32 n = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+        static const u8 lead[5] = { 0, 0x00, 0xc0, 0xe0, 0xf0 };
+        for (u32 i = n - 1; i > 0; --i)
+            src[i] = (u8)(0x80 | ((cp >> (6 * (n - 1 - i))) & 0x3f));
+        src[0] = (u8)(lead[n] | (cp >> (6 * (n - 1))));
+        src[n] = 0;
+        const char* cursor = (const char*)src;
+        if (pixel_font_decode_utf8(&cursor) != cp || cursor != (const char*)src + n) {
+            char what[64];
+            snprintf(what, sizeof(what), "U+%04X", cp);
+            mismatch("utf8.decode", what);
+        }
+    }
+
+    for (u32 round = 0; round < 4096; ++round) {
+        u32 length = random_utf8(src, sizeof(src));
+        src[length] = 0;
+        compare_utf8(src, length, "random input");
+
+        // NOTE: a NUL inside a sequence ends the string, the decoder must
+        //   not read past it. The copy ends at the NUL so a sanitizer sees
+        //   an overrun.
+        if (length) {
+            u32 cut = (u32)(bench_random() % length);
+            u8* copy = (u8*)malloc(cut + 1);
+            memcpy(copy, src, cut);
+            copy[cut] = 0;
+            compare_utf8(copy, (u32)strlen((const char*)copy), "NUL inside a sequence");
+            free(copy);
+        }
+    }
+}
+
+//
+//  Timing
+//
+
+template <typename Body>
+static void time_kernel(const char* name, u64 bytes_per_call, Body body) {
+    if (!bench_selected(name))
+        return;
+
+    u64 calls;
+    u64 cycles_start = bench_cycles_now();
+    f64 seconds = bench_run([&]() -> u64 { body(); return 1; }, &calls);
+    u64 cycles = bench_cycles_now() - cycles_start;
+
+    bench_report(name, "cycles_per_byte", (f64)cycles / ((f64)calls * bytes_per_call), "cycles/byte", false);
+    bench_report(name, "bytes_per_second", (f64)calls * bytes_per_call / seconds, "bytes/s");
+}
+
+static void time_hex() {
+    const u32 rows = 4096;
+    for (u32 bytes_per_line : { 1u, 2u, 4u }) {
+        u64 length = (u64)rows * (2 * bytes_per_line + 1);
+        char* src = (char*)malloc(length);
+        u8*   dst = (u8*)malloc((u64)rows * bytes_per_line);
+        for (u64 i = 0; i < length; ++i)
+            src[i] = "0123456789ABCDEF"[bench_random() % 16];
+        for (u32 r = 0; r < rows; ++r)
+            src[(u64)r * (2 * bytes_per_line + 1) + 2 * bytes_per_line] = '\n';
+
+        char name[64];
+        for (u32 fast = 0; fast < 2; ++fast) {
+            snprintf(name, sizeof(name), "kernel.hex.b%u.%s", bytes_per_line, fast ? "fast" : "reference");
+            time_kernel(name, length, [&]() {
+                for (u32 r = 0; r < rows; ++r) {
+                    const char* row = src + (u64)r * (2 * bytes_per_line + 1);
+                    if (fast) pfb__decode_hex(row, dst + r * bytes_per_line, bytes_per_line);
+                    else      pfb__decode_hex_reference(row, dst + r * bytes_per_line, bytes_per_line);
+                }
+            });
+        }
+        free(src);
+        free(dst);
+    }
+}
+
+static void time_threshold_pack() {
+    const u32 rows = 4096;
+    for (u32 width : { 8u, 16u, 24u, 32u, 64u }) {
+        u8* src = (u8*)malloc((u64)rows * width);
+        u8* dst = (u8*)calloc((u64)rows * 9, 1);
+        for (u64 i = 0; i < (u64)rows * width; ++i)
+            src[i] = (u8)bench_random();
+
+        char name[64];
+        for (u32 fast = 0; fast < 2; ++fast) {
+            snprintf(name, sizeof(name), "kernel.threshold_pack.w%u.%s", width, fast ? "fast" : "reference");
+            time_kernel(name, (u64)rows * width, [&]() {
+                for (u32 r = 0; r < rows; ++r) {
+                    if (fast) pfb__threshold_pack(src + (u64)r * width, 1, width, 128, dst + r * 9, r % 8);
+                    else      pfb__threshold_pack_reference(src + (u64)r * width, 1, width, 128, dst + r * 9, r % 8);
+                }
+            });
+        }
+        free(src);
+        free(dst);
+    }
+}
+
+static void time_blit() {
+    const u32 rows   = 4096;
+    const u32 stride = 100; // 800 px
+    u8* fb = (u8*)calloc((u64)rows * stride, 1);
+
+    for (u32 width : { 5u, 8u, 12u, 16u, 24u, 32u, 64u }) {
+        u32 bytes_per_line = (width + 7) / 8;
+        u8* glyph_rows = (u8*)malloc((u64)rows * bytes_per_line);
+        s32* xs = (s32*)malloc(rows * sizeof(s32));
+        for (u64 i = 0; i < (u64)rows * bytes_per_line; ++i)
+            glyph_rows[i] = (u8)bench_random();
+        for (u32 r = 0; r < rows; ++r)
+            xs[r] = (s32)(bench_random() % (stride * 8 - width));
+
+        char name[64];
+        for (u32 fast = 0; fast < 2; ++fast) {
+            snprintf(name, sizeof(name), "kernel.blit_row.w%u.%s", width, fast ? "fast" : "reference");
+            time_kernel(name, (u64)rows * bytes_per_line, [&]() {
+                for (u32 r = 0; r < rows; ++r) {
+                    if (fast) pfb__blit_row(fb + (u64)r * stride, xs[r], glyph_rows + r * bytes_per_line, 0, width);
+                    else      pfb__blit_row_reference(fb + (u64)r * stride, xs[r], glyph_rows + r * bytes_per_line, 0, width);
+                }
+            });
+        }
+        free(glyph_rows);
+        free(xs);
+    }
+    free(fb);
+}
+
+static void time_blit_word() {
+    const u32 rows   = 4096;
+    const u32 stride = 100; // 800 px
+    u8* fb = (u8*)calloc((u64)rows * stride, 1);
+
+    for (u32 width : { 5u, 8u, 12u, 16u, 24u, 32u, 64u }) {
+        u32 row_bytes = width <= 8 ? 1 : width <= 16 ? 2 : width <= 32 ? 4 : 8;
+        u8* glyph_rows = (u8*)aligned_alloc(64, (u64)rows * 8);
+        s32* xs = (s32*)malloc(rows * sizeof(s32));
+        for (u64 i = 0; i < (u64)rows * row_bytes; ++i)
+            glyph_rows[i] = (u8)bench_random();
+        for (u32 r = 0; r < rows; ++r)
+            xs[r] = (s32)(bench_random() % (stride * 8 - width));
+
+        char name[64];
+        snprintf(name, sizeof(name), "kernel.blit_row_word.w%u.fast", width);
+        time_kernel(name, (u64)rows * row_bytes, [&]() {
+            for (u32 r = 0; r < rows; ++r)
+                pfb__blit_row_word(fb + (u64)r * stride, stride, xs[r], glyph_rows + r * row_bytes, row_bytes, 0, width);
+        });
+        free(glyph_rows);
+        free(xs);
+    }
+    free(fb);
+}
+
+static void time_expand() {
+    const u32 rows  = 1404;
+    const u32 width = 1872;
+    u32 stride = width / 8;
+    u8* src = (u8*)malloc((u64)rows * stride);
+    u8* dst = (u8*)malloc((u64)rows * stride * 4);
+    for (u64 i = 0; i < (u64)rows * stride; ++i)
+        src[i] = (u8)bench_random();
+
+    char name[64];
+    for (u32 bpp : { 2u, 4u }) {
+        for (u32 fast = 0; fast < 2; ++fast) {
+            snprintf(name, sizeof(name), "kernel.expand_%ubpp.%s", bpp, fast ? "fast" : "reference");
+            time_kernel(name, (u64)rows * stride, [&]() {
+                for (u32 r = 0; r < rows; ++r) {
+                    const u8* s = src + (u64)r * stride;
+                    u8*       d = dst + (u64)r * stride * bpp;
+                    if (bpp == 2) {
+                        if (fast) pfb__expand_row_2bpp(s, width, 3, 0, d);
+                        else      pfb__expand_row_2bpp_reference(s, width, 3, 0, d);
+                    } else {
+                        if (fast) pfb__expand_row_4bpp(s, width, 0, 1, d);
+                        else      pfb__expand_row_4bpp_reference(s, width, 0, 1, d);
+                    }
+                }
+            });
+        }
+    }
+    free(src);
+    free(dst);
+}
+
+static void time_crc32c() {
+    const u64 length = PIXEL_FONT_BUNDLE_BLOCK_SIZE;
+    u8* data = (u8*)malloc(length);
+    for (u64 i = 0; i < length; ++i)
+        data[i] = (u8)bench_random();
+
+    volatile u32 sink = 0;
+    time_kernel("kernel.crc32c.reference", length, [&]() { sink = pfb__crc32c_reference(sink, data, length); });
+    time_kernel("kernel.crc32c.table",     length, [&]() { sink = pfb__crc32c_table(sink, data, length); });
+    time_kernel("kernel.crc32c.fast",      length, [&]() { sink = pfb__crc32c(sink, data, length); });
+    free(data);
+}
+
+static void time_utf8() {
+    const u32 length = 64 * 1024;
+    u8* ascii = (u8*)malloc(length + 1);
+    u8* mixed = (u8*)malloc(length + 1);
+    for (u32 i = 0; i < length; ++i)
+        ascii[i] = (u8)(' ' + bench_random() % 95);
+    ascii[length] = 0;
+    // NOTE: well formed text with every sequence length
+    u32 mixed_length = 0;
+    while (true) {
+        const char* piece = utf8_pieces[bench_random() % utf8_valid_pieces];
+        u32 piece_length = (u32)strlen(piece);
+        if (mixed_length + piece_length > length)
+            break;
+        memcpy(mixed + mixed_length, piece, piece_length);
+        mixed_length += piece_length;
+    }
+    mixed[mixed_length] = 0;
+
+    volatile u32 sink = 0;
+    struct { const char* name; const u8* text; u32 length; } inputs[] = {
+        { "ascii", ascii, length }, { "mixed", mixed, mixed_length },
+    };
+    for (auto& input : inputs) {
+        char name[64];
+        snprintf(name, sizeof(name), "kernel.utf8.%s.reference", input.name);
+        time_kernel(name, input.length, [&]() {
+            u32 sum = 0;
+            for (const u8* c = input.text; *c; )
+                sum += utf8_reference(&c);
+            sink = sum;
+        });
+        snprintf(name, sizeof(name), "kernel.utf8.%s.decode", input.name);
+        time_kernel(name, input.length, [&]() {
+            u32 sum = 0;
+            for (const char* c = (const char*)input.text; *c; )
+                sum += pixel_font_decode_utf8(&c);
+            sink = sum;
+        });
+        snprintf(name, sizeof(name), "kernel.utf8.%s.ascii_fast_path", input.name);
+        time_kernel(name, input.length, [&]() {
+            u32 sum = 0;
+            for (const char* c = (const char*)input.text; *c; )
+                sum += (u8)*c < 0x80 ? (u8)*c++ : pixel_font_decode_utf8(&c);
+            sink = sum;
+        });
+    }
+    free(ascii);
+    free(mixed);
+}
+
+int main(int argc, char** argv) {
+    if (bench_parse_options(argc, argv) != argc) {
+        fprintf(stderr, "usage: %s [--min-time s] [--filter str] [--json]\n", argv[0]);
+        return 2;
+    }
+
+    check_hex();
+    check_threshold_pack();
+    check_blit();
+    check_blit_word();
+    check_expand();
+    check_crc32c();
+    check_utf8();
+    if (mismatches) {
+        fprintf(stderr, "%u mismatches between the kernels and their references\n", mismatches);
+        return 1;
+    }
+
+    time_hex();
+    time_threshold_pack();
+    time_blit();
+    time_blit_word();
+    time_expand();
+    time_crc32c();
+    time_utf8();
+
+    return 0;
+}
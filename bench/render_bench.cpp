@@ -0,0 +1,508 @@
+/*
+ * Rendering benchmark: draws glyphs and strings into 1-bpp framebuffers.
+ *
+ * Build (ftb has to be on the include path):
+ *
+ *   c++ -O2 -std=c++17 -I.. -I<dir containing ftb> render_bench.cpp -o render_bench -lpthread
+ *
+ * The fonts are synthetic (random glyph bits) so the numbers do not depend on
+ * any font file. Reports glyphs/s and framebuffer bytes/s, where the
+ * framebuffer bytes of a glyph are the bytes its cell covers
+ * (char_px_height * packed row bytes). Hardware counters are reported per
+ * glyph where perf_event_open is allowed.
+ *
+ * The render.dashboard cases draw a frame of many short labels scattered over
+ * the framebuffer (some of them off screen), once with one
+ * pixel_font_draw_string call per label and once through a draw list, and
+ * check that both give the same framebuffer.
+ *
+ * The render.string_cache cases redraw the same 64 labels every frame,
+ * directly and through a Pixel_Font_String_Cache that holds all of them, and
+ * report the cache's hit rate.
+ *
+ * The render.random_bmp_glyph cases draw random glyphs of a font covering the
+ * whole BMP from tables in 4 KiB, explicit huge (needs nr_hugepages) and
+ * transparent huge pages, where the dTLB misses dominate.
+ */
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#define PIXEL_FONT_BAKER_IMPL
+#include "../pixel_font_baker.hpp"
+#include "bench_common.hpp"
+
+static const u32 cell_widths[] = { 5, 6, 8, 10, 12, 16, 24, 32 };
+
+struct Framebuffer_Size {
+    u32 width;
+    u32 height;
+};
+
+static const Framebuffer_Size framebuffer_sizes[] = {
+    { 800,  480  },
+    { 1872, 1404 },
+};
+
+// NOTE: The table is malloc'ed here, so it is freed with free() and not
+//   destroy_pixel_font.
+static Pixel_Font make_synthetic_font(u32 width, u32 unicode_cp_end = 0x4ff /* Latin, Greek and Cyrillic */) {
+    Pixel_Font font = {};
+    font.char_px_width    = (u16)width;
+    font.char_px_height   = (u16)(width * 2);
+    font.bytes_per_line   = (width + 7) / 8;
+    font.bytes_per_glyph  = font.bytes_per_line * font.char_px_height;
+    font.unicode_cp_start = 0x20;
+    font.unicode_cp_end   = unicode_cp_end;
+
+    u64 glyph_count = font.unicode_cp_end - font.unicode_cp_start + 1;
+    font.table = (u8*)malloc(glyph_count * font.bytes_per_glyph);
+
+    // NOTE: random bits, with the padding bits right of the cell cleared
+    u8 last_byte_mask = (u8)(0xff00 >> (width - (font.bytes_per_line - 1) * 8));
+    for (u64 i = 0; i < glyph_count * font.bytes_per_glyph; ++i) {
+        u8 bits = (u8)bench_random();
+        if (i % font.bytes_per_line == font.bytes_per_line - 1)
+            bits &= last_byte_mask;
+        font.table[i] = bits;
+    }
+
+    return font;
+}
+
+static Pixel_Font_Framebuffer make_framebuffer(Framebuffer_Size size) {
+    Pixel_Font_Framebuffer fb;
+    fb.width  = size.width;
+    fb.height = size.height;
+    fb.stride = (size.width + 7) / 8;
+    fb.data   = (u8*)calloc((u64)fb.stride * fb.height, 1);
+    return fb;
+}
+
+// NOTE: bench_run with the hardware counters running around it.
+template <typename Body>
+static f64 run_counted(Body body, u64* out_glyphs, Bench_Counter_Values* counters) {
+    bench_counters_start(counters);
+    f64 seconds = bench_run(body, out_glyphs);
+    bench_counters_stop(counters);
+    return seconds;
+}
+
+static void report(const char* name, const Pixel_Font* font, u64 glyphs, f64 seconds,
+                   const Bench_Counter_Values* counters)
+{
+    bench_report(name, "glyphs_per_second", glyphs / seconds, "glyphs/s");
+    bench_report(name, "fb_bytes_per_second",
+                 (f64)glyphs * font->char_px_height * ((font->char_px_width + 7) / 8) / seconds, "bytes/s");
+    bench_report_counters(name, counters, glyphs, "glyph");
+}
+
+static void bench_single_glyphs(const Pixel_Font* font, Pixel_Font_Framebuffer* fb, const char* layout = "") {
+    char name[128];
+    snprintf(name, sizeof(name), "render.glyph.w%u.%ux%u%s", font->char_px_width, fb->width, fb->height, layout);
+    if (!bench_selected(name))
+        return;
+
+    // NOTE: positions and codepoints are rolled up front, so only the blit is timed
+    const u32 count = 4096;
+    s32 xs[count], ys[count];
+    u32 cps[count];
+    for (u32 i = 0; i < count; ++i) {
+        xs[i]  = (s32)(bench_random() % (fb->width  - font->char_px_width));
+        ys[i]  = (s32)(bench_random() % (fb->height - font->char_px_height));
+        cps[i] = 0x20 + (u32)(bench_random() % 0x5f);
+    }
+
+    u64 glyphs;
+    Bench_Counter_Values counters;
+    f64 seconds = run_counted([&]() -> u64 {
+        for (u32 i = 0; i < count; ++i)
+            pixel_font_draw_glyph(fb, font, cps[i], xs[i], ys[i]);
+        return count;
+    }, &glyphs, &counters);
+
+    report(name, font, glyphs, seconds, &counters);
+}
+
+static void bench_ascii_lines(const Pixel_Font* font, Pixel_Font_Framebuffer* fb) {
+    char name[128];
+    snprintf(name, sizeof(name), "render.ascii_line.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    if (!bench_selected(name))
+        return;
+
+    u32 length = fb->width / font->char_px_width;
+    char* line = (char*)malloc(length + 1);
+    for (u32 i = 0; i < length; ++i)
+        line[i] = (char)(0x20 + (bench_random() % 0x5f));
+    line[length] = '\0';
+
+    u32 rows = fb->height / font->char_px_height;
+    u32 row  = 0;
+
+    u64 glyphs;
+    Bench_Counter_Values counters;
+    f64 seconds = run_counted([&]() -> u64 {
+        u32 drawn = pixel_font_draw_string(fb, font, line, 0, (s32)(row * font->char_px_height));
+        row = (row + 1) % rows;
+        return drawn;
+    }, &glyphs, &counters);
+
+    report(name, font, glyphs, seconds, &counters);
+    free(line);
+}
+
+static void bench_utf8_paragraphs(const Pixel_Font* font, Pixel_Font_Framebuffer* fb) {
+    char name[128];
+    snprintf(name, sizeof(name), "render.utf8_paragraph.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    if (!bench_selected(name))
+        return;
+
+    // NOTE: ASCII, Latin-1, Greek and Cyrillic are in the font, the CJK
+    //   codepoints are not and are skipped
+    static const char* words[] = {
+        "Temperatur", "Größe", "naïve", "café", "Ωμέγα", "λόγος", "Привет",
+        "мир", "東京", "20°C", "±0.5", "résumé", "Ärger", "ß", "über",
+    };
+    const u32 word_count = sizeof(words) / sizeof(words[0]);
+
+    u32 columns = fb->width / font->char_px_width;
+    u32 lines   = fb->height / font->char_px_height;
+
+    // NOTE: line breaks are inserted roughly where a line would run out of
+    //   columns, the paragraph covers the framebuffer once
+    u64 capacity = (u64)lines * (columns * 4 + 1) + 1;
+    char* paragraph = (char*)malloc(capacity);
+    u64 length = 0;
+    for (u32 l = 0; l < lines; ++l) {
+        u32 column = 0;
+        while (true) {
+            const char* word = words[bench_random() % word_count];
+            u32 word_columns = 0;
+            for (const char* c = word; *c; pixel_font_decode_utf8(&c))
+                ++word_columns;
+            if (column + word_columns + 1 > columns)
+                break;
+            u64 bytes = strlen(word);
+            memcpy(paragraph + length, word, bytes);
+            length += bytes;
+            paragraph[length++] = ' ';
+            column += word_columns + 1;
+        }
+        paragraph[length++] = '\n';
+    }
+    paragraph[length] = '\0';
+
+    u64 glyphs;
+    Bench_Counter_Values counters;
+    f64 seconds = run_counted([&]() -> u64 {
+        return pixel_font_draw_string(fb, font, paragraph, 0, 0);
+    }, &glyphs, &counters);
+
+    report(name, font, glyphs, seconds, &counters);
+    free(paragraph);
+}
+
+static void bench_clipped(const Pixel_Font* font, Pixel_Font_Framebuffer* fb) {
+    char name[128];
+    snprintf(name, sizeof(name), "render.clipped.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    if (!bench_selected(name))
+        return;
+
+    // NOTE: short strings that straddle each of the four framebuffer edges
+    const char* text = "Clipped text 0123456789";
+    s32 text_width   = (s32)strlen(text) * font->char_px_width;
+    s32 w = (s32)fb->width;
+    s32 h = (s32)fb->height;
+    s32 ch = font->char_px_height;
+
+    const s32 positions[][2] = {
+        { -text_width / 2,     h / 2 },
+        { w - text_width / 2,  h / 3 },
+        { w / 4,              -ch / 2 },
+        { w / 3,               h - ch / 2 },
+        { -text_width / 3,    -ch / 3 },
+        { w - text_width / 3,  h - ch / 3 },
+    };
+    const u32 position_count = sizeof(positions) / sizeof(positions[0]);
+
+    u64 glyphs;
+    Bench_Counter_Values counters;
+    f64 seconds = run_counted([&]() -> u64 {
+        u64 drawn = 0;
+        for (u32 i = 0; i < position_count; ++i)
+            drawn += pixel_font_draw_string(fb, font, text, positions[i][0], positions[i][1]);
+        return drawn;
+    }, &glyphs, &counters);
+
+    report(name, font, glyphs, seconds, &counters);
+}
+
+static void bench_full_screen(const Pixel_Font* font, Pixel_Font_Framebuffer* fb) {
+    char name[128];
+    snprintf(name, sizeof(name), "render.fill.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    if (!bench_selected(name))
+        return;
+
+    u32 columns = fb->width  / font->char_px_width;
+    u32 rows    = fb->height / font->char_px_height;
+
+    char* line = (char*)malloc(columns + 1);
+    for (u32 i = 0; i < columns; ++i)
+        line[i] = (char)(0x21 + (bench_random() % 0x5e));
+    line[columns] = '\0';
+
+    u64 glyphs;
+    Bench_Counter_Values counters;
+    f64 seconds = run_counted([&]() -> u64 {
+        memset(fb->data, 0, (u64)fb->stride * fb->height);
+        u64 drawn = 0;
+        for (u32 r = 0; r < rows; ++r)
+            drawn += pixel_font_draw_string(fb, font, line, 0, (s32)(r * font->char_px_height));
+        return drawn;
+    }, &glyphs, &counters);
+
+    report(name, font, glyphs, seconds, &counters);
+
+    // NOTE: also as whole screens per second, as that is what a refresh needs
+    bench_report(name, "screens_per_second", glyphs / (f64)((u64)columns * rows) / seconds, "screens/s");
+
+    free(line);
+}
+
+static void bench_dashboard(const Pixel_Font* font, Pixel_Font_Framebuffer* fb) {
+    char names[2][128];
+    snprintf(names[0], sizeof(names[0]), "render.dashboard.calls.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    snprintf(names[1], sizeof(names[1]), "render.dashboard.draw_list.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    if (!bench_selected(names[0]) && !bench_selected(names[1]))
+        return;
+
+    // NOTE: labels of 4 to 15 characters, every 8th one off screen
+    const u32 label_count = 512;
+    char labels[label_count][16];
+    s32  xs[label_count], ys[label_count];
+    for (u32 i = 0; i < label_count; ++i) {
+        u32 length = 4 + (u32)(bench_random() % 12);
+        for (u32 c = 0; c < length; ++c)
+            labels[i][c] = (char)(0x21 + (bench_random() % 0x5e));
+        labels[i][length] = '\0';
+
+        xs[i] = (s32)(bench_random() % fb->width) - (s32)(length * font->char_px_width) / 2;
+        ys[i] = (s32)(bench_random() % fb->height) - font->char_px_height / 2;
+        if (i % 8 == 0)
+            ys[i] = (i % 16 == 0) ? -2 * font->char_px_height : (s32)fb->height + font->char_px_height;
+    }
+
+    u64 fb_size = (u64)fb->stride * fb->height;
+    Pixel_Font_Draw_List list = {};
+
+    auto draw_calls = [&]() -> u64 {
+        for (u32 i = 0; i < label_count; ++i)
+            pixel_font_draw_string(fb, font, labels[i], xs[i], ys[i]);
+        return label_count;
+    };
+    auto draw_list = [&]() -> u64 {
+        pixel_font_draw_list_clear(&list);
+        for (u32 i = 0; i < label_count; ++i)
+            pixel_font_draw_list_add(&list, font, labels[i], xs[i], ys[i]);
+        pixel_font_draw_list_render(fb, &list);
+        return label_count;
+    };
+
+    u8* expected = (u8*)malloc(fb_size);
+    memset(fb->data, 0, fb_size);
+    draw_calls();
+    memcpy(expected, fb->data, fb_size);
+    memset(fb->data, 0, fb_size);
+    draw_list();
+    if (memcmp(expected, fb->data, fb_size) != 0)
+        fprintf(stderr, "%s: framebuffer differs from the individual calls\n", names[1]);
+    free(expected);
+
+    for (u32 v = 0; v < 2; ++v) {
+        if (!bench_selected(names[v]))
+            continue;
+
+        u64 labels_drawn;
+        Bench_Counter_Values counters;
+        f64 seconds = v == 0 ? run_counted(draw_calls, &labels_drawn, &counters)
+                             : run_counted(draw_list,  &labels_drawn, &counters);
+        bench_report(names[v], "labels_per_second", labels_drawn / seconds, "labels/s");
+        bench_report(names[v], "frames_per_second", labels_drawn / (f64)label_count / seconds, "frames/s");
+        bench_report_counters(names[v], &counters, labels_drawn, "label");
+    }
+
+    destroy_pixel_font_draw_list(&list);
+}
+
+static void bench_string_cache(const Pixel_Font* font, Pixel_Font_Framebuffer* fb) {
+    char names[2][128];
+    snprintf(names[0], sizeof(names[0]), "render.string_cache.direct.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    snprintf(names[1], sizeof(names[1]), "render.string_cache.cached.w%u.%ux%u", font->char_px_width, fb->width, fb->height);
+    if (!bench_selected(names[0]) && !bench_selected(names[1]))
+        return;
+
+    // NOTE: labels of 4 to 15 characters at fixed places, like the units
+    //   and names of a dashboard
+    const u32 label_count = 64;
+    char labels[label_count][16];
+    s32  xs[label_count], ys[label_count];
+    for (u32 i = 0; i < label_count; ++i) {
+        u32 length = 4 + (u32)(bench_random() % 12);
+        for (u32 c = 0; c < length; ++c)
+            labels[i][c] = (char)(0x21 + (bench_random() % 0x5e));
+        labels[i][length] = '\0';
+        xs[i] = (s32)(bench_random() % (fb->width - length * font->char_px_width));
+        ys[i] = (s32)(bench_random() % (fb->height - font->char_px_height));
+    }
+
+    Pixel_Font_String_Cache cache;
+    if (create_pixel_font_string_cache(1 << 20, &cache) != Pixel_Font_Baker_Error::SUCCESS)
+        return;
+
+    for (u32 v = 0; v < 2; ++v) {
+        if (!bench_selected(names[v]))
+            continue;
+
+        u64 glyphs;
+        Bench_Counter_Values counters;
+        f64 seconds = run_counted([&]() -> u64 {
+            u64 drawn = 0;
+            for (u32 i = 0; i < label_count; ++i) {
+                drawn += v == 0 ? pixel_font_draw_string(fb, font, labels[i], xs[i], ys[i])
+                                : pixel_font_draw_string_cached(&cache, fb, font, labels[i], xs[i], ys[i]);
+            }
+            return drawn;
+        }, &glyphs, &counters);
+
+        report(names[v], font, glyphs, seconds, &counters);
+        if (v == 1) {
+            bench_report(names[v], "hit_rate", (f64)cache.stats.hits / (f64)(cache.stats.hits + cache.stats.misses), "hits/lookup");
+            bench_report(names[v], "cache_bytes", (f64)cache.stats.bytes, "bytes", false);
+        }
+    }
+
+    destroy_pixel_font_string_cache(&cache);
+}
+
+// NOTE: Random glyphs from a font covering the whole BMP, with the table
+//   loaded into each kind of pages. With 4 KiB pages nearly every glyph is
+//   a TLB miss once the table is a few MB.
+static const u32 bmp_cell_widths[] = { 16, 32, 48 };
+
+static const struct {
+    Pixel_Font_Table_Pages pages;
+    const char*            name;
+} table_pages[] = {
+    { Pixel_Font_Table_Pages::DEFAULT,          "default"  },
+    { Pixel_Font_Table_Pages::HUGE_TLB,         "huge_tlb" },
+    { Pixel_Font_Table_Pages::TRANSPARENT_HUGE, "thp"      },
+};
+
+static void bench_random_bmp_glyphs(u32 width, Pixel_Font_Framebuffer* fb) {
+    bool any_selected = false;
+    char names[3][128];
+    for (u32 p = 0; p < 3; ++p) {
+        snprintf(names[p], sizeof(names[p]), "render.random_bmp_glyph.w%u.%ux%u.%s",
+                 width, fb->width, fb->height, table_pages[p].name);
+        any_selected |= bench_selected(names[p]);
+    }
+    if (!any_selected)
+        return;
+
+    // NOTE: the tables are loaded from a baked font file, the same way a
+    //   render service gets them
+    char path[] = "/tmp/pixel_font_render_bmp_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return;
+    close(fd);
+    {
+        Pixel_Font font = make_synthetic_font(width, 0xffff);
+        Pixel_Font_Baker_Error error = save_pixel_font(&font, path);
+        free(font.table);
+        if (error != Pixel_Font_Baker_Error::SUCCESS) {
+            unlink(path);
+            return;
+        }
+    }
+
+    // NOTE: more codepoints than any TLB has entries, rolled up front
+    const u32 count = 1 << 16;
+    s32* xs  = (s32*)malloc(count * sizeof(s32));
+    s32* ys  = (s32*)malloc(count * sizeof(s32));
+    u32* cps = (u32*)malloc(count * sizeof(u32));
+    for (u32 i = 0; i < count; ++i) {
+        xs[i]  = (s32)(bench_random() % (fb->width  - width));
+        ys[i]  = (s32)(bench_random() % (fb->height - width * 2));
+        cps[i] = 0x20 + (u32)(bench_random() % (0xffff - 0x20 + 1));
+    }
+
+    for (u32 p = 0; p < 3; ++p) {
+        if (!bench_selected(names[p]))
+            continue;
+
+        Pixel_Font font;
+        if (load_pixel_font(path, &font, table_pages[p].pages) != Pixel_Font_Baker_Error::SUCCESS)
+            continue;
+
+        if (pixel_font_table_pages(&font) != table_pages[p].pages)
+            fprintf(stderr, "%s: %s pages are not available, the table fell back to default pages\n",
+                    names[p], table_pages[p].name);
+
+        u64 glyphs;
+        Bench_Counter_Values counters;
+        f64 seconds = run_counted([&]() -> u64 {
+            for (u32 i = 0; i < count; ++i)
+                pixel_font_draw_glyph(fb, &font, cps[i], xs[i], ys[i]);
+            return count;
+        }, &glyphs, &counters);
+
+        report(names[p], &font, glyphs, seconds, &counters);
+        destroy_pixel_font(&font);
+    }
+
+    free(xs);
+    free(ys);
+    free(cps);
+    unlink(path);
+}
+
+int main(int argc, char** argv) {
+    if (bench_parse_options(argc, argv) != argc) {
+        fprintf(stderr, "usage: %s [--min-time s] [--filter str] [--json] [--no-counters]\n", argv[0]);
+        return 2;
+    }
+
+    for (Framebuffer_Size size : framebuffer_sizes) {
+        Pixel_Font_Framebuffer fb = make_framebuffer(size);
+
+        for (u32 width : cell_widths) {
+            Pixel_Font font = make_synthetic_font(width);
+
+            bench_single_glyphs(&font, &fb);
+            if (width == 8 || width == 16) {
+                bench_ascii_lines(&font, &fb);
+                bench_utf8_paragraphs(&font, &fb);
+                bench_clipped(&font, &fb);
+                bench_dashboard(&font, &fb);
+                bench_string_cache(&font, &fb);
+            }
+            bench_full_screen(&font, &fb);
+
+            // NOTE: the same glyphs with every row in one 64-bit word and
+            //   64-byte aligned glyphs, the single load row blit
+            Pixel_Font word_font;
+            if (create_pixel_font_with_row_layout(&font, 8, 64, &word_font) == Pixel_Font_Baker_Error::SUCCESS) {
+                bench_single_glyphs(&word_font, &fb, ".word64");
+                destroy_pixel_font(&word_font);
+            }
+
+            free(font.table);
+        }
+
+        for (u32 width : bmp_cell_widths)
+            bench_random_bmp_glyphs(width, &fb);
+
+        free(fb.data);
+    }
+
+    return 0;
+}
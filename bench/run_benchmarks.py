@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Runs benchmark suites repeatedly and compares them against a baseline.
+
+Every suite is a benchmark command from this directory (it gets --json
+appended). Each one runs --runs times. For every (case, metric) the median
+and a distribution-free 95% confidence interval of the median are computed.
+
+    ./run_benchmarks.py --runs 7 --save base.json \\
+        --suite "./render_bench --min-time 0.1" \\
+        --suite "./bake_bench --min-time 0.1 font.ttf"
+
+    # later, e.g. on a branch:
+    ./run_benchmarks.py --runs 7 --baseline base.json --threshold 5 \\
+        --suite "./render_bench --min-time 0.1" \\
+        --suite "./bake_bench --min-time 0.1 font.ttf"
+
+A tracked metric (--track, glyphs/s, peak RSS and time-to-first-glyph by
+default) regresses when its median is more than --threshold percent worse
+than the baseline median, and the baseline median is outside the new
+confidence interval. The script exits with 1 if any tracked metric
+regressed.
+"""
+
+import argparse
+import json
+import math
+import re
+import shlex
+import subprocess
+import sys
+
+DEFAULT_TRACKED = r"^(glyphs_per_second|peak_rss|time_to_first_glyph)$"
+
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    mid = n // 2
+    return values[mid] if n % 2 else (values[mid - 1] + values[mid]) / 2
+
+
+def median_confidence_interval(values):
+    """Order statistic based 95% interval of the median, [min, max] for few samples."""
+    values = sorted(values)
+    n = len(values)
+    if n < 6:
+        return values[0], values[-1]
+    spread = 1.96 * math.sqrt(n) / 2
+    lo = max(0, int(math.floor(n / 2 - spread)) - 1)
+    hi = min(n - 1, int(math.ceil(n / 2 + spread)))
+    return values[lo], values[hi]
+
+
+def run_suites(suites, runs):
+    samples = {}
+    for run in range(runs):
+        for suite in suites:
+            command = shlex.split(suite) + ["--json"]
+            print(f"[{run + 1}/{runs}] {suite}", file=sys.stderr)
+            result = subprocess.run(command, stdout=subprocess.PIPE, text=True)
+            if result.returncode != 0:
+                sys.exit(f"suite failed with exit code {result.returncode}: {suite}")
+            for line in result.stdout.splitlines():
+                line = line.strip()
+                if not line.startswith("{"):
+                    continue
+                entry = json.loads(line)
+                key = f"{entry['name']}/{entry['metric']}"
+                slot = samples.setdefault(key, {
+                    "unit": entry["unit"],
+                    "higher_is_better": entry["higher_is_better"],
+                    "samples": [],
+                })
+                slot["samples"].append(entry["value"])
+
+    results = {}
+    for key, slot in samples.items():
+        lo, hi = median_confidence_interval(slot["samples"])
+        results[key] = {
+            "median": median(slot["samples"]),
+            "ci_low": lo,
+            "ci_high": hi,
+            "unit": slot["unit"],
+            "higher_is_better": slot["higher_is_better"],
+            "samples": slot["samples"],
+        }
+    return results
+
+
+def current_commit():
+    try:
+        return subprocess.run(["git", "rev-parse", "HEAD"], stdout=subprocess.PIPE,
+                              stderr=subprocess.DEVNULL, text=True).stdout.strip()
+    except OSError:
+        return ""
+
+
+def compare(results, baseline, threshold, tracked):
+    regressions = 0
+    print(f"{'case/metric':60} {'median':>14} {'95% ci':>27} {'baseline':>14} {'change':>8}  status")
+    for key in sorted(results):
+        r = results[key]
+        metric = key.rsplit("/", 1)[1]
+        ci = f"[{r['ci_low']:.4g}, {r['ci_high']:.4g}]"
+        base = baseline.get(key)
+        if base is None:
+            print(f"{key:60} {r['median']:14.4g} {ci:>27} {'-':>14} {'-':>8}  new")
+            continue
+
+        change = (r["median"] - base["median"]) / base["median"] * 100 if base["median"] else 0.0
+        worse = -change if r["higher_is_better"] else change
+        significant = not (r["ci_low"] <= base["median"] <= r["ci_high"])
+
+        status = "ok"
+        if worse > threshold and significant:
+            if tracked.search(metric):
+                status = "REGRESSION"
+                regressions += 1
+            else:
+                status = "worse (untracked)"
+        elif -worse > threshold and significant:
+            status = "better"
+
+        print(f"{key:60} {r['median']:14.4g} {ci:>27} {base['median']:14.4g} {change:+7.1f}%  {status}")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--suite", action="append", required=True, help="benchmark command, may be repeated")
+    parser.add_argument("--runs", type=int, default=5, help="runs per suite (default 5)")
+    parser.add_argument("--baseline", help="JSON written by --save of an earlier run")
+    parser.add_argument("--save", help="write the results as JSON, usable as a later --baseline")
+    parser.add_argument("--threshold", type=float, default=5.0, help="allowed regression in percent (default 5)")
+    parser.add_argument("--track", default=DEFAULT_TRACKED, help="regex of metric names that fail the run")
+    args = parser.parse_args()
+
+    if args.runs < 1:
+        sys.exit("--runs has to be at least 1")
+
+    results = run_suites(args.suite, args.runs)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"commit": current_commit(), "runs": args.runs, "results": results}, f, indent=2)
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["results"]
+
+    regressions = compare(results, baseline, args.threshold, re.compile(args.track))
+    if regressions:
+        print(f"{regressions} tracked metric(s) regressed by more than {args.threshold}%", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
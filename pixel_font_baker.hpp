@@ -30,6 +30,25 @@
 #include <math.h>
 #include <ftb/core.hpp>
 
+// NOTE: Define PIXEL_FONT_BAKER_FIXED_POINT as 1 to rasterize ttf glyphs with
+//   the integer rasterizer by default, for targets without an FPU, see
+//   Pixel_Font_Bake_Options::fixed_point_rasterizer.
+#ifndef PIXEL_FONT_BAKER_FIXED_POINT
+#define PIXEL_FONT_BAKER_FIXED_POINT 0
+#endif
+
+// NOTE: Metrics of one glyph in pixels, for laying out proportional text
+//   without the font file. x goes right from the pen, y down from the
+//   baseline. The box is the one the font gives the glyph (the outline's
+//   pixel box, the strike's or the BDF BBX), it is not clipped to the cell.
+struct Pixel_Font_Glyph_Metrics {
+    s16 advance;    // how far the pen moves
+    s16 ink_x;      // left edge of the box, the left side bearing
+    s16 ink_y;      // top edge of the box, negative above the baseline
+    u16 ink_width;  // 0 for glyphs without an outline
+    u16 ink_height;
+};
+
 // NOTE(Felix): Pixel_Font* can be casted to Waveshare's sFONT*
 struct Pixel_Font {
     u8* table;
@@ -39,17 +58,75 @@ struct Pixel_Font {
     // Additional (redundant) info, not in Waveshare's sFONT:
     u32 bytes_per_line;
     u32 bytes_per_glyph;
+
+    // The table holds the glyphs for [unicode_cp_start, unicode_cp_end]
+    u32 unicode_cp_start;
+    u32 unicode_cp_end;
+
+    // The table points into memory the font does not own (a mapped bundle),
+    // destroy_pixel_font leaves it alone.
+    bool table_is_borrowed;
+
+    // Optional, see Pixel_Font_Bake_Options::glyph_metrics: one entry per
+    // codepoint of the range, in the table's block right after the glyphs,
+    // nullptr without. The cell of a glyph whose pen is at (x, y) on the
+    // baseline has its top left corner at (x + cell_x, y - baseline).
+    Pixel_Font_Glyph_Metrics* glyph_metrics;
+    s16 cell_x;
+    s16 baseline;
+    s16 line_height;
+};
+
+// NOTE: Layout of a baked font file (as written by save_pixel_font and
+//   bake_pixel_font_file_from_ttf): this header, followed by the table at
+//   header_size. Fields are stored in host (little endian) byte order.
+//   With PIXEL_FONT_FILE_GLYPH_METRICS in flags the glyph metrics follow the
+//   table, at the next multiple of 8 bytes from its start. Version 1 files,
+//   written before the glyph metrics, have a 40 byte header that ends at
+//   flags and load as no flags. Version 2 added flags, cell_x, baseline and
+//   line_height.
+#define PIXEL_FONT_FILE_MAGIC   "PXFT"
+#define PIXEL_FONT_FILE_VERSION 2
+
+#define PIXEL_FONT_FILE_GLYPH_METRICS 0x1
+
+struct Pixel_Font_Header {
+    char magic[4];
+    u16  version;
+    u16  header_size;
+    u16  char_px_width;
+    u16  char_px_height;
+    u32  bytes_per_line;
+    u32  bytes_per_glyph;
+    u32  unicode_cp_start;
+    u32  unicode_cp_end;
+    u32  reserved;
+    u64  table_size;
+    u16  flags;
+    s16  cell_x;      // see Pixel_Font, only with glyph metrics
+    s16  baseline;
+    s16  line_height;
 };
 
 #define PIXEL_FONT_BAKER_ERRORS                                \
     ERROR(SUCCESS)                                             \
     ERROR(MALLOC_FAILED)                                       \
     ERROR(FONT_FILE_COULD_NOT_BE_OPENED)                       \
+    ERROR(FONT_FILE_COULD_NOT_BE_WRITTEN)                      \
+    ERROR(BAKED_FONT_FILE_INVALID)                             \
     ERROR(BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX)                 \
     ERROR(BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX_CORRECTLY)       \
     ERROR(BDF_DID_NOT_SPECIFY_CODEPOINT_CORRECTLY)             \
     ERROR(BDF_ERROR_PARSING_CHARACTER_BYTES)                   \
     ERROR(STB_TRUETYPE_FAILED)                                 \
+    ERROR(FONT_NAME_TOO_LONG)                                  \
+    ERROR(DUPLICATE_FONT_IN_BUNDLE)                            \
+    ERROR(FONT_NOT_IN_BUNDLE)                                  \
+    ERROR(FONT_TOO_LARGE_FOR_GFX)                              \
+    ERROR(BAKED_FONT_FILE_CHECKSUM_MISMATCH)                   \
+    ERROR(ROW_LAYOUT_INVALID)                                  \
+    ERROR(TABLE_OVER_BUDGET)                                   \
+    ERROR(FONT_FILE_DECOMPRESSION_FAILED)                      \
 
 enum struct Pixel_Font_Baker_Error {
 #define ERROR(key) key,
@@ -57,375 +134,5685 @@ enum struct Pixel_Font_Baker_Error {
 #undef ERROR
 };
 
+// NOTE: Throughput of the individual bake stages. Busy time is the time spent
+//   working on glyphs, stall time is the time spent waiting on a full or empty
+//   queue, so the stage with the least stall time is the bottleneck.
+struct Pixel_Font_Bake_Stage_Stats {
+    u64 items;
+    f64 busy_seconds;
+    f64 stall_seconds;
+};
+
+struct Pixel_Font_Bake_Stats {
+    Pixel_Font_Bake_Stage_Stats rasterize;
+    Pixel_Font_Bake_Stage_Stats pack;
+    Pixel_Font_Bake_Stage_Stats write; // only when streaming to a file
+    f64 first_glyph_seconds;           // from the start of the bake until the first glyph is packed
+    f64 total_seconds;
+    u64 strike_glyphs;                 // glyphs copied from an embedded bitmap strike, not rasterized
+};
+
+// NOTE: Pages a table is allocated in. Tables of fonts covering the whole BMP
+//   are hundreds of MB, drawing random glyphs from them misses the TLB on
+//   nearly every glyph with 4 KiB pages.
+//     DEFAULT          - through the allocator
+//     HUGE             - HUGE_TLB if it works, else TRANSPARENT_HUGE
+//     HUGE_TLB         - explicit 2 MiB pages (mmap with MAP_HUGETLB), which
+//                        need pages reserved in /proc/sys/vm/nr_hugepages
+//     TRANSPARENT_HUGE - a 2 MiB aligned anonymous mapping advised with
+//                        MADV_HUGEPAGE, which the kernel backs with huge
+//                        pages when transparent huge pages are enabled
+//   Whatever can not be had falls back to DEFAULT. Mapped tables do not go
+//   through the allocator. Linux only, DEFAULT elsewhere.
+enum struct Pixel_Font_Table_Pages {
+    DEFAULT,
+    HUGE,
+    HUGE_TLB,
+    TRANSPARENT_HUGE,
+};
+
+// NOTE: Table layouts a Pixel_Font can hold, from the cheapest to draw from
+//   to the smallest. Both have a glyph for every codepoint of the range:
+//     WORD_ROWS - every row in the smallest word it fits (up to 8 bytes),
+//                 64 byte aligned glyphs, see
+//                 create_pixel_font_with_row_layout
+//     PACKED    - (char_px_width+7)/8 bytes per row, glyphs back to back
+//   The sparse, deduplicated and compressed sizes of Pixel_Font_Size_Estimate
+//   are measured only, a Pixel_Font can not hold those.
+#define PIXEL_FONT_TABLE_LAYOUTS                                               \
+    LAYOUT(WORD_ROWS)                                                          \
+    LAYOUT(PACKED)                                                             \
+
+enum struct Pixel_Font_Table_Layout {
+#define LAYOUT(key) key,
+    PIXEL_FONT_TABLE_LAYOUTS
+#undef LAYOUT
+    COUNT
+};
+
+enum struct Pixel_Font_Layout_Preference {
+    FASTEST,  // the cheapest layout to draw from that fits the budget
+    SMALLEST, // the smallest layout that fits
+};
+
+struct Pixel_Font_Layout_Choice;
+
+struct Pixel_Font_Bake_Options {
+    // NOTE: 0 runs all stages on the calling thread. Otherwise rasterization
+    //   runs on this many worker threads and the calling thread packs.
+    u32 rasterize_threads = 0;
+    // NOTE: Number of rasterized glyphs a worker may have in flight before it
+    //   blocks on the packer.
+    u32 queue_depth = 8;
+    // NOTE: When baking straight to a file, only this many glyphs are kept in
+    //   memory (twice that with worker threads) before they are written out.
+    u32 stream_window_glyphs = 4096;
+    // NOTE: Row storage of the table, see create_pixel_font_with_row_layout.
+    //   0 and 0 keep the rows packed.
+    u32 row_word_bytes  = 0;
+    u32 glyph_alignment = 0;
+    // NOTE: Only for tables kept in memory, see Pixel_Font_Table_Pages.
+    Pixel_Font_Table_Pages table_pages = Pixel_Font_Table_Pages::DEFAULT;
+    // NOTE: Copy the glyphs of an embedded bitmap strike (EBLC/EBDT) of the
+    //   requested height instead of rasterizing the outlines, see
+    //   create_pixel_font_from_ttf.
+    bool embedded_bitmaps = true;
+    // NOTE: Also bake Pixel_Font::glyph_metrics (10 bytes per glyph) from the
+    //   font's horizontal metrics and glyph boxes, or DWIDTH and BBX for
+    //   bdf. They are saved, bundled and written as C source with the table.
+    bool glyph_metrics = false;
+    // NOTE: Rasterize the outlines with integer math only (32.32 scale, 24.8
+    //   edges, 16 sample rows per pixel) instead of stb_truetype's float
+    //   rasterizer. The thresholded glyphs differ from the float ones only in
+    //   pixels whose coverage is within a few percent of the threshold.
+    bool fixed_point_rasterizer = PIXEL_FONT_BAKER_FIXED_POINT;
+    // NOTE: Glyphs whose oversampled gray bitmap is larger than this (in
+    //   bytes) are rasterized in horizontal strips of at most this size, and
+    //   every strip is filtered and packed before the next one. Large cells
+    //   (hundreds of pixels, supersampled) then bake in cache sized scratch
+    //   memory. The fixed point rasterizer gives the same table either way,
+    //   stb_truetype's restarts its edges at every strip, which can flip a
+    //   pixel whose coverage sits right at the threshold. 0 always
+    //   rasterizes whole glyphs.
+    u32 raster_strip_bytes = 0;
+    // NOTE: With a budget (in bytes) the glyphs are baked straight into the
+    //   layout choose_pixel_font_layout picks for the cell size, which
+    //   replaces the row layout options above. Fails with TABLE_OVER_BUDGET
+    //   before rasterizing anything if neither layout fits.
+    u64 table_budget_bytes = 0;
+    Pixel_Font_Layout_Preference layout_preference = Pixel_Font_Layout_Preference::FASTEST;
+    Pixel_Font_Layout_Choice* layout_choice = nullptr; // the decision, also when over budget
+    Pixel_Font_Bake_Stats* stats = nullptr;
+};
+
+// NOTE: Every allocation of the library goes through the current allocator,
+//   tagged with the stage it is made for. That includes stb_truetype's
+//   allocations, as long as its implementation is compiled together with
+//   PIXEL_FONT_BAKER_IMPL and STBTT_malloc is not defined by the user. Tables
+//   are freed by destroy_pixel_font through the allocator that is current
+//   then, so set it before creating any fonts.
+#define PIXEL_FONT_ALLOCATION_STAGES                                           \
+    STAGE(FONT_FILE) /* contents of ttf and bdf files */                       \
+    STAGE(TABLE)     /* glyph tables, live until destroy_pixel_font */         \
+    STAGE(RASTERIZE) /* gray bitmaps and stb_truetype's glyph outlines */      \
+    STAGE(PIPELINE)  /* queues, stream blocks and threads of a bake */         \
+    STAGE(SCRATCH)   /* temporary memory of the estimators */                  \
+    STAGE(CACHE)     /* rendered strings of a Pixel_Font_String_Cache */        \
+
+enum struct Pixel_Font_Allocation_Stage {
+#define STAGE(key) key,
+    PIXEL_FONT_ALLOCATION_STAGES
+#undef STAGE
+    COUNT
+};
+
+struct Pixel_Font_Allocator {
+    void* (*allocate)(void* user_data, u64 size, Pixel_Font_Allocation_Stage stage);
+    void  (*deallocate)(void* user_data, void* memory, Pixel_Font_Allocation_Stage stage);
+    void* user_data;
+};
+
+// NOTE: nullptr restores the default (malloc and free).
+void pixel_font_set_allocator(const Pixel_Font_Allocator* allocator);
+
+struct Pixel_Font_Allocation_Stats {
+    u64 allocations;
+    u64 allocated_bytes;    // sum of all allocations
+    u64 peak_bytes;         // high-water mark of outstanding_bytes
+    u64 outstanding_blocks; // allocated and not freed (yet)
+    u64 outstanding_bytes;
+};
+
+// NOTE: Allocates with malloc and counts per stage, safe to use while worker
+//   threads bake. Has to be zero initialized. Blocks that are still
+//   outstanding after all fonts were destroyed are leaks.
+struct Pixel_Font_Tracking_Allocator {
+    Pixel_Font_Allocation_Stats stages[(u32)Pixel_Font_Allocation_Stage::COUNT];
+    Pixel_Font_Allocation_Stats total;
+};
+
+Pixel_Font_Allocator pixel_font_tracking_allocator(Pixel_Font_Tracking_Allocator* tracker);
+void pixel_font_log_allocation_stats(const Pixel_Font_Tracking_Allocator* tracker);
+const char* pixel_font_allocation_stage_to_string(Pixel_Font_Allocation_Stage stage);
+
+// NOTE: Of the options only glyph_metrics applies.
 Pixel_Font_Baker_Error create_pixel_font_from_bdf(const char* font_path,
                                                   u32 unicode_cp_start, u32 unicode_cp_end,
-                                                  Pixel_Font* out_font);
+                                                  Pixel_Font* out_font,
+                                                  const Pixel_Font_Bake_Options* options = nullptr);
 
+// NOTE: If the font has an embedded bitmap strike (EBLC/EBDT, or CBLC/CBDT
+//   and bloc/bdat laid out the same way) whose line height (or else ppem) is
+//   char_height_in_px, its glyphs are copied into the table instead of
+//   rasterized, and the cell and the baseline come from the strike. Glyphs
+//   the strike does not have are rasterized at the strike's em size.
 Pixel_Font_Baker_Error create_pixel_font_from_ttf(const char* font_path, u16 char_height_in_px,
                                                   u32 unicode_cp_start, u32 unicode_cp_end,
-                                                  u8 gray_threashold, u8 supersample, Pixel_Font* out_font);
+                                                  u8 gray_threashold, u8 supersample, Pixel_Font* out_font,
+                                                  const Pixel_Font_Bake_Options* options = nullptr);
 
-void destroy_pixel_font(Pixel_Font* out_font);
+// NOTE: Table sizes of the layouts a font could be stored in, predicted from
+//   the font's metadata without baking it:
+//     dense        - a glyph for every codepoint of the range (Pixel_Font::table)
+//     sparse       - only the glyphs the font covers, plus a 12 byte entry
+//                    (first codepoint, count, first glyph) per run of them
+//     deduplicated - a u16 glyph index per codepoint (u32 above 65535 glyphs),
+//                    plus every distinct glyph once
+//     compressed   - an 8 byte record (offset, ink box x, y, w, h) per
+//                    codepoint, plus the ink box of every glyph with its rows
+//                    packed without padding
+//   For ttf the ink boxes come from the glyph bounding boxes and
+//   unique_glyphs is an upper bound.
+struct Pixel_Font_Size_Estimate {
+    u16 char_px_width;
+    u16 char_px_height;
+    u32 bytes_per_glyph;
 
-const char* pixel_font_baker_error_to_string(Pixel_Font_Baker_Error e);
+    u64 glyphs_in_range;
+    u64 glyphs_covered;
+    u64 covered_runs;
+    u64 unique_glyphs;
+    u64 ink_bytes;
 
-#ifdef PIXEL_FONT_BAKER_IMPL
-#include <stdio.h>
-#include "stb_truetype.h"
+    u64 dense_bytes;
+    u64 sparse_bytes;
+    u64 deduplicated_bytes;
+    u64 compressed_bytes;
+};
 
-#ifndef min
-#define min(x, y) ((x) < (y) ? (x) : (y))
-#endif
-#ifndef max
-#define max(x, y) ((x) > (y) ? (x) : (y))
-#endif
+Pixel_Font_Baker_Error estimate_pixel_font_size_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                         u32 unicode_cp_start, u32 unicode_cp_end,
+                                                         u8 supersample, Pixel_Font_Size_Estimate* out_estimate);
 
-Pixel_Font_Baker_Error create_pixel_font_from_bdf(const char* font_path,
-                                                  u32 unicode_cp_start, u32 unicode_cp_end,
-                                                  Pixel_Font* out_font)
-{
-    File_Read file_content_read = read_entire_file(font_path);
-    if (!file_content_read.success) {
-        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
-    }
+Pixel_Font_Baker_Error estimate_pixel_font_size_from_bdf(const char* font_path,
+                                                         u32 unicode_cp_start, u32 unicode_cp_end,
+                                                         Pixel_Font_Size_Estimate* out_estimate);
 
-    Allocated_String file_content = file_content_read.contents;
-    defer { file_content.free(); };
+// NOTE: The exact sizes of the layouts for the glyphs of a baked font. Glyphs
+//   without ink count as not covered (a sparse table leaves them out, they
+//   draw nothing either way) and unique_glyphs is exact.
+Pixel_Font_Baker_Error measure_pixel_font_layouts(const Pixel_Font* font, Pixel_Font_Size_Estimate* out_measured);
 
-    Allocated_String cursor = file_content;
+struct Pixel_Font_Layout_Choice {
+    u64  layout_bytes[(u32)Pixel_Font_Table_Layout::COUNT]; // 0 if the layout is not possible
+    bool fits[(u32)Pixel_Font_Table_Layout::COUNT];
+    Pixel_Font_Table_Layout chosen;                         // COUNT if neither fits
+};
 
-    auto advance_cursor = [&](s32 amount = 1) -> void {
-        cursor.data   += amount;
-        cursor.length -= amount;
-    };
+// NOTE: Picks between WORD_ROWS and PACKED under budget_bytes. Only the cell
+//   size and the codepoint range of the font are read, the table may be
+//   nullptr. Returns TABLE_OVER_BUDGET if neither fits.
+Pixel_Font_Baker_Error choose_pixel_font_layout(const Pixel_Font* font, u64 budget_bytes,
+                                                Pixel_Font_Layout_Preference preference,
+                                                Pixel_Font_Layout_Choice* out_choice);
 
-    auto is_on_newline = [&]() -> bool {
-        return (*cursor.data == '\r'
-                || *cursor.data == '\n');
-    };
+const char* pixel_font_table_layout_to_string(Pixel_Font_Table_Layout layout);
 
-    auto is_on_whitespace = [&]() -> bool {
-        return (*cursor.data == ' '
-                || *cursor.data == '\t'
-                || is_on_newline());
-    };
+// NOTE: Same as create_pixel_font_from_ttf, but streams the table into a
+//   baked font file at out_path as the glyphs complete, instead of keeping
+//   the whole table in memory. The file is written next to out_path (with
+//   .part appended) and renamed over it on success, on failure out_path is
+//   left as it was.
+Pixel_Font_Baker_Error bake_pixel_font_file_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                     u32 unicode_cp_start, u32 unicode_cp_end,
+                                                     u8 gray_threashold, u8 supersample, const char* out_path,
+                                                     const Pixel_Font_Bake_Options* options = nullptr);
 
-    auto eat_whitespace = [&]() -> void {
-        while (is_on_whitespace())
-            advance_cursor();
-    };
+// NOTE: This and the other writers (bundles, C source, GFX headers) write
+//   next to out_path as well and rename over it only once the file is
+//   complete, so a failed write leaves out_path as it was.
+Pixel_Font_Baker_Error save_pixel_font(const Pixel_Font* font, const char* out_path);
+Pixel_Font_Baker_Error load_pixel_font(const char* font_path, Pixel_Font* out_font,
+                                       Pixel_Font_Table_Pages table_pages = Pixel_Font_Table_Pages::DEFAULT);
 
-    auto eat_until_next_line = [&]() -> void {
-        // find newline
-        while (!is_on_newline() && cursor.length > 0)
-            advance_cursor();
-        // then eat all the whitespace
-        eat_whitespace();
-    };
+// NOTE: The pages the font's table ended up in: DEFAULT, HUGE_TLB or
+//   TRANSPARENT_HUGE (which the kernel may still have backed with 4 KiB
+//   pages). DEFAULT for borrowed tables.
+Pixel_Font_Table_Pages pixel_font_table_pages(const Pixel_Font* font);
 
-    auto eat_until_line_that_starts_with_and_skip = [&](const char* to_search, u32 to_search_length)
-        -> void
-    {
-        eat_whitespace();
-        while (strncmp(cursor.data, to_search, to_search_length) != 0 && cursor.length > 0) {
-            eat_until_next_line();
-        }
+// NOTE: Layout of a font bundle (many baked fonts in one file): this header,
+//   the directory (entry_count entries of entry_size bytes, sorted by name,
+//   size and style) at header_size, the block checksums at checksums_offset,
+//   then the tables. Every table starts at a multiple of
+//   PIXEL_FONT_BUNDLE_ALIGNMENT, so a mapped bundle only pages in the
+//   directory and the tables that are actually drawn from. Glyph metrics
+//   follow their table like in a baked font file.
+//
+//   All checksums are CRC32C. metadata_crc covers the header (with
+//   metadata_crc itself as 0), the directory and the block checksums. The
+//   tables, from data_offset to the end of the file, are split into blocks of
+//   block_size bytes with one checksum each.
+#define PIXEL_FONT_BUNDLE_MAGIC       "PXFB"
+#define PIXEL_FONT_BUNDLE_VERSION     2
+#define PIXEL_FONT_BUNDLE_ALIGNMENT   4096
+#define PIXEL_FONT_BUNDLE_BLOCK_SIZE  (16 * 1024)
+#define PIXEL_FONT_BUNDLE_NAME_LENGTH 32
 
-        advance_cursor((s32)min(cursor.length, to_search_length)); // min prevents running out of the string
-    };
+struct Pixel_Font_Bundle_Header {
+    char magic[4];
+    u16  version;
+    u16  header_size;
+    u32  entry_count;
+    u32  entry_size;
+    u64  file_size;
+    u32  block_size;
+    u32  block_count;
+    u64  data_offset;
+    u64  checksums_offset;
+    u32  metadata_crc;
+    u32  reserved;
+};
 
+struct Pixel_Font_Bundle_Entry {
+    char name[PIXEL_FONT_BUNDLE_NAME_LENGTH]; // zero padded
+    u16  size;                                // nominal pixel height
+    u16  style;                               // user defined (regular, bold, ...)
+    u16  char_px_width;
+    u16  char_px_height;
+    u32  bytes_per_line;
+    u32  bytes_per_glyph;
+    u32  unicode_cp_start;
+    u32  unicode_cp_end;
+    u16  flags;                               // as in Pixel_Font_Header
+    s16  cell_x;
+    s16  baseline;
+    s16  line_height;
+    u64  table_offset;
+    u64  table_size;
+};
 
-    s32 font_size_x, font_size_y, start_x, start_y;
-    // NOTE(Felix): Find the font dimensions (FONTBOUNDINGBOX)
-    {
-        const char to_search[] = "FONTBOUNDINGBOX ";
-        u32 to_search_length   = sizeof(to_search) - 1; // sizeof includes null terminator
-        eat_until_line_that_starts_with_and_skip(to_search, to_search_length);
+struct Pixel_Font_Bundle_Font {
+    const char* name; // at most PIXEL_FONT_BUNDLE_NAME_LENGTH-1 characters
+    u16 size;
+    u16 style;
+    const Pixel_Font* font;
+};
 
-        if (cursor.length == 0)
-            return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX;
+Pixel_Font_Baker_Error write_pixel_font_bundle(const Pixel_Font_Bundle_Font* fonts, u32 font_count,
+                                               const char* out_path);
 
-        // we are on the FONTBOUNDINGBOX line.
-        {
-            s32 filled_vars =
-                sscanf(cursor.data, "%d %d %d %d",
-                   &font_size_x, &font_size_y, &start_x, &start_y);
+// NOTE: How much of a bundle is checked against its checksums.
+enum struct Pixel_Font_Bundle_Verify {
+    NONE,  // only the structure of the header and the directory
+    LAZY,  // the metadata at open, a block when verify_pixel_font_bundle_glyphs first touches it
+    FULL,  // everything at open, which reads the whole file
+};
 
-            if (filled_vars != 4) {
-                return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX_CORRECTLY;
-            }
-        }
-    }
+// NOTE: An opened bundle. The file is mapped read only where mmap is
+//   available and read into memory otherwise.
+struct Pixel_Font_Bundle {
+    const u8* data;
+    u64       size;
+    bool      mapped;
+    const Pixel_Font_Bundle_Header* header;
+    const Pixel_Font_Bundle_Entry*  entries;
+    const u32* block_checksums;
+    void*      block_states; // per block: not checked yet, good or corrupt (LAZY only)
+};
 
-    // NOTE(Felix): allocate the needed memory
-    {
-        out_font->char_px_width   = font_size_x;
-        out_font->char_px_height  = font_size_y;
-        out_font->bytes_per_line  = (font_size_x / 8) + (font_size_x % 8 != 0);
-        out_font->bytes_per_glyph = font_size_y * out_font->bytes_per_line;
+// NOTE: Checks the header and the directory, and depending on verify the
+//   checksums, see Pixel_Font_Bundle_Verify.
+Pixel_Font_Baker_Error open_pixel_font_bundle(const char* bundle_path, Pixel_Font_Bundle* out_bundle,
+                                              Pixel_Font_Bundle_Verify verify = Pixel_Font_Bundle_Verify::LAZY);
 
-        u32 total_byte_size =
-            out_font->bytes_per_glyph * (unicode_cp_end - unicode_cp_start + 1); // both inclusive so +1
+// NOTE: Binary search in the directory. out_font's table points into the
+//   bundle, it stays valid until the bundle is closed and is not freed by
+//   destroy_pixel_font.
+Pixel_Font_Baker_Error find_pixel_font_in_bundle(const Pixel_Font_Bundle* bundle, const char* name,
+                                                 u16 size, u16 style, Pixel_Font* out_font);
 
-        out_font->table = (u8*)malloc(total_byte_size);
-        if (!out_font->table)
-            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+// NOTE: Checks the blocks holding the glyphs [cp_first, cp_last] of a font
+//   found in the bundle, each block only the first time. Cheap once a block
+//   has been checked, so renderers can call it before every draw. Always
+//   succeeds for bundles opened with NONE or FULL. Safe to call from several
+//   threads.
+Pixel_Font_Baker_Error verify_pixel_font_bundle_glyphs(const Pixel_Font_Bundle* bundle, const Pixel_Font* font,
+                                                       u32 cp_first, u32 cp_last);
 
-        // NOTE(Felix): Initialize with checker board (if bytes_per_line is 1 or
-        //   2, otherwise its just stripes)
-        if (out_font->bytes_per_line == 1)
-            memset(out_font->table, 0b0101'0101'1010'1010, total_byte_size);
-        else if (out_font->bytes_per_line == 2)
-            memset(out_font->table, 0b0101'1010'0101'1010, total_byte_size);
-        else
-            memset(out_font->table, 0b0101'0101'0101'0101, total_byte_size);
+void close_pixel_font_bundle(Pixel_Font_Bundle* bundle);
 
-    }
+// NOTE: Writes the font as a C source file in the style of Waveshare's
+//   fontXX.c files (<name>_Table and an sFONT called <name>).
+Pixel_Font_Baker_Error write_pixel_font_as_c_source(const Pixel_Font* font, const char* name,
+                                                    const char* out_path);
 
-    // NOTE(Felix): read all relevant bitmaps until end of file
-    while (cursor.length > 0) {
-        { // NOTE(Felix): Jump to the codepoint
-            const char to_search[] = "ENCODING ";
-            u32 to_search_length   = sizeof(to_search) - 1; // sizeof includes null terminator
-            eat_until_line_that_starts_with_and_skip(to_search, to_search_length);
+// NOTE: What a baked font does not keep, but a proportional font needs: where
+//   the baseline and the pen sit in the cell, the line height and the advance
+//   of every glyph of the font's range, all in pixels.
+struct Pixel_Font_Gfx_Metrics {
+    s32 baseline;   // rows from the top of the cell
+    s32 x_origin;   // cell column 0 relative to the pen position
+    s32 y_advance;  // line height
+    u8* x_advances; // unicode_cp_end - unicode_cp_start + 1 entries
+};
 
-            if (cursor.length <= 0)
-                break;
-        }
+// NOTE: char_height_in_px has to be the one the font was baked with. Fonts
+//   with an embedded bitmap strike of that height get the strike's metrics,
+//   as baked with embedded_bitmaps on.
+Pixel_Font_Baker_Error pixel_font_gfx_metrics_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                       const Pixel_Font* font, Pixel_Font_Gfx_Metrics* out_metrics);
+Pixel_Font_Baker_Error pixel_font_gfx_metrics_from_bdf(const char* font_path, const Pixel_Font* font,
+                                                       Pixel_Font_Gfx_Metrics* out_metrics);
+void destroy_pixel_font_gfx_metrics(Pixel_Font_Gfx_Metrics* metrics);
 
-        s32 code_point = 0;
-        s32 filled_vars =
-            sscanf(cursor.data, "%d", &code_point);
+// NOTE: Writes the font as an Adafruit GFX GFXfont header: every glyph is cut
+//   to the tight box around its set pixels and its rows are packed without
+//   padding. Without metrics the font's own glyph metrics are used if it was
+//   baked with them, otherwise it stays monospaced, with the baseline at the
+//   bottom of the cell. GFX limits the bitmap to 64 KiB, boxes and
+//   advances to 255 pixels and codepoints to 0xFFFF.
+Pixel_Font_Baker_Error write_pixel_font_as_adafruit_gfx(const Pixel_Font* font, const Pixel_Font_Gfx_Metrics* metrics,
+                                                        const char* name, const char* out_path);
 
-        if (filled_vars != 1) {
-            return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_CODEPOINT_CORRECTLY;
-        }
+// NOTE: A 1-bpp framebuffer with the same bit order as the glyph rows (most
+//   significant bit is the leftmost pixel). Drawing only ever sets bits, so
+//   text is OR-ed onto whatever is already in the framebuffer.
+struct Pixel_Font_Framebuffer {
+    u8* data;
+    u32 width;
+    u32 height;
+    u32 stride; // bytes per row
+};
 
-        if (code_point < (s32)unicode_cp_start || code_point > (s32)unicode_cp_end)
-            continue;
+// NOTE: Decodes the codepoint at *cursor and advances it. Malformed sequences
+//   decode to U+FFFD and consume one byte.
+u32 pixel_font_decode_utf8(const char** cursor);
 
-        byte* table_entry =
-            out_font->table + (out_font->bytes_per_glyph *
-                               (code_point - unicode_cp_start));
+// NOTE: (x, y) is the top left corner of the glyph cell and may lie outside of
+//   the framebuffer, glyphs are clipped. Codepoints outside of the font's range
+//   are not drawn.
+void pixel_font_draw_glyph(Pixel_Font_Framebuffer* fb, const Pixel_Font* font, u32 code_point, s32 x, s32 y);
 
-        { // NOTE(Felix): Jump to the numbers
-            const char to_search[] = "BITMAP";
-            u32 to_search_length   = sizeof(to_search) - 1; // sizeof includes null terminator
-            eat_until_line_that_starts_with_and_skip(to_search, to_search_length);
-            eat_whitespace();
-        }
+// NOTE: Draws a UTF-8 string, advancing by char_px_width per codepoint. '\n'
+//   starts a new line char_px_height below. Returns the number of glyphs
+//   that were in the font's range (including clipped ones).
+u32 pixel_font_draw_string(Pixel_Font_Framebuffer* fb, const Pixel_Font* font, const char* utf8, s32 x, s32 y);
 
-        // NOTE(Felix): Safety check that we won't run out of the string when
-        //   reading all the bytes
-        {
-            u64 needed_bytes =
-                out_font->char_px_height*(2*(out_font->bytes_per_line)+1);
-            // +1 for newline,
-            // *2 for 2 chars for 1 byte in hex
-            if (needed_bytes >= cursor.length)
-                return Pixel_Font_Baker_Error::BDF_ERROR_PARSING_CHARACTER_BYTES;
-        }
+// NOTE: Strings collected to be drawn in one pass. pixel_font_draw_list_render
+//   drops the runs that lie entirely outside the framebuffer, sorts the rest
+//   by the band of rows they start in and then from left to right, and draws
+//   them, skipping the lines and line ends that are off screen. As drawing
+//   only sets bits, the framebuffer ends up the same as with one
+//   pixel_font_draw_string per run. Strings are not copied, they have to
+//   stay valid until the list is rendered. A zero initialized list is empty.
+struct Pixel_Font_Draw_Run {
+    const Pixel_Font* font;
+    const char* utf8;
+    s32 x;
+    s32 y;
+    s32 right;    // bounding box, exclusive, wider than the text for non-ASCII
+    s32 bottom;
+    u64 sort_key;
+};
 
-        // NOTE(Felix): We now have to read <out_font->char_px_height> many
-        //   lines, made of <out_font->bytes_per_line> bytes each. Each byte is
-        //   represented by 2 hex-digits
-        {
-            for (u32 row = 0; row < out_font->char_px_height; ++row) {
-                for (u32 col = 0; col < out_font->bytes_per_line; ++col) {
-                    u32 value;
-                    s32 filled = sscanf(cursor.data, "%2x", &value);
-                    if (filled != 1) {
-                        return Pixel_Font_Baker_Error::BDF_ERROR_PARSING_CHARACTER_BYTES;
-                    }
-                    *table_entry = (u8)value;
-                    ++table_entry;
-                    advance_cursor(2);
-                }
-                eat_whitespace();
-            }
-        }
-    }
+struct Pixel_Font_Draw_List {
+    Pixel_Font_Draw_Run* runs;
+    u32 run_count;
+    u32 run_capacity;
+    u32 culled_runs; // dropped by the last render
+};
 
-    return Pixel_Font_Baker_Error::SUCCESS;
+Pixel_Font_Baker_Error pixel_font_draw_list_add(Pixel_Font_Draw_List* list, const Pixel_Font* font,
+                                                const char* utf8, s32 x, s32 y);
+
+// NOTE: Returns the number of glyphs that were at least partly inside the
+//   framebuffer. The runs stay in the list, sorted in drawing order, so it
+//   can be rendered again.
+u32 pixel_font_draw_list_render(Pixel_Font_Framebuffer* fb, Pixel_Font_Draw_List* list);
+
+// NOTE: Empties the list but keeps its memory for the next frame.
+void pixel_font_draw_list_clear(Pixel_Font_Draw_List* list);
+void destroy_pixel_font_draw_list(Pixel_Font_Draw_List* list);
+
+// NOTE: An LRU cache of rendered strings. pixel_font_draw_string_cached
+//   renders a string it has not seen into a bitmap of its own once and from
+//   then on ORs that bitmap into the framebuffer row by row, with the same
+//   result as pixel_font_draw_string. Strings are keyed by their UTF-8 text
+//   and the font's address and table (drawing has no other options), so a
+//   font that is destroyed or rebaked in place needs
+//   pixel_font_string_cache_clear. The least recently drawn strings are
+//   evicted to stay within budget_bytes (bitmaps, copies of the texts and
+//   the entries' headers, not the hash chains), strings that alone exceed it
+//   are drawn directly.
+struct Pixel_Font_String_Cache_Stats {
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    u64 uncached;  // misses that were too big for the budget or found no memory
+    u64 bytes;     // currently in use
+    u32 entries;
+};
+
+struct Pixel_Font_String_Cache {
+    u64   budget_bytes;
+    void* buckets;      // hash chains
+    u32   bucket_count;
+    void* newest;       // LRU list
+    void* oldest;
+    Pixel_Font_String_Cache_Stats stats;
+};
+
+Pixel_Font_Baker_Error create_pixel_font_string_cache(u64 budget_bytes, Pixel_Font_String_Cache* out_cache);
+
+// NOTE: Same arguments and return value as pixel_font_draw_string.
+u32 pixel_font_draw_string_cached(Pixel_Font_String_Cache* cache, Pixel_Font_Framebuffer* fb,
+                                  const Pixel_Font* font, const char* utf8, s32 x, s32 y);
+
+// NOTE: Drops all strings, the stats other than bytes and entries are kept.
+void pixel_font_string_cache_clear(Pixel_Font_String_Cache* cache);
+void destroy_pixel_font_string_cache(Pixel_Font_String_Cache* cache);
+
+// NOTE: Convert a framebuffer into the native layout of multi color panels:
+//   2-bpp (4 gray panels, four pixels a byte) or 4-bpp (7 color ACeP panels,
+//   two pixels a byte), first pixel in the top bits like the framebuffer.
+//   Set pixels become the foreground color index and clear ones the
+//   background (0-3 or 0-15, higher bits are ignored). Each out row is
+//   out_stride bytes after the previous one and takes (width + 3) / 4 or
+//   (width + 1) / 2 bytes, pixels past width in its last byte are
+//   background.
+void pixel_font_framebuffer_to_2bpp(const Pixel_Font_Framebuffer* fb, u8 foreground, u8 background,
+                                    u8* out_data, u32 out_stride);
+void pixel_font_framebuffer_to_4bpp(const Pixel_Font_Framebuffer* fb, u8 foreground, u8 background,
+                                    u8* out_data, u32 out_stride);
+
+// NOTE: Copies a font into the word row layout: with row_word_bytes (1, 2, 4
+//   or 8) every glyph row takes one naturally aligned word of that size
+//   instead of (char_px_width+7)/8 bytes, and with glyph_alignment (16 or 64)
+//   bytes_per_glyph is padded to a multiple of it. Tables are always 64 byte
+//   aligned. pixel_font_draw_glyph blits such rows with a single load each.
+//   0 for both gives the packed layout.
+Pixel_Font_Baker_Error create_pixel_font_with_row_layout(const Pixel_Font* font, u32 row_word_bytes,
+                                                         u32 glyph_alignment, Pixel_Font* out_font);
+
+void destroy_pixel_font(Pixel_Font* out_font);
+
+const char* pixel_font_baker_error_to_string(Pixel_Font_Baker_Error e);
+
+#ifdef PIXEL_FONT_BAKER_IMPL
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <mutex>
+#include <new>
+#include <thread>
+#if defined(__SSE2__) && !defined(PIXEL_FONT_BAKER_NO_SIMD)
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(PIXEL_FONT_BAKER_NO_SIMD)
+#include <nmmintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PIXEL_FONT_BAKER_MMAP 1
+#else
+#define PIXEL_FONT_BAKER_MMAP 0
+#endif
+
+static void* pfb__malloc(void*, u64 size, Pixel_Font_Allocation_Stage) {
+    return malloc(size);
 }
 
-Pixel_Font_Baker_Error create_pixel_font_from_ttf(const char* font_path, u16 char_height_in_px,
-                                                  u32 unicode_cp_start, u32 unicode_cp_end,
-                                                  u8 gray_threashold, u8 supersample, Pixel_Font* out_font)
-{
-    stbtt_fontinfo font;
-    {
-        //
-        //  Reading font file
-        //
-        u8* ttf_buffer = (u8*)malloc(1<<25);
-        if (!ttf_buffer) return Pixel_Font_Baker_Error::MALLOC_FAILED;
+static void pfb__free(void*, void* memory, Pixel_Font_Allocation_Stage) {
+    free(memory);
+}
 
-        FILE* font_file = fopen(font_path, "rb");
-        if (!font_file) return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+static Pixel_Font_Allocator pfb__allocator = { pfb__malloc, pfb__free, nullptr };
+
+static void* pfb__allocate(u64 size, Pixel_Font_Allocation_Stage stage) {
+    return pfb__allocator.allocate(pfb__allocator.user_data, size, stage);
+}
 
-        fread(ttf_buffer, 1, 1<<25, font_file);
-        fclose(font_file);
+static void pfb__deallocate(void* memory, Pixel_Font_Allocation_Stage stage) {
+    if (memory)
+        pfb__allocator.deallocate(pfb__allocator.user_data, memory, stage);
+}
 
-        s32 success =
-            stbtt_InitFont(&font, ttf_buffer, stbtt_GetFontOffsetForIndex(ttf_buffer,0));
+// NOTE: Glyph tables are aligned beyond what the allocator guarantees. This
+//   header is stored right in front of the table, so freeing does not need
+//   to know the alignment or where the table came from.
+#define PFB__TABLE_ALIGNMENT 64
+#define PFB__HUGE_PAGE_SIZE  (2ull << 20)
 
-        if (success == 0) return Pixel_Font_Baker_Error::STB_TRUETYPE_FAILED;
-    }
+struct pfb__Table_Header {
+    u64 offset;      // from the start of the allocation or mapping
+    u64 mapped_size; // 0 if allocated through the allocator
+    u32 pages;       // Pixel_Font_Table_Pages
+    u32 reserved;
+};
 
-    // internally calculate with higher resolution
-    char_height_in_px *= supersample;
+#if PIXEL_FONT_BAKER_MMAP && defined(__linux__)
+// NOTE: An anonymous mapping of at least size bytes in the given pages,
+//   nullptr if the system refuses.
+static u8* pfb__map_table_pages(u64 size, Pixel_Font_Table_Pages pages, u64* out_mapped_size) {
+    u64 mapped_size = (size + PFB__HUGE_PAGE_SIZE - 1) & ~(PFB__HUGE_PAGE_SIZE - 1);
 
-    //
-    //  Preparing one-char-bitmap
-    //
+    if (pages == Pixel_Font_Table_Pages::HUGE_TLB) {
+#ifdef MAP_HUGETLB
+        // NOTE: huge tlb mappings are aligned to the huge page size already
+        void* map = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED) {
+            *out_mapped_size = mapped_size;
+            return (u8*)map;
+        }
+#endif
+        return nullptr;
+    }
 
-    s32 unicode_cp_size  = unicode_cp_end - unicode_cp_start + 1;
+#ifdef MADV_HUGEPAGE
+    // NOTE: Only 2 MiB aligned ranges can be backed by transparent huge
+    //   pages, so a huge page more is mapped and the ends are cut off.
+    u64 padded_size = mapped_size + PFB__HUGE_PAGE_SIZE;
+    u8* map = (u8*)mmap(nullptr, padded_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == (u8*)MAP_FAILED)
+        return nullptr;
 
-    s32 char_width_in_px;
-    f32 font_scale  = stbtt_ScaleForPixelHeight(&font, char_height_in_px);
-    stbtt_GetCodepointHMetrics(&font, 'W', &char_width_in_px, nullptr);
-    char_width_in_px = (s32)ceil(char_width_in_px*font_scale);
+    u8* aligned = (u8*)(((uintptr_t)map + PFB__HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(PFB__HUGE_PAGE_SIZE - 1));
+    if (aligned > map)
+        munmap(map, (size_t)(aligned - map));
+    if (map + padded_size > aligned + mapped_size)
+        munmap(aligned + mapped_size, (size_t)(map + padded_size - (aligned + mapped_size)));
 
-    // get number of bytes per pixel line per char
-    s32 bytes_per_line =
-        ((char_width_in_px/supersample) % 8 == 0) ?
-        ((char_width_in_px/supersample) / 8)      :
-        (((char_width_in_px/supersample) / 8) + 1);
+    if (madvise(aligned, mapped_size, MADV_HUGEPAGE) != 0)
+        log_debug("madvise(MADV_HUGEPAGE) failed, the table stays in 4 KiB pages");
 
+    *out_mapped_size = mapped_size;
+    return aligned;
+#else
+    return nullptr;
+#endif
+}
+#endif
 
-    uint8_t* bitmap_memory = (uint8_t*)malloc(char_height_in_px*char_width_in_px);
-    if (!bitmap_memory)
-        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+static u8* pfb__allocate_table(u64 size, Pixel_Font_Table_Pages pages = Pixel_Font_Table_Pages::DEFAULT) {
+    const u64 header_room = (sizeof(pfb__Table_Header) + PFB__TABLE_ALIGNMENT - 1) & ~(u64)(PFB__TABLE_ALIGNMENT - 1);
 
-    //
-    //  Preparing pixel-font-array
-    //
+#if PIXEL_FONT_BAKER_MMAP && defined(__linux__)
+    Pixel_Font_Table_Pages tries[2] = { pages, Pixel_Font_Table_Pages::DEFAULT };
+    if (pages == Pixel_Font_Table_Pages::HUGE) {
+        tries[0] = Pixel_Font_Table_Pages::HUGE_TLB;
+        tries[1] = Pixel_Font_Table_Pages::TRANSPARENT_HUGE;
+    }
 
-    s32 ascend;
-    s32 descend;
-    s32 line_gap;
-    stbtt_GetFontVMetrics(&font, &ascend, &descend, &line_gap);
-    ascend = (int)(ascend*font_scale +.5f);
-    descend = char_height_in_px - ascend;
+    for (Pixel_Font_Table_Pages try_pages : tries) {
+        if (try_pages == Pixel_Font_Table_Pages::DEFAULT)
+            break;
 
-    s32 total_byte_size = unicode_cp_size * (char_height_in_px/supersample) * bytes_per_line;
-    u8* font_data = (u8*)malloc(total_byte_size);
-    if (!font_data)
-        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+        u64 mapped_size;
+        u8* map = pfb__map_table_pages(header_room + size, try_pages, &mapped_size);
+        if (!map)
+            continue;
 
-    memset((void*)font_data, 0, total_byte_size);
+        // NOTE: The header takes the first cache line, so the table starts
+        //   64 bytes into the first huge page.
+        u8* table = map + header_room;
+        pfb__Table_Header* header = (pfb__Table_Header*)table - 1;
+        header->offset      = header_room;
+        header->mapped_size = mapped_size;
+        header->pages       = (u32)try_pages;
+        header->reserved    = 0;
+        return table;
+    }
 
-    //
-    //  Fill the pixel-font
-    //
+    if (pages != Pixel_Font_Table_Pages::DEFAULT)
+        log_debug("no huge pages for a %llu byte table, using the allocator", (unsigned long long)size);
+#else
+    (void)pages;
+#endif
 
-    out_font->char_px_width   = char_width_in_px  / supersample;
-    out_font->char_px_height  = char_height_in_px / supersample;
-    out_font->table           = font_data;
-    out_font->bytes_per_line  = bytes_per_line;
-    out_font->bytes_per_glyph = bytes_per_line * (char_height_in_px / supersample);
+    u8* memory = (u8*)pfb__allocate(size + header_room + PFB__TABLE_ALIGNMENT - 1, Pixel_Font_Allocation_Stage::TABLE);
+    if (!memory)
+        return nullptr;
+    u8* table = (u8*)(((uintptr_t)memory + header_room + PFB__TABLE_ALIGNMENT - 1) & ~(uintptr_t)(PFB__TABLE_ALIGNMENT - 1));
+    pfb__Table_Header* header = (pfb__Table_Header*)table - 1;
+    header->offset      = (u64)(table - memory);
+    header->mapped_size = 0;
+    header->pages       = (u32)Pixel_Font_Table_Pages::DEFAULT;
+    header->reserved    = 0;
+    return table;
+}
 
-    log_debug("width:           %i", out_font->char_px_width);
-    log_debug("height:          %i", out_font->char_px_height);
-    log_debug("bytes per line:  %i", out_font->bytes_per_line);
-    log_debug("bytes per glyph: %i", out_font->bytes_per_glyph);
+static void pfb__deallocate_table(u8* table) {
+    if (!table)
+        return;
+    pfb__Table_Header* header = (pfb__Table_Header*)table - 1;
+#if PIXEL_FONT_BAKER_MMAP && defined(__linux__)
+    if (header->mapped_size) {
+        munmap(table - header->offset, (size_t)header->mapped_size);
+        return;
+    }
+#endif
+    pfb__deallocate(table - header->offset, Pixel_Font_Allocation_Stage::TABLE);
+}
 
-    for (u32 cp = unicode_cp_start; cp <= unicode_cp_end; ++cp) {
+#ifndef STBTT_malloc
+#define STBTT_malloc(x,u) ((void)(u), pfb__allocate((x), Pixel_Font_Allocation_Stage::RASTERIZE))
+#define STBTT_free(x,u)   ((void)(u), pfb__deallocate((x), Pixel_Font_Allocation_Stage::RASTERIZE))
+#endif
+#include "stb_truetype.h"
 
-        s32 bmp_width_in_px;
-        s32 bmp_height_in_px;
-        s32 x_offset;
-        s32 y_offset;
+#ifndef min
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#endif
+#ifndef max
+#define max(x, y) ((x) > (y) ? (x) : (y))
+#endif
 
-        stbtt_GetCodepointBitmap(&font, 0, font_scale, cp,
-                                 &bmp_width_in_px, &bmp_height_in_px,
-                                 &x_offset, &y_offset);
+void pixel_font_set_allocator(const Pixel_Font_Allocator* allocator) {
+    if (allocator)
+        pfb__allocator = *allocator;
+    else
+        pfb__allocator = { pfb__malloc, pfb__free, nullptr };
+}
 
+// NOTE: Every tracked block starts with this header, 16 bytes so the memory
+//   handed out keeps malloc's alignment.
+struct pfb__Tracking_Header {
+    u64 size;
+    u64 stage;
+};
 
-        {
-            memset(bitmap_memory, 0, char_width_in_px*char_height_in_px);
-            bmp_width_in_px  = char_width_in_px;
-            bmp_height_in_px = char_height_in_px;
-
-            f32 sub_x, sub_y;
-            stbtt_MakeCodepointBitmapSubpixelPrefilter(&font, bitmap_memory,
-                                                       char_width_in_px, char_height_in_px,
-                                                       char_width_in_px, // NOTE(Felix): stride
-                                                       font_scale, font_scale, // font scales x and y
-                                                       0, 0, // subpixel shift x and y
-                                                       supersample, supersample, // oversample x and y
-                                                       &sub_x, &sub_y,
-                                                       cp);
-
-        }
-
-        s32 y_start = ascend+y_offset;
-        s32 y_end   = ascend+y_offset+bmp_height_in_px;
-        s32 x_start = x_offset;
-        s32 x_end   = x_offset+bmp_width_in_px;
-
-        s32 bytes_per_line = (out_font->char_px_width / 8 + (out_font->char_px_width % 8 ? 1 : 0));
-
-        u8 *bit_ptr = &font_data[(cp - unicode_cp_start) * out_font->char_px_height * bytes_per_line];
-        bit_ptr += y_start * bytes_per_line;
-        bit_ptr += x_start / 8;
-
-        s32 shift = 7-(x_start % 8);
-
-        s32 y;
-        for (y = max(0, y_start); y < min(y_end, char_height_in_px/supersample); ++y) {
-            s32 x;
-            for (x = max(0, x_start); x < min(x_end, char_width_in_px/supersample); ++x) {
-                // uint8_t pixel = bitmap[bmp_width_in_px*(y-y_start)+(x-x_start)];
-
-#define ACCESS(_x, _y, _sx, _sy) bitmap_memory[(bmp_width_in_px*(supersample*(_y-y_start)+_sy)+supersample*(_x-x_start))+_sx];
-
-                u32 avg = 0;
-                // u32 hack_supersample = supersample;
-                u32 hack_supersample = 1;
-                for (u32 sub_y = 0; sub_y < hack_supersample; ++sub_y) {
-                    for (u32 sub_x = 0; sub_x < hack_supersample; ++sub_x) {
-                        avg += ACCESS(x, y, sub_x, sub_y);
-                    }
-                }
+static std::mutex pfb__tracking_mutex;
 
-                u8 pixel = avg / (hack_supersample*hack_supersample);
-                u8 bit = pixel >= gray_threashold;
+static void* pfb__tracking_allocate(void* user_data, u64 size, Pixel_Font_Allocation_Stage stage) {
+    pfb__Tracking_Header* header = (pfb__Tracking_Header*)malloc(sizeof(pfb__Tracking_Header) + size);
+    if (!header)
+        return nullptr;
+    header->size  = size;
+    header->stage = (u64)stage;
 
-                *bit_ptr |= (bit << shift);
+    Pixel_Font_Tracking_Allocator* tracker = (Pixel_Font_Tracking_Allocator*)user_data;
+    std::lock_guard<std::mutex> lock(pfb__tracking_mutex);
+    for (Pixel_Font_Allocation_Stats* s : { &tracker->stages[(u32)stage], &tracker->total }) {
+        ++s->allocations;
+        ++s->outstanding_blocks;
+        s->allocated_bytes   += size;
+        s->outstanding_bytes += size;
+        s->peak_bytes         = max(s->peak_bytes, s->outstanding_bytes);
+    }
 
-                --shift;
-                if (shift == -1) {
-                    shift = 7;
-                    ++bit_ptr;
-                }
-            }
+    return header + 1;
+}
 
-            bit_ptr += (s32)((bytes_per_line*8-x-1) / 8) + 1;
-            bit_ptr += (s32)(x_start/8.0);
+static void pfb__tracking_deallocate(void* user_data, void* memory, Pixel_Font_Allocation_Stage) {
+    // NOTE: The stage from the header is used, so a block is always
+    //   subtracted from the stage it was counted in.
+    pfb__Tracking_Header* header = (pfb__Tracking_Header*)memory - 1;
 
-            shift = 7-(x_start % 8);
+    Pixel_Font_Tracking_Allocator* tracker = (Pixel_Font_Tracking_Allocator*)user_data;
+    {
+        std::lock_guard<std::mutex> lock(pfb__tracking_mutex);
+        for (Pixel_Font_Allocation_Stats* s : { &tracker->stages[header->stage], &tracker->total }) {
+            --s->outstanding_blocks;
+            s->outstanding_bytes -= header->size;
         }
     }
 
+    free(header);
+}
 
-    return Pixel_Font_Baker_Error::SUCCESS;
+Pixel_Font_Allocator pixel_font_tracking_allocator(Pixel_Font_Tracking_Allocator* tracker) {
+    return { pfb__tracking_allocate, pfb__tracking_deallocate, tracker };
 }
 
-void destroy_pixel_font(Pixel_Font* font) {
-    free(font->table);
+void pixel_font_log_allocation_stats(const Pixel_Font_Tracking_Allocator* tracker) {
+    auto log_stats = [](const char* name, const Pixel_Font_Allocation_Stats* s) {
+        log_info("%-10s %8llu allocations %12llu bytes, peak %12llu bytes, outstanding %llu blocks %llu bytes",
+                 name, (unsigned long long)s->allocations, (unsigned long long)s->allocated_bytes,
+                 (unsigned long long)s->peak_bytes, (unsigned long long)s->outstanding_blocks,
+                 (unsigned long long)s->outstanding_bytes);
+    };
+
+    for (u32 i = 0; i < (u32)Pixel_Font_Allocation_Stage::COUNT; ++i)
+        log_stats(pixel_font_allocation_stage_to_string((Pixel_Font_Allocation_Stage)i), &tracker->stages[i]);
+    log_stats("total", &tracker->total);
 }
 
-const char* pixel_font_baker_error_to_string(Pixel_Font_Baker_Error e) {
-    switch (e) {
-#define ERROR(key) case Pixel_Font_Baker_Error::key: return #key;
-        PIXEL_FONT_BAKER_ERRORS
+// NOTE: The whole file, zero terminated, so the bdf parser can sscanf and
+//   strncmp right on it.
+struct pfb__File_Contents {
+    char* data;
+    u64   length;
+};
+
+static Pixel_Font_Baker_Error pfb__read_file(const char* path, pfb__File_Contents* out_contents) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+    defer { fclose(file); };
+
+    if (fseek(file, 0, SEEK_END) != 0)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+    long length = ftell(file);
+    if (length < 0 || fseek(file, 0, SEEK_SET) != 0)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+
+    char* data = (char*)pfb__allocate((u64)length + 1, Pixel_Font_Allocation_Stage::FONT_FILE);
+    if (!data)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+
+    if (fread(data, 1, (u64)length, file) != (u64)length) {
+        pfb__deallocate(data, Pixel_Font_Allocation_Stage::FONT_FILE);
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+    }
+    data[length] = '\0';
+
+    out_contents->data   = data;
+    out_contents->length = (u64)length;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+//
+//  Kernels
+//
+// NOTE: The hot inner loops of the bakers and renderers. Every kernel has a
+//   plain per-element *_reference version next to it that defines what it has
+//   to compute, bench/kernel_bench.cpp checks that both agree bit for bit.
+//   Define PIXEL_FONT_BAKER_NO_SIMD to keep the SSE2 paths out.
+#if defined(__SSE2__) && !defined(PIXEL_FONT_BAKER_NO_SIMD)
+#  define PIXEL_FONT_BAKER_SSE2 1
+#else
+#  define PIXEL_FONT_BAKER_SSE2 0
+#endif
+
+struct pfb__Byte_Tables {
+    s8 hex_value[256]; // -1 for everything that is not a hex digit
+    u8 reversed[256];  // bit order reversed, LSB first <-> MSB first
+
+    constexpr pfb__Byte_Tables() : hex_value(), reversed() {
+        for (u32 i = 0; i < 256; ++i) {
+            hex_value[i] =
+                (i >= '0' && i <= '9') ? (s8)(i - '0')      :
+                (i >= 'a' && i <= 'f') ? (s8)(i - 'a' + 10) :
+                (i >= 'A' && i <= 'F') ? (s8)(i - 'A' + 10) : (s8)-1;
+
+            u8 r = 0;
+            for (u32 b = 0; b < 8; ++b)
+                r |= (u8)(((i >> b) & 1) << (7 - b));
+            reversed[i] = r;
+        }
+    }
+};
+
+static constexpr pfb__Byte_Tables pfb__byte_tables;
+
+// NOTE: Decodes byte_count bytes written as two hex digits each. The
+//   reference is the sscanf loop the bdf loader used to run, which also
+//   accepts things like a single digit or a sign; the table based version only
+//   accepts exactly two hex digits per byte.
+[[maybe_unused]] static bool pfb__decode_hex_reference(const char* src, u8* dst, u32 byte_count) {
+    for (u32 i = 0; i < byte_count; ++i) {
+        u32 value;
+        if (sscanf(src + 2*i, "%2x", &value) != 1)
+            return false;
+        dst[i] = (u8)value;
+    }
+    return true;
+}
+
+static bool pfb__decode_hex(const char* src, u8* dst, u32 byte_count) {
+    s32 invalid = 0;
+    for (u32 i = 0; i < byte_count; ++i) {
+        s32 hi = pfb__byte_tables.hex_value[(u8)src[2*i]];
+        s32 lo = pfb__byte_tables.hex_value[(u8)src[2*i+1]];
+        invalid |= hi | lo;
+        dst[i] = (u8)((hi << 4) | (lo & 0xf));
+    }
+    return invalid >= 0;
+}
+
+// NOTE: Sets bit dst_bit+i (MSB first) of dst for every i < count where
+//   src[i*step] >= threshold. Bits are only ever set, never cleared.
+[[maybe_unused]] static void pfb__threshold_pack_reference(const u8* src, u32 step, u32 count, u8 threshold,
+                                                           u8* dst, u32 dst_bit)
+{
+    for (u32 i = 0; i < count; ++i) {
+        u32 bit = dst_bit + i;
+        if (src[i * step] >= threshold)
+            dst[bit / 8] |= (u8)(0x80 >> (bit % 8));
+    }
+}
+
+// NOTE: ORs the top bit_count bits of bits into dst at bit offset shift (< 8).
+static inline void pfb__or_bits(u8* dst, u32 shift, u8 bits, u32 bit_count) {
+    dst[0] |= (u8)(bits >> shift);
+    if (shift + bit_count > 8)
+        dst[1] |= (u8)(bits << (8 - shift));
+}
+
+static void pfb__threshold_pack(const u8* src, u32 step, u32 count, u8 threshold,
+                                u8* dst, u32 dst_bit)
+{
+    dst += dst_bit / 8;
+    u32 shift = dst_bit % 8;
+    u32 i = 0;
+
+#if PIXEL_FONT_BAKER_SSE2
+    if (step == 1) {
+        // NOTE: x >= t  <=>  max(x, t) == x, for unsigned bytes
+        __m128i t = _mm_set1_epi8((char)threshold);
+        for (; i + 16 <= count; i += 16, dst += 2) {
+            __m128i v    = _mm_loadu_si128((const __m128i*)(src + i));
+            u32     mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v));
+            pfb__or_bits(dst,     shift, pfb__byte_tables.reversed[mask & 0xff], 8);
+            pfb__or_bits(dst + 1, shift, pfb__byte_tables.reversed[mask >> 8],   8);
+        }
+    }
+#endif
+
+    for (; i + 8 <= count; i += 8, ++dst) {
+        const u8* s = src + (u64)i * step;
+        u8 bits =
+            (u8)((s[0*step] >= threshold) << 7 | (s[1*step] >= threshold) << 6 |
+                 (s[2*step] >= threshold) << 5 | (s[3*step] >= threshold) << 4 |
+                 (s[4*step] >= threshold) << 3 | (s[5*step] >= threshold) << 2 |
+                 (s[6*step] >= threshold) << 1 | (s[7*step] >= threshold) << 0);
+        pfb__or_bits(dst, shift, bits, 8);
+    }
+
+    if (i < count) {
+        u32 rest = count - i;
+        u8  bits = 0;
+        for (u32 k = 0; k < rest; ++k)
+            bits |= (u8)((src[(u64)(i + k) * step] >= threshold) << (7 - k));
+        pfb__or_bits(dst, shift, bits, rest);
+    }
+}
+
+// NOTE: ORs the pixels [col_begin, col_end) of a glyph row into a framebuffer
+//   row, glyph column col lands on framebuffer pixel x+col. The caller has
+//   clipped, so x+col_begin >= 0 and x+col_end is inside the row.
+[[maybe_unused]] static void pfb__blit_row_reference(u8* dst, s32 x, const u8* src, s32 col_begin, s32 col_end) {
+    for (s32 col = col_begin; col < col_end; ++col) {
+        if (src[col / 8] & (0x80 >> (col % 8))) {
+            s32 px = x + col;
+            dst[px / 8] |= (u8)(0x80 >> (px % 8));
+        }
+    }
+}
+
+static void pfb__blit_row(u8* dst, s32 x, const u8* src, s32 col_begin, s32 col_end) {
+    for (s32 i = col_begin / 8; i * 8 < col_end; ++i) {
+        s32 c0   = i * 8;
+        u8  bits = src[i];
+        if (c0 < col_begin)
+            bits &= (u8)(0xff >> (col_begin - c0));
+        if (c0 + 8 > col_end)
+            bits &= (u8)(0xff00 >> (col_end - c0));
+        if (!bits)
+            continue;
+
+        // NOTE: px can be negative for the first byte of a glyph that hangs
+        //   over the left edge, the masked bits then all land in byte+1.
+        s32 px    = x + c0;
+        u32 shift = (u32)px & 7;
+        s32 byte  = (px - (s32)shift) / 8;
+        u8  hi    = (u8)(bits >> shift);
+        u8  lo    = shift ? (u8)(bits << (8 - shift)) : 0;
+        if (hi) dst[byte]     |= hi;
+        if (lo) dst[byte + 1] |= lo;
+    }
+}
+
+// NOTE: Loads a row of the word row layout (row_bytes 1, 2, 4 or 8, src
+//   aligned to it) with one load, MSB first into the top of the result.
+static inline u64 pfb__load_row_word(const u8* src, u32 row_bytes) {
+    switch (row_bytes) {
+        case 1: return (u64)*src << 56;
+        case 2: { u16 w; memcpy(&w, src, 2); return (u64)__builtin_bswap16(w) << 48; }
+        case 4: { u32 w; memcpy(&w, src, 4); return (u64)__builtin_bswap32(w) << 32; }
+        default: { u64 w; memcpy(&w, src, 8); return __builtin_bswap64(w); }
+    }
+}
+
+// NOTE: Same as pfb__blit_row for rows of the word row layout: the row is
+//   loaded once, masked and shifted into place, and ORed into the
+//   framebuffer with one 8 byte read-modify-write when dst_bytes (the length
+//   of the framebuffer row) leaves room for it.
+static void pfb__blit_row_word(u8* dst, u32 dst_bytes, s32 x, const u8* src, u32 row_bytes,
+                               s32 col_begin, s32 col_end)
+{
+    u64 bits = pfb__load_row_word(src, row_bytes);
+    bits &= (~0ull >> col_begin) & (~0ull << (64 - col_end));
+    if (!bits)
+        return;
+
+    // NOTE: Clipped on the left, the masked bits start at pixel 0.
+    if (x < 0) {
+        bits  <<= -x;
+        col_end += x;
+        x        = 0;
+    }
+
+    u32 shift = (u32)x & 7;
+    u32 byte  = (u32)x / 8;
+    u64 hi    = bits >> shift;
+    u8  lo    = (u8)((bits & ((1ull << shift) - 1)) << (8 - shift)); // shifted out of hi, rows over 56 px only
+
+    if (byte + 8 <= dst_bytes) {
+        u64 word;
+        memcpy(&word, dst + byte, 8);
+        word |= __builtin_bswap64(hi);
+        memcpy(dst + byte, &word, 8);
+    } else {
+        for (u32 i = 0; i < 8 && byte + i < dst_bytes; ++i)
+            dst[byte + i] |= (u8)(hi >> (56 - 8 * i));
+    }
+    if (lo)
+        dst[byte + 8] |= lo;
+}
+
+// NOTE: Expands the first pixel_count pixels of a 1-bpp row into 2-bpp,
+//   writing (pixel_count + 3) / 4 bytes: set pixels become foreground, clear
+//   ones and the pixels past pixel_count in the last byte background.
+[[maybe_unused]] static void pfb__expand_row_2bpp_reference(const u8* src, u32 pixel_count, u8 foreground,
+                                                            u8 background, u8* dst)
+{
+    u32 padded = (pixel_count + 3) & ~3u;
+    for (u32 px = 0; px < padded; ++px) {
+        bool set  = px < pixel_count && (src[px / 8] & (0x80 >> (px % 8)));
+        u32 shift = 6 - 2 * (px % 4);
+        dst[px / 4] = (u8)((dst[px / 4] & ~(3u << shift)) | ((set ? foreground : background) & 3u) << shift);
+    }
+}
+
+// NOTE: Same for 4-bpp, writing (pixel_count + 1) / 2 bytes.
+[[maybe_unused]] static void pfb__expand_row_4bpp_reference(const u8* src, u32 pixel_count, u8 foreground,
+                                                            u8 background, u8* dst)
+{
+    u32 padded = (pixel_count + 1) & ~1u;
+    for (u32 px = 0; px < padded; ++px) {
+        bool set  = px < pixel_count && (src[px / 8] & (0x80 >> (px % 8)));
+        u32 shift = 4 - 4 * (px % 2);
+        dst[px / 2] = (u8)((dst[px / 2] & ~(15u << shift)) | ((set ? foreground : background) & 15u) << shift);
+    }
+}
+
+// NOTE: Spread the 8 pixels of a byte to 2 (4) bits each, the first pixel
+//   ending up in the top bits, then pick the color per pixel with
+//   background ^ (mask & (foreground ^ background)).
+static inline u16 pfb__spread_2bpp(u8 bits) {
+    u32 x = bits;
+    x = (x | x << 4) & 0x0f0f;
+    x = (x | x << 2) & 0x3333;
+    x = (x | x << 1) & 0x5555;
+    return (u16)(x | x << 1);
+}
+
+static inline u32 pfb__spread_4bpp(u8 bits) {
+    u32 x = bits;
+    x = (x | x << 12) & 0x000f000f;
+    x = (x | x << 6)  & 0x03030303;
+    x = (x | x << 3)  & 0x11111111;
+    return x * 15;
+}
+
+static void pfb__expand_row_2bpp(const u8* src, u32 pixel_count, u8 foreground, u8 background, u8* dst) {
+    u32 full_bytes = pixel_count / 8;
+    u32 i = 0;
+
+    u16 background_pattern = (u16)((background & 3u) * 0x5555u);
+    u16 difference_pattern = (u16)(((foreground ^ background) & 3u) * 0x5555u);
+
+#if PIXEL_FONT_BAKER_SSE2
+    {
+        // NOTE: Every source byte becomes its high and its low nibble, each
+        //   nibble is spread to a byte with 16-bit shifts (the masks keep
+        //   the bits from crossing into the neighbouring byte).
+        __m128i nibble            = _mm_set1_epi8(0x0f);
+        __m128i m33               = _mm_set1_epi8(0x33);
+        __m128i m55               = _mm_set1_epi8(0x55);
+        __m128i background_vector = _mm_set1_epi8((char)background_pattern);
+        __m128i difference_vector = _mm_set1_epi8((char)difference_pattern);
+        for (; i + 16 <= full_bytes; i += 16) {
+            __m128i v  = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+            __m128i lo = _mm_and_si128(v, nibble);
+            __m128i halves[2] = { _mm_unpacklo_epi8(hi, lo), _mm_unpackhi_epi8(hi, lo) };
+            for (u32 h = 0; h < 2; ++h) {
+                __m128i x = halves[h];
+                x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi16(x, 2)), m33);
+                x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi16(x, 1)), m55);
+                x = _mm_or_si128(x, _mm_slli_epi16(x, 1));
+                _mm_storeu_si128((__m128i*)(dst + 2 * i + 16 * h),
+                                 _mm_xor_si128(background_vector, _mm_and_si128(x, difference_vector)));
+            }
+        }
+    }
+#endif
+
+    for (; i < full_bytes; ++i) {
+        u16 out = (u16)(background_pattern ^ (pfb__spread_2bpp(src[i]) & difference_pattern));
+        dst[2 * i]     = (u8)(out >> 8);
+        dst[2 * i + 1] = (u8)out;
+    }
+
+    u32 rest = pixel_count % 8;
+    if (rest) {
+        u16 out = (u16)(background_pattern ^ (pfb__spread_2bpp((u8)(src[i] & (0xff00 >> rest))) & difference_pattern));
+        dst[2 * i] = (u8)(out >> 8);
+        if (rest > 4)
+            dst[2 * i + 1] = (u8)out;
+    }
+}
+
+static void pfb__expand_row_4bpp(const u8* src, u32 pixel_count, u8 foreground, u8 background, u8* dst) {
+    u32 full_bytes = pixel_count / 8;
+    u32 i = 0;
+
+    u32 background_pattern = (background & 15u) * 0x11111111u;
+    u32 difference_pattern = ((foreground ^ background) & 15u) * 0x11111111u;
+
+#if PIXEL_FONT_BAKER_SSE2
+    {
+        // NOTE: Every source byte becomes four bytes of two pixels each,
+        //   every pixel pair is spread to two nibbles.
+        __m128i pair              = _mm_set1_epi8(0x03);
+        __m128i m11               = _mm_set1_epi8(0x11);
+        __m128i background_vector = _mm_set1_epi8((char)background_pattern);
+        __m128i difference_vector = _mm_set1_epi8((char)difference_pattern);
+        for (; i + 16 <= full_bytes; i += 16) {
+            __m128i v  = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i p0 = _mm_and_si128(_mm_srli_epi16(v, 6), pair);
+            __m128i p1 = _mm_and_si128(_mm_srli_epi16(v, 4), pair);
+            __m128i p2 = _mm_and_si128(_mm_srli_epi16(v, 2), pair);
+            __m128i p3 = _mm_and_si128(v, pair);
+            __m128i a_lo = _mm_unpacklo_epi8(p0, p1), a_hi = _mm_unpackhi_epi8(p0, p1);
+            __m128i b_lo = _mm_unpacklo_epi8(p2, p3), b_hi = _mm_unpackhi_epi8(p2, p3);
+            __m128i quarters[4] = {
+                _mm_unpacklo_epi16(a_lo, b_lo), _mm_unpackhi_epi16(a_lo, b_lo),
+                _mm_unpacklo_epi16(a_hi, b_hi), _mm_unpackhi_epi16(a_hi, b_hi),
+            };
+            for (u32 q = 0; q < 4; ++q) {
+                __m128i x = quarters[q];
+                x = _mm_and_si128(_mm_or_si128(x, _mm_slli_epi16(x, 3)), m11);
+                x = _mm_or_si128(x, _mm_slli_epi16(x, 1));
+                x = _mm_or_si128(x, _mm_slli_epi16(x, 2));
+                _mm_storeu_si128((__m128i*)(dst + 4 * i + 16 * q),
+                                 _mm_xor_si128(background_vector, _mm_and_si128(x, difference_vector)));
+            }
+        }
+    }
+#endif
+
+    for (; i < full_bytes; ++i) {
+        u32 out = __builtin_bswap32(background_pattern ^ (pfb__spread_4bpp(src[i]) & difference_pattern));
+        memcpy(dst + 4 * i, &out, 4);
+    }
+
+    u32 rest = pixel_count % 8;
+    if (rest) {
+        u32 out = __builtin_bswap32(background_pattern ^
+                                    (pfb__spread_4bpp((u8)(src[i] & (0xff00 >> rest))) & difference_pattern));
+        memcpy(dst + 4 * i, &out, (rest + 1) / 2);
+    }
+}
+
+// NOTE: CRC32C (Castagnoli, reflected polynomial 0x82f63b78), the CRC that
+//   SSE4.2 and the ARMv8 CRC extension compute in hardware. crc is the
+//   checksum of the bytes before, 0 to start. The table version does 8 bytes
+//   per step (slicing by 8). The SSE4.2 version is picked at runtime, so it
+//   does not need -msse4.2.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(PIXEL_FONT_BAKER_NO_SIMD)
+#  define PIXEL_FONT_BAKER_CRC32C_SSE42 1
+#else
+#  define PIXEL_FONT_BAKER_CRC32C_SSE42 0
+#endif
+#if defined(__ARM_FEATURE_CRC32) && !defined(PIXEL_FONT_BAKER_NO_SIMD)
+#  define PIXEL_FONT_BAKER_CRC32C_ARM 1
+#  include <arm_acle.h>
+#else
+#  define PIXEL_FONT_BAKER_CRC32C_ARM 0
+#endif
+
+struct pfb__Crc32c_Tables {
+    u32 table[8][256];
+
+    constexpr pfb__Crc32c_Tables() : table() {
+        for (u32 i = 0; i < 256; ++i) {
+            u32 crc = i;
+            for (u32 b = 0; b < 8; ++b)
+                crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+            table[0][i] = crc;
+        }
+        for (u32 i = 0; i < 256; ++i) {
+            for (u32 k = 1; k < 8; ++k)
+                table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xff];
+        }
+    }
+};
+
+static constexpr pfb__Crc32c_Tables pfb__crc32c_tables;
+
+[[maybe_unused]] static u32 pfb__crc32c_reference(u32 crc, const u8* data, u64 length) {
+    crc = ~crc;
+    for (u64 i = 0; i < length; ++i) {
+        crc ^= data[i];
+        for (u32 b = 0; b < 8; ++b)
+            crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static u32 pfb__crc32c_table(u32 crc, const u8* data, u64 length) {
+    const auto& t = pfb__crc32c_tables.table;
+    crc = ~crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        u32 lo, hi;
+        memcpy(&lo, data,     4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; length > 0; ++data, --length)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+    return ~crc;
+}
+
+#if PIXEL_FONT_BAKER_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static u32 pfb__crc32c_sse42(u32 crc, const u8* data, u64 length) {
+    crc = ~crc;
+#if defined(__x86_64__)
+    u64 crc64 = crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        u64 word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (u32)crc64;
+#endif
+    for (; length >= 4; data += 4, length -= 4) {
+        u32 word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; length > 0; ++data, --length)
+        crc = _mm_crc32_u8(crc, *data);
+    return ~crc;
+}
+#endif
+
+#if PIXEL_FONT_BAKER_CRC32C_ARM
+static u32 pfb__crc32c_arm(u32 crc, const u8* data, u64 length) {
+    crc = ~crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        u64 word;
+        memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+    }
+    for (; length > 0; ++data, --length)
+        crc = __crc32cb(crc, *data);
+    return ~crc;
+}
+#endif
+
+static u32 pfb__crc32c(u32 crc, const u8* data, u64 length) {
+#if PIXEL_FONT_BAKER_CRC32C_ARM
+    return pfb__crc32c_arm(crc, data, length);
+#else
+#  if PIXEL_FONT_BAKER_CRC32C_SSE42
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    if (has_sse42)
+        return pfb__crc32c_sse42(crc, data, length);
+#  endif
+    return pfb__crc32c_table(crc, data, length);
+#endif
+}
+
+//
+//  Compressed inputs
+//
+// NOTE: Fonts often ship compressed: bdf (and pcf, which is not supported)
+//   as .gz, ttf as WOFF with every table zlib compressed. The decoder below
+//   is a plain DEFLATE (RFC 1951) decoder that writes straight into the
+//   buffer the loaders parse, so nothing is decompressed to a temp file.
+//   WOFF2 (Brotli) is not supported.
+#define PFB__INFLATE_FAST_BITS 9
+
+// NOTE: Canonical Huffman code. Codes up to FAST_BITS long are looked up in
+//   fast with the next bits of the input (stored LSB first, so the table is
+//   indexed by the bit reversed code), longer ones are found by comparing
+//   against max_code per length.
+struct pfb__Huffman {
+    u16 fast[1 << PFB__INFLATE_FAST_BITS]; // (length << 9) | symbol, 0 if not a fast code
+    u16 first_code[16];
+    u16 first_symbol[16];
+    u32 max_code[17];                      // exclusive, shifted to 16 bits
+    u8  lengths[288];                      // by position in canonical order
+    u16 symbols[288];
+};
+
+struct pfb__Inflate {
+    const u8* in;
+    u64 in_length;
+    u64 in_position;
+    u64 bits;
+    u32 bit_count;
+    bool overrun; // read past the end of the input
+
+    u8* out;
+    u64 out_length;
+    u64 out_capacity;
+    bool out_fixed; // the output has to fit out_capacity exactly, no growing
+};
+
+static u32 pfb__reverse_bits(u32 code, u32 length) {
+    u32 reversed = 0;
+    for (u32 i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+static bool pfb__build_huffman(pfb__Huffman* h, const u8* code_lengths, u32 count) {
+    u32 length_counts[16] = {};
+    for (u32 i = 0; i < count; ++i)
+        ++length_counts[code_lengths[i]];
+    length_counts[0] = 0;
+
+    memset(h->fast, 0, sizeof(h->fast));
+
+    u32 next_code[16];
+    u32 code   = 0;
+    u32 symbol = 0;
+    for (u32 length = 1; length < 16; ++length) {
+        if (length_counts[length] > (1u << length))
+            return false;
+        next_code[length]       = code;
+        h->first_code[length]   = (u16)code;
+        h->first_symbol[length] = (u16)symbol;
+        code += length_counts[length];
+        if (length_counts[length] && code - 1 >= (1u << length))
+            return false;
+        h->max_code[length] = code << (16 - length);
+        code   <<= 1;
+        symbol  += length_counts[length];
+    }
+    h->max_code[16] = 0x10000;
+
+    for (u32 i = 0; i < count; ++i) {
+        u32 length = code_lengths[i];
+        if (!length)
+            continue;
+        u32 position = next_code[length] - h->first_code[length] + h->first_symbol[length];
+        h->lengths[position] = (u8)length;
+        h->symbols[position] = (u16)i;
+        if (length <= PFB__INFLATE_FAST_BITS) {
+            for (u32 j = pfb__reverse_bits(next_code[length], length); j < (1u << PFB__INFLATE_FAST_BITS); j += 1u << length)
+                h->fast[j] = (u16)((length << 9) | i);
+        }
+        ++next_code[length];
+    }
+    return true;
+}
+
+// NOTE: Past the end of the input the bit buffer is filled with zeros, so
+//   the decoder never runs dry. Once more bits were used than the input has,
+//   the stream is failed.
+static inline void pfb__inflate_refill(pfb__Inflate* z) {
+    while (z->bit_count <= 56) {
+        if (z->in_position < z->in_length)
+            z->bits |= (u64)z->in[z->in_position] << z->bit_count;
+        ++z->in_position;
+        z->bit_count += 8;
+    }
+    z->overrun |= z->in_position * 8 - z->bit_count > z->in_length * 8;
+}
+
+static inline u32 pfb__inflate_bits(pfb__Inflate* z, u32 count) {
+    if (z->bit_count < count)
+        pfb__inflate_refill(z);
+    u32 value = (u32)(z->bits & ((1ull << count) - 1));
+    z->bits      >>= count;
+    z->bit_count  -= count;
+    return value;
+}
+
+// NOTE: -1 for a code that is not in the table.
+static inline s32 pfb__inflate_symbol(pfb__Inflate* z, const pfb__Huffman* h) {
+    if (z->bit_count < 16)
+        pfb__inflate_refill(z);
+
+    u32 fast = h->fast[z->bits & ((1u << PFB__INFLATE_FAST_BITS) - 1)];
+    if (fast) {
+        u32 length = fast >> 9;
+        z->bits      >>= length;
+        z->bit_count  -= length;
+        return (s32)(fast & 511);
+    }
+
+    u32 code = pfb__reverse_bits((u32)(z->bits & 0xffff), 16);
+    u32 length = PFB__INFLATE_FAST_BITS + 1;
+    while (length < 16 && code >= h->max_code[length])
+        ++length;
+    if (length >= 16)
+        return -1;
+
+    u32 position = (code >> (16 - length)) - h->first_code[length] + h->first_symbol[length];
+    if (position >= 288 || h->lengths[position] != length)
+        return -1;
+    z->bits      >>= length;
+    z->bit_count  -= length;
+    return h->symbols[position];
+}
+
+static bool pfb__inflate_reserve(pfb__Inflate* z, u64 count) {
+    if (z->out_length + count <= z->out_capacity)
+        return true;
+    if (z->out_fixed)
+        return false;
+
+    // NOTE: +1 keeps room for the terminating zero the loaders want
+    u64 capacity = max(z->out_capacity * 2, z->out_length + count + 1);
+    u8* grown = (u8*)pfb__allocate(capacity, Pixel_Font_Allocation_Stage::FONT_FILE);
+    if (!grown)
+        return false;
+    if (z->out_length)
+        memcpy(grown, z->out, z->out_length);
+    pfb__deallocate(z->out, Pixel_Font_Allocation_Stage::FONT_FILE);
+    z->out          = grown;
+    z->out_capacity = capacity;
+    return true;
+}
+
+static const u16 pfb__length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const u8  pfb__length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const u16 pfb__distance_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const u8  pfb__distance_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static bool pfb__inflate_codes(pfb__Inflate* z, const pfb__Huffman* literals, const pfb__Huffman* distances) {
+    while (true) {
+        s32 symbol = pfb__inflate_symbol(z, literals);
+        if (symbol < 0 || z->overrun)
+            return false;
+
+        if (symbol < 256) {
+            if (!pfb__inflate_reserve(z, 1))
+                return false;
+            z->out[z->out_length++] = (u8)symbol;
+            continue;
+        }
+        if (symbol == 256)
+            return true;
+
+        symbol -= 257;
+        if (symbol >= 29)
+            return false;
+        u32 length = pfb__length_base[symbol] + pfb__inflate_bits(z, pfb__length_extra[symbol]);
+
+        s32 distance_symbol = pfb__inflate_symbol(z, distances);
+        if (distance_symbol < 0 || distance_symbol >= 30)
+            return false;
+        u32 distance = pfb__distance_base[distance_symbol] + pfb__inflate_bits(z, pfb__distance_extra[distance_symbol]);
+        if (distance > z->out_length || !pfb__inflate_reserve(z, length))
+            return false;
+
+        // NOTE: The copy may overlap its own output (distance < length),
+        //   then it has to go byte by byte.
+        u8* dst = z->out + z->out_length;
+        const u8* src = dst - distance;
+        if (distance >= length) {
+            memcpy(dst, src, length);
+        } else {
+            for (u32 i = 0; i < length; ++i)
+                dst[i] = src[i];
+        }
+        z->out_length += length;
+    }
+}
+
+static bool pfb__inflate_dynamic_tables(pfb__Inflate* z, pfb__Huffman* literals, pfb__Huffman* distances) {
+    static const u8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    u32 literal_count  = pfb__inflate_bits(z, 5) + 257;
+    u32 distance_count = pfb__inflate_bits(z, 5) + 1;
+    u32 length_count   = pfb__inflate_bits(z, 4) + 4;
+
+    u8 code_length_lengths[19] = {};
+    for (u32 i = 0; i < length_count; ++i)
+        code_length_lengths[order[i]] = (u8)pfb__inflate_bits(z, 3);
+
+    pfb__Huffman code_lengths;
+    if (!pfb__build_huffman(&code_lengths, code_length_lengths, 19))
+        return false;
+
+    u8 lengths[288 + 32];
+    u32 count = 0;
+    while (count < literal_count + distance_count) {
+        s32 symbol = pfb__inflate_symbol(z, &code_lengths);
+        if (symbol < 0 || z->overrun)
+            return false;
+
+        if (symbol < 16) {
+            lengths[count++] = (u8)symbol;
+            continue;
+        }
+
+        u8  value  = 0;
+        u32 repeat = 0;
+        if (symbol == 16) {
+            if (count == 0)
+                return false;
+            value  = lengths[count - 1];
+            repeat = 3 + pfb__inflate_bits(z, 2);
+        } else if (symbol == 17) {
+            repeat = 3 + pfb__inflate_bits(z, 3);
+        } else {
+            repeat = 11 + pfb__inflate_bits(z, 7);
+        }
+        if (count + repeat > literal_count + distance_count)
+            return false;
+        memset(lengths + count, value, repeat);
+        count += repeat;
+    }
+
+    return pfb__build_huffman(literals, lengths, literal_count) &&
+           pfb__build_huffman(distances, lengths + literal_count, distance_count);
+}
+
+// NOTE: Decodes one DEFLATE stream starting at z->in_position and leaves
+//   in_position on the first byte after it.
+static bool pfb__inflate(pfb__Inflate* z) {
+    z->bits      = 0;
+    z->bit_count = 0;
+    z->overrun   = false;
+
+    bool last_block = false;
+    while (!last_block) {
+        last_block = pfb__inflate_bits(z, 1);
+        u32 type   = pfb__inflate_bits(z, 2);
+
+        if (type == 0) {
+            // NOTE: Stored: skip to the byte boundary, the bytes still in the
+            //   bit buffer are handed back to the input.
+            pfb__inflate_bits(z, z->bit_count & 7);
+            z->in_position -= z->bit_count / 8;
+            z->bits      = 0;
+            z->bit_count = 0;
+
+            if (z->in_position + 4 > z->in_length)
+                return false;
+            u32 length  = z->in[z->in_position]     | (u32)z->in[z->in_position + 1] << 8;
+            u32 nlength = z->in[z->in_position + 2] | (u32)z->in[z->in_position + 3] << 8;
+            z->in_position += 4;
+            if ((length ^ 0xffff) != nlength || z->in_position + length > z->in_length ||
+                !pfb__inflate_reserve(z, length))
+            {
+                return false;
+            }
+            memcpy(z->out + z->out_length, z->in + z->in_position, length);
+            z->out_length  += length;
+            z->in_position += length;
+        } else if (type == 1 || type == 2) {
+            pfb__Huffman literals;
+            pfb__Huffman distances;
+            if (type == 1) {
+                u8 lengths[288 + 32];
+                memset(lengths,       8, 144);
+                memset(lengths + 144, 9, 112);
+                memset(lengths + 256, 7, 24);
+                memset(lengths + 280, 8, 8);
+                memset(lengths + 288, 5, 32);
+                pfb__build_huffman(&literals,  lengths,       288);
+                pfb__build_huffman(&distances, lengths + 288, 32);
+            } else if (!pfb__inflate_dynamic_tables(z, &literals, &distances)) {
+                return false;
+            }
+            if (!pfb__inflate_codes(z, &literals, &distances))
+                return false;
+        } else {
+            return false;
+        }
+    }
+
+    // NOTE: whole bytes left in the bit buffer were not part of the stream
+    z->in_position -= z->bit_count / 8;
+    z->bits      = 0;
+    z->bit_count = 0;
+    return !z->overrun && z->in_position <= z->in_length;
+}
+
+struct pfb__Crc32_Table {
+    u32 table[256];
+
+    constexpr pfb__Crc32_Table() : table() {
+        for (u32 i = 0; i < 256; ++i) {
+            u32 crc = i;
+            for (u32 b = 0; b < 8; ++b)
+                crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+            table[i] = crc;
+        }
+    }
+};
+
+static constexpr pfb__Crc32_Table pfb__crc32_table;
+
+// NOTE: The CRC32 of gzip (and zip, png), not CRC32C.
+static u32 pfb__crc32(u32 crc, const u8* data, u64 length) {
+    crc = ~crc;
+    for (u64 i = 0; i < length; ++i)
+        crc = (crc >> 8) ^ pfb__crc32_table.table[(crc ^ data[i]) & 0xff];
+    return ~crc;
+}
+
+static u32 pfb__adler32(const u8* data, u64 length) {
+    u32 a = 1, b = 0;
+    while (length > 0) {
+        // NOTE: 5552 is the most bytes before b can overflow
+        u64 chunk = min(length, (u64)5552);
+        for (u64 i = 0; i < chunk; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data   += chunk;
+        length -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+static inline u32 pfb__read_be32(const u8* p) {
+    return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3];
+}
+
+static inline u16 pfb__read_be16(const u8* p) {
+    return (u16)(p[0] << 8 | p[1]);
+}
+
+static inline void pfb__write_be32(u8* p, u32 value) {
+    p[0] = (u8)(value >> 24);
+    p[1] = (u8)(value >> 16);
+    p[2] = (u8)(value >> 8);
+    p[3] = (u8)value;
+}
+
+static inline void pfb__write_be16(u8* p, u16 value) {
+    p[0] = (u8)(value >> 8);
+    p[1] = (u8)value;
+}
+
+// NOTE: Decompresses a gzip file (all members) into out_contents, zero
+//   terminated like pfb__read_file.
+static Pixel_Font_Baker_Error pfb__gunzip(const u8* data, u64 length, pfb__File_Contents* out_contents) {
+    pfb__Inflate z = {};
+    z.in        = data;
+    z.in_length = length;
+
+    // NOTE: The last member's size (mod 2^32) is the first guess for the
+    //   output, which is exact for the usual single member file.
+    if (length >= 18) {
+        u64 size_hint = data[length - 4] | (u32)data[length - 3] << 8 | (u32)data[length - 2] << 16 | (u32)data[length - 1] << 24;
+        z.out_capacity = min(size_hint, length * 1032) + 1; // DEFLATE can't do better than 1032:1
+        z.out = (u8*)pfb__allocate(z.out_capacity, Pixel_Font_Allocation_Stage::FONT_FILE);
+        if (!z.out)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    }
+
+    bool ok = true;
+    u32 members = 0;
+    while (ok && z.in_position < length) {
+        const u8* member = data + z.in_position;
+        u64 member_length = length - z.in_position;
+        if (member_length < 18 || member[0] != 0x1f || member[1] != 0x8b || member[2] != 8) {
+            // NOTE: like gzip, padding after the last member is ignored
+            ok = members > 0;
+            break;
+        }
+        ++members;
+
+        u8  flags  = member[3];
+        u64 header = 10;
+        if (flags & 4) // FEXTRA
+            header += 2 + (member[header] | (u32)member[header + 1] << 8);
+        for (u8 flag : { (u8)8, (u8)16 }) { // FNAME, FCOMMENT
+            if (!(flags & flag))
+                continue;
+            while (header < member_length && member[header])
+                ++header;
+            ++header;
+        }
+        if (flags & 2) // FHCRC
+            header += 2;
+        if (header >= member_length) {
+            ok = false;
+            break;
+        }
+
+        u64 out_start = z.out_length;
+        z.in_position += header;
+        ok = pfb__inflate(&z) && z.in_position + 8 <= length;
+        if (!ok)
+            break;
+
+        const u8* trailer = data + z.in_position;
+        u32 crc  = trailer[0] | (u32)trailer[1] << 8 | (u32)trailer[2] << 16 | (u32)trailer[3] << 24;
+        u32 size = trailer[4] | (u32)trailer[5] << 8 | (u32)trailer[6] << 16 | (u32)trailer[7] << 24;
+        ok = crc  == pfb__crc32(0, z.out + out_start, z.out_length - out_start) &&
+             size == (u32)(z.out_length - out_start);
+        z.in_position += 8;
+    }
+
+    if (!ok || members == 0 || !pfb__inflate_reserve(&z, 1)) {
+        pfb__deallocate(z.out, Pixel_Font_Allocation_Stage::FONT_FILE);
+        return Pixel_Font_Baker_Error::FONT_FILE_DECOMPRESSION_FAILED;
+    }
+
+    z.out[z.out_length] = '\0';
+    out_contents->data   = (char*)z.out;
+    out_contents->length = z.out_length;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+// NOTE: Rebuilds the sfnt (plain ttf/otf) a WOFF 1.0 file wraps: the offset
+//   table, the table records and every table, inflated where it is
+//   compressed, each at a 4 byte aligned offset.
+static Pixel_Font_Baker_Error pfb__unwrap_woff(const u8* data, u64 length, pfb__File_Contents* out_contents) {
+    const u64 header_size = 44;
+    const u64 entry_size  = 20;
+    if (length < header_size)
+        return Pixel_Font_Baker_Error::FONT_FILE_DECOMPRESSION_FAILED;
+
+    u32 flavor      = pfb__read_be32(data + 4);
+    u16 table_count = pfb__read_be16(data + 12);
+    if (header_size + (u64)table_count * entry_size > length)
+        return Pixel_Font_Baker_Error::FONT_FILE_DECOMPRESSION_FAILED;
+
+    u64 sfnt_size = 12 + 16 * (u64)table_count;
+    for (u32 i = 0; i < table_count; ++i) {
+        const u8* entry = data + header_size + i * entry_size;
+        u64 offset      = pfb__read_be32(entry + 4);
+        u64 comp_length = pfb__read_be32(entry + 8);
+        u64 orig_length = pfb__read_be32(entry + 12);
+        if (offset + comp_length > length || comp_length > orig_length)
+            return Pixel_Font_Baker_Error::FONT_FILE_DECOMPRESSION_FAILED;
+        sfnt_size += (orig_length + 3) & ~3ull;
+    }
+
+    u8* sfnt = (u8*)pfb__allocate(sfnt_size + 1, Pixel_Font_Allocation_Stage::FONT_FILE);
+    if (!sfnt)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    memset(sfnt, 0, sfnt_size + 1);
+
+    u16 search_range    = 1;
+    u16 entry_selector  = 0;
+    while (search_range * 2u <= table_count) {
+        search_range *= 2;
+        ++entry_selector;
+    }
+    pfb__write_be32(sfnt,      flavor);
+    pfb__write_be16(sfnt + 4,  table_count);
+    pfb__write_be16(sfnt + 6,  (u16)(search_range * 16));
+    pfb__write_be16(sfnt + 8,  entry_selector);
+    pfb__write_be16(sfnt + 10, (u16)(table_count * 16 - search_range * 16));
+
+    u64 table_offset = 12 + 16 * (u64)table_count;
+    for (u32 i = 0; i < table_count; ++i) {
+        const u8* entry = data + header_size + i * entry_size;
+        u32 offset      = pfb__read_be32(entry + 4);
+        u32 comp_length = pfb__read_be32(entry + 8);
+        u32 orig_length = pfb__read_be32(entry + 12);
+
+        u8* record = sfnt + 12 + 16 * i;
+        memcpy(record, entry, 4);                              // tag
+        pfb__write_be32(record + 4,  pfb__read_be32(entry + 16)); // checksum
+        pfb__write_be32(record + 8,  (u32)table_offset);
+        pfb__write_be32(record + 12, orig_length);
+
+        bool ok;
+        if (comp_length == orig_length) {
+            memcpy(sfnt + table_offset, data + offset, orig_length);
+            ok = true;
+        } else {
+            // NOTE: zlib stream: CMF, FLG, deflate data, adler32 (big endian)
+            const u8* stream = data + offset;
+            ok = comp_length >= 6 && (stream[0] & 0x0f) == 8 && !(stream[1] & 0x20) &&
+                 (stream[0] * 256u + stream[1]) % 31 == 0;
+            if (ok) {
+                pfb__Inflate z = {};
+                z.in           = stream;
+                z.in_length    = comp_length - 4;
+                z.in_position  = 2;
+                z.out          = sfnt + table_offset;
+                z.out_capacity = orig_length;
+                z.out_fixed    = true;
+                ok = pfb__inflate(&z) && z.out_length == orig_length &&
+                     pfb__read_be32(stream + comp_length - 4) == pfb__adler32(z.out, z.out_length);
+            }
+        }
+        if (!ok) {
+            pfb__deallocate(sfnt, Pixel_Font_Allocation_Stage::FONT_FILE);
+            return Pixel_Font_Baker_Error::FONT_FILE_DECOMPRESSION_FAILED;
+        }
+
+        table_offset += (orig_length + 3) & ~3ull;
+    }
+
+    out_contents->data   = (char*)sfnt;
+    out_contents->length = sfnt_size;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+// NOTE: pfb__read_file for font sources: gzip files are decompressed and
+//   WOFF files unwrapped in memory, recognized by their magic, whatever the
+//   file is called.
+static Pixel_Font_Baker_Error pfb__read_font_file(const char* path, pfb__File_Contents* out_contents) {
+    pfb__File_Contents file;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_file(path, &file);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+
+    const u8* bytes = (const u8*)file.data;
+    Pixel_Font_Baker_Error (*unpack)(const u8*, u64, pfb__File_Contents*) = nullptr;
+    if (file.length >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b)
+        unpack = pfb__gunzip;
+    else if (file.length >= 4 && memcmp(bytes, "wOFF", 4) == 0)
+        unpack = pfb__unwrap_woff;
+
+    if (!unpack) {
+        *out_contents = file;
+        return Pixel_Font_Baker_Error::SUCCESS;
+    }
+
+    Pixel_Font_Baker_Error error = unpack(bytes, file.length, out_contents);
+    pfb__deallocate(file.data, Pixel_Font_Allocation_Stage::FONT_FILE);
+    return error;
+}
+
+// NOTE: Glyph metrics follow the table in the same block (and in files), at
+//   the next multiple of 8 bytes.
+static u64 pfb__glyph_metrics_offset(u64 table_size) {
+    return (table_size + 7) & ~(u64)7;
+}
+
+static inline s16 pfb__clamp_s16(s32 value) {
+    return (s16)max(-32768, min(32767, value));
+}
+
+static inline u16 pfb__clamp_u16(s32 value) {
+    return (u16)max(0, min(65535, value));
+}
+
+Pixel_Font_Baker_Error create_pixel_font_from_bdf(const char* font_path,
+                                                  u32 unicode_cp_start, u32 unicode_cp_end,
+                                                  Pixel_Font* out_font,
+                                                  const Pixel_Font_Bake_Options* options)
+{
+    pfb__File_Contents file_content;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_font_file(font_path, &file_content);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    defer { pfb__deallocate(file_content.data, Pixel_Font_Allocation_Stage::FONT_FILE); };
+
+    pfb__File_Contents cursor = file_content;
+
+    auto advance_cursor = [&](s32 amount = 1) -> void {
+        cursor.data   += amount;
+        cursor.length -= amount;
+    };
+
+    auto is_on_newline = [&]() -> bool {
+        return (*cursor.data == '\r'
+                || *cursor.data == '\n');
+    };
+
+    auto is_on_whitespace = [&]() -> bool {
+        return (*cursor.data == ' '
+                || *cursor.data == '\t'
+                || is_on_newline());
+    };
+
+    auto eat_whitespace = [&]() -> void {
+        while (is_on_whitespace())
+            advance_cursor();
+    };
+
+    auto eat_until_next_line = [&]() -> void {
+        // find newline
+        while (!is_on_newline() && cursor.length > 0)
+            advance_cursor();
+        // then eat all the whitespace
+        eat_whitespace();
+    };
+
+    auto eat_until_line_that_starts_with_and_skip = [&](const char* to_search, u32 to_search_length)
+        -> void
+    {
+        eat_whitespace();
+        while (strncmp(cursor.data, to_search, to_search_length) != 0 && cursor.length > 0) {
+            eat_until_next_line();
+        }
+
+        advance_cursor((s32)min(cursor.length, to_search_length)); // min prevents running out of the string
+    };
+
+
+    s32 font_size_x, font_size_y, start_x, start_y;
+    // NOTE(Felix): Find the font dimensions (FONTBOUNDINGBOX)
+    {
+        const char to_search[] = "FONTBOUNDINGBOX ";
+        u32 to_search_length   = sizeof(to_search) - 1; // sizeof includes null terminator
+        eat_until_line_that_starts_with_and_skip(to_search, to_search_length);
+
+        if (cursor.length == 0)
+            return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX;
+
+        // we are on the FONTBOUNDINGBOX line.
+        {
+            s32 filled_vars =
+                sscanf(cursor.data, "%d %d %d %d",
+                   &font_size_x, &font_size_y, &start_x, &start_y);
+
+            // NOTE: the cell has to fit Pixel_Font's u16 width and height
+            if (filled_vars != 4 || font_size_x < 0 || font_size_x > 0xffff || font_size_y < 0 || font_size_y > 0xffff) {
+                return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX_CORRECTLY;
+            }
+        }
+    }
+
+    // NOTE(Felix): allocate the needed memory
+    bool with_metrics = options && options->glyph_metrics;
+    {
+        out_font->char_px_width     = font_size_x;
+        out_font->char_px_height    = font_size_y;
+        out_font->bytes_per_line    = (font_size_x / 8) + (font_size_x % 8 != 0);
+        out_font->bytes_per_glyph   = font_size_y * out_font->bytes_per_line;
+        out_font->unicode_cp_start  = unicode_cp_start;
+        out_font->unicode_cp_end    = unicode_cp_end;
+        out_font->table_is_borrowed = false;
+        out_font->glyph_metrics     = nullptr;
+        out_font->cell_x            = pfb__clamp_s16(start_x);
+        out_font->baseline          = pfb__clamp_s16(font_size_y + start_y);
+        out_font->line_height       = pfb__clamp_s16(font_size_y);
+
+        u64 glyph_count = (u64)unicode_cp_end - unicode_cp_start + 1; // both inclusive so +1
+        u64 total_byte_size = out_font->bytes_per_glyph * glyph_count;
+
+        u64 block_size = with_metrics
+            ? pfb__glyph_metrics_offset(total_byte_size) + glyph_count * sizeof(Pixel_Font_Glyph_Metrics)
+            : total_byte_size;
+        // NOTE: A table this large can not be allocated (or memset) as one
+        //   object on this target, the sizes above can not overflow u64
+        //   with a u16 cell and at most 2^32 glyphs.
+        if (block_size > (u64)PTRDIFF_MAX)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+        out_font->table = pfb__allocate_table(block_size);
+        if (!out_font->table)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+
+        // NOTE: Glyphs the file does not have fill the cell (see below) and
+        //   advance by its width.
+        if (with_metrics) {
+            out_font->glyph_metrics =
+                (Pixel_Font_Glyph_Metrics*)(out_font->table + pfb__glyph_metrics_offset(total_byte_size));
+            for (u64 i = 0; i < glyph_count; ++i) {
+                out_font->glyph_metrics[i] = {
+                    pfb__clamp_s16(font_size_x), pfb__clamp_s16(start_x), pfb__clamp_s16(-(start_y + font_size_y)),
+                    pfb__clamp_u16(font_size_x), pfb__clamp_u16(font_size_y)
+                };
+            }
+        }
+
+        // NOTE(Felix): Initialize with checker board (if bytes_per_line is 1 or
+        //   2, otherwise its just stripes)
+        if (out_font->bytes_per_line == 1)
+            memset(out_font->table, 0b0101'0101'1010'1010, total_byte_size);
+        else if (out_font->bytes_per_line == 2)
+            memset(out_font->table, 0b0101'1010'0101'1010, total_byte_size);
+        else
+            memset(out_font->table, 0b0101'0101'0101'0101, total_byte_size);
+
+    }
+
+    // NOTE: One decoded bitmap row, grown to the widest BBX.
+    u8* row_buffer      = nullptr;
+    u32 row_buffer_size = 0;
+    defer { pfb__deallocate(row_buffer, Pixel_Font_Allocation_Stage::SCRATCH); };
+
+    // NOTE: A table is only handed out if the whole file parsed.
+    bool parsed = false;
+    defer {
+        if (!parsed) {
+            pfb__deallocate_table(out_font->table);
+            out_font->table         = nullptr;
+            out_font->glyph_metrics = nullptr;
+        }
+    };
+
+    // NOTE(Felix): read all relevant bitmaps until end of file
+    while (cursor.length > 0) {
+        { // NOTE(Felix): Jump to the codepoint
+            const char to_search[] = "ENCODING ";
+            u32 to_search_length   = sizeof(to_search) - 1; // sizeof includes null terminator
+            eat_until_line_that_starts_with_and_skip(to_search, to_search_length);
+
+            if (cursor.length <= 0)
+                break;
+        }
+
+        s32 code_point = 0;
+        s32 filled_vars =
+            sscanf(cursor.data, "%d", &code_point);
+
+        if (filled_vars != 1) {
+            return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_CODEPOINT_CORRECTLY;
+        }
+
+        if (code_point < (s32)unicode_cp_start || code_point > (s32)unicode_cp_end)
+            continue;
+
+        byte* table_entry =
+            out_font->table + (out_font->bytes_per_glyph *
+                               (code_point - unicode_cp_start));
+
+        // NOTE: The glyph's own box, the font's box if it has no BBX line.
+        //   Rows and offsets are relative to the baseline, y going up.
+        s32 bbx_w = font_size_x, bbx_h = font_size_y, bbx_x = start_x, bbx_y = start_y;
+        s32 advance = font_size_x;
+        { // NOTE(Felix): Jump to the numbers
+            eat_until_next_line();
+            while (cursor.length > 0 && strncmp(cursor.data, "BITMAP", 6) != 0) {
+                if (strncmp(cursor.data, "BBX ", 4) == 0 &&
+                    sscanf(cursor.data + 4, "%d %d %d %d", &bbx_w, &bbx_h, &bbx_x, &bbx_y) != 4)
+                {
+                    return Pixel_Font_Baker_Error::BDF_ERROR_PARSING_CHARACTER_BYTES;
+                }
+                if (strncmp(cursor.data, "DWIDTH ", 7) == 0 && sscanf(cursor.data + 7, "%d", &advance) != 1)
+                    return Pixel_Font_Baker_Error::BDF_ERROR_PARSING_CHARACTER_BYTES;
+                eat_until_next_line();
+            }
+            if (cursor.length == 0 || bbx_w < 0 || bbx_h < 0)
+                return Pixel_Font_Baker_Error::BDF_ERROR_PARSING_CHARACTER_BYTES;
+            eat_until_next_line();
+        }
+
+        if (with_metrics) {
+            out_font->glyph_metrics[code_point - unicode_cp_start] = {
+                pfb__clamp_s16(advance), pfb__clamp_s16(bbx_x), pfb__clamp_s16(-(bbx_y + bbx_h)),
+                pfb__clamp_u16(bbx_w), pfb__clamp_u16(bbx_h)
+            };
+        }
+
+        u32 row_bytes = ((u32)bbx_w + 7) / 8;
+        if (row_bytes > row_buffer_size) {
+            pfb__deallocate(row_buffer, Pixel_Font_Allocation_Stage::SCRATCH);
+            row_buffer_size = (row_bytes + 7) & ~7u; // whole 8 byte chunks for the blit
+            row_buffer = (u8*)pfb__allocate(row_buffer_size, Pixel_Font_Allocation_Stage::SCRATCH);
+            if (!row_buffer)
+                return Pixel_Font_Baker_Error::MALLOC_FAILED;
+        }
+
+        // NOTE: Where the glyph box lands in the cell, rows from the top.
+        //   Pixels outside the cell are clipped.
+        s32 cell_x = bbx_x - start_x;
+        s32 cell_y = (start_y + font_size_y) - (bbx_y + bbx_h);
+        s32 col_begin = max(0, -cell_x);
+        s32 col_end   = min(bbx_w, font_size_x - cell_x);
+
+        memset(table_entry, 0, out_font->bytes_per_glyph);
+
+        // NOTE(Felix): We now have to read <bbx_h> many lines, made of
+        //   <row_bytes> bytes each. Each byte is represented by 2 hex-digits.
+        //   A glyph without columns has nothing to read, its empty lines are
+        //   already eaten as whitespace.
+        for (s32 row = 0; row < bbx_h && row_bytes > 0; ++row) {
+            if (cursor.length < 2 * (u64)row_bytes ||
+                !pfb__decode_hex(cursor.data, row_buffer, row_bytes))
+            {
+                return Pixel_Font_Baker_Error::BDF_ERROR_PARSING_CHARACTER_BYTES;
+            }
+            eat_until_next_line();
+
+            s32 y = cell_y + row;
+            if (y < 0 || y >= font_size_y || col_begin >= col_end)
+                continue;
+
+            // NOTE: The row goes in with word wide shifts and ORs, 64
+            //   columns at a time, the tail of the buffer is zeroed so the
+            //   last chunk can be loaded whole.
+            memset(row_buffer + row_bytes, 0, row_buffer_size - row_bytes);
+            u8* cell_row = table_entry + (u64)y * out_font->bytes_per_line;
+            for (s32 chunk = col_begin / 64; chunk * 64 < col_end; ++chunk) {
+                s32 c0 = chunk * 64;
+                pfb__blit_row_word(cell_row, out_font->bytes_per_line, cell_x + c0, row_buffer + chunk * 8, 8,
+                                   max(col_begin - c0, 0), min(col_end - c0, 64));
+            }
+        }
+    }
+
+    parsed = true;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+//
+//  Embedded bitmap strikes
+//
+// NOTE: Fonts for screens often carry hand tuned bitmaps for a few sizes
+//   (strikes) in EBLC (where the glyphs are) and EBDT (the bitmaps). CBLC/CBDT
+//   and Apple's bloc/bdat share that layout. Supported are the index formats
+//   1 to 5 and the image formats 1, 2, 5, 6 and 7 at 1, 2, 4 and 8 bits per
+//   pixel. Composite (8, 9) and PNG (17 to 19) images count as missing, so
+//   those glyphs are rasterized from the outlines instead.
+struct pfb__Ttf_Strike {
+    const u8* location;       // EBLC
+    u64       location_length;
+    const u8* data;           // EBDT
+    u64       data_length;
+    u32       subtables;      // offset of the index subtable array in location
+    u32       subtable_count;
+    s32       ascender;       // pixels above the baseline
+    s32       descender;      // pixels below, negative
+    u32       ppem;
+    u32       bit_depth;
+};
+
+// NOTE: image_length is checked to hold all rows. Rows of byte aligned images
+//   start on a byte, bit aligned images are one stream of width*height
+//   pixels.
+struct pfb__Strike_Glyph {
+    const u8* image;
+    u64       image_length;
+    u32       width;
+    u32       height;
+    s32       bearing_x;      // from the pen to the left edge
+    s32       bearing_y;      // from the baseline up to the top edge
+    u32       advance;
+    bool      bit_aligned;
+};
+
+static bool pfb__find_ttf_table(const u8* file, u64 file_length, u32 font_start, const char* tag,
+                                const u8** out_table, u64* out_length)
+{
+    if ((u64)font_start + 12 > file_length)
+        return false;
+    u32 table_count = pfb__read_be16(file + font_start + 4);
+    if ((u64)font_start + 12 + 16ull * table_count > file_length)
+        return false;
+
+    for (u32 i = 0; i < table_count; ++i) {
+        const u8* record = file + font_start + 12 + 16 * i;
+        if (memcmp(record, tag, 4) != 0)
+            continue;
+        u64 offset = pfb__read_be32(record + 8);
+        u64 length = pfb__read_be32(record + 12);
+        if (offset + length > file_length)
+            return false;
+        *out_table  = file + offset;
+        *out_length = length;
+        return true;
+    }
+    return false;
+}
+
+// NOTE: Picks the strike whose line height (ascender - descender) is
+//   char_height_in_px, or else whose ppem is, preferring 1 bit ones.
+static bool pfb__find_ttf_strike(const u8* file, u64 file_length, u32 font_start, u32 char_height_in_px,
+                                 pfb__Ttf_Strike* out_strike)
+{
+    const char* tags[][2] = { { "EBLC", "EBDT" }, { "CBLC", "CBDT" }, { "bloc", "bdat" } };
+
+    s32 best_score = 0;
+    for (auto& tag : tags) {
+        pfb__Ttf_Strike strike = {};
+        if (!pfb__find_ttf_table(file, file_length, font_start, tag[0], &strike.location, &strike.location_length) ||
+            !pfb__find_ttf_table(file, file_length, font_start, tag[1], &strike.data, &strike.data_length) ||
+            strike.location_length < 8)
+        {
+            continue;
+        }
+
+        u32 size_count = pfb__read_be32(strike.location + 4);
+        if (8 + 48ull * size_count > strike.location_length)
+            continue;
+
+        for (u32 i = 0; i < size_count; ++i) {
+            // NOTE: BitmapSize: index subtable array offset, size and count,
+            //   color ref, horizontal and vertical line metrics (12 bytes
+            //   each, ascender and descender first), start and end glyph,
+            //   ppem x and y, bit depth, flags.
+            const u8* size = strike.location + 8 + 48 * i;
+            u32 subtables      = pfb__read_be32(size);
+            u32 subtable_count = pfb__read_be32(size + 8);
+            s32 ascender       = (s8)size[16];
+            s32 descender      = (s8)size[17];
+            u32 ppem           = size[45];
+            u32 bit_depth      = size[46];
+
+            if ((bit_depth != 1 && bit_depth != 2 && bit_depth != 4 && bit_depth != 8) || subtable_count == 0 ||
+                (u64)subtables + 8ull * subtable_count > strike.location_length)
+            {
+                continue;
+            }
+
+            s32 score = ascender - descender == (s32)char_height_in_px ? 4 : ppem == char_height_in_px ? 2 : 0;
+            score += score && bit_depth == 1;
+            if (score <= best_score)
+                continue;
+
+            best_score = score;
+            *out_strike = strike;
+            out_strike->subtables      = subtables;
+            out_strike->subtable_count = subtable_count;
+            out_strike->ascender       = ascender;
+            out_strike->descender      = descender;
+            out_strike->ppem           = ppem;
+            out_strike->bit_depth      = bit_depth;
+        }
+    }
+
+    return best_score > 0;
+}
+
+// NOTE: Binary search in a sorted array of count big endian u16 glyph ids,
+//   stride bytes apart.
+static s64 pfb__find_glyph_id(const u8* ids, u32 count, u32 stride, u32 glyph) {
+    u32 low  = 0;
+    u32 high = count;
+    while (low < high) {
+        u32 mid = (low + high) / 2;
+        u32 id  = pfb__read_be16(ids + (u64)mid * stride);
+        if (id == glyph)
+            return mid;
+        if (id < glyph)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return -1;
+}
+
+// NOTE: Finds glyph in the strike, false if the strike does not have it (or
+//   only as a format that is not supported).
+static bool pfb__strike_glyph(const pfb__Ttf_Strike* strike, u32 glyph, pfb__Strike_Glyph* out_glyph) {
+    const u8* location = strike->location;
+    u64 location_length = strike->location_length;
+
+    for (u32 i = 0; i < strike->subtable_count; ++i) {
+        const u8* entry = location + strike->subtables + 8 * i;
+        u32 first = pfb__read_be16(entry);
+        u32 last  = pfb__read_be16(entry + 2);
+        if (glyph < first || glyph > last)
+            continue;
+
+        // NOTE: Index subtable header: index format, image format, offset
+        //   of the images in EBDT.
+        u64 header = (u64)strike->subtables + pfb__read_be32(entry + 4);
+        if (header + 8 > location_length)
+            return false;
+        u32 index_format = pfb__read_be16(location + header);
+        u32 image_format = pfb__read_be16(location + header + 2);
+        u64 image_base   = pfb__read_be32(location + header + 4);
+        const u8* body   = location + header + 8;
+        u64 body_length  = location_length - header - 8;
+
+        u64 image_offset;
+        u64 image_length;
+        const u8* big_metrics = nullptr;
+        switch (index_format) {
+            case 1:
+            case 3: {
+                u32 offset_size = index_format == 1 ? 4 : 2;
+                u64 n = glyph - first;
+                if ((n + 2) * offset_size > body_length)
+                    return false;
+                u64 begin = offset_size == 4 ? pfb__read_be32(body + n * 4) : pfb__read_be16(body + n * 2);
+                u64 end   = offset_size == 4 ? pfb__read_be32(body + n * 4 + 4) : pfb__read_be16(body + n * 2 + 2);
+                if (end <= begin)
+                    return false;
+                image_offset = begin;
+                image_length = end - begin;
+            } break;
+            case 2: {
+                if (body_length < 12)
+                    return false;
+                image_length = pfb__read_be32(body);
+                image_offset = (u64)(glyph - first) * image_length;
+                big_metrics  = body + 4;
+            } break;
+            case 4: {
+                if (body_length < 4)
+                    return false;
+                u32 count = pfb__read_be32(body);
+                if (4 + 4 * ((u64)count + 1) > body_length)
+                    return false;
+                s64 n = pfb__find_glyph_id(body + 4, count, 4, glyph);
+                if (n < 0)
+                    return false;
+                u64 begin = pfb__read_be16(body + 4 + 4 * n + 2);
+                u64 end   = pfb__read_be16(body + 4 + 4 * (n + 1) + 2);
+                if (end <= begin)
+                    return false;
+                image_offset = begin;
+                image_length = end - begin;
+            } break;
+            case 5: {
+                if (body_length < 16)
+                    return false;
+                image_length = pfb__read_be32(body);
+                big_metrics  = body + 4;
+                u32 count    = pfb__read_be32(body + 12);
+                if (16 + 2 * (u64)count > body_length)
+                    return false;
+                s64 n = pfb__find_glyph_id(body + 16, count, 2, glyph);
+                if (n < 0)
+                    return false;
+                image_offset = (u64)n * image_length;
+            } break;
+            default:
+                return false;
+        }
+
+        image_offset += image_base;
+        if (image_length == 0 || image_offset + image_length > strike->data_length)
+            return false;
+        const u8* image = strike->data + image_offset;
+
+        // NOTE: Small metrics are height, width, bearing x, bearing y and
+        //   advance, big metrics the same followed by the vertical ones.
+        //   Format 5 images take theirs from the index subtable.
+        const u8* metrics;
+        u32 metrics_length;
+        switch (image_format) {
+            case 1: case 2: metrics = image;       metrics_length = 5; break;
+            case 6: case 7: metrics = image;       metrics_length = 8; break;
+            case 5:         metrics = big_metrics; metrics_length = 0; break;
+            default:        return false;
+        }
+        if (!metrics || image_length < metrics_length)
+            return false;
+
+        pfb__Strike_Glyph g;
+        g.height       = metrics[0];
+        g.width        = metrics[1];
+        g.bearing_x    = (s8)metrics[2];
+        g.bearing_y    = (s8)metrics[3];
+        g.advance      = metrics[4];
+        g.bit_aligned  = image_format != 1 && image_format != 6;
+        g.image        = image + metrics_length;
+        g.image_length = image_length - metrics_length;
+
+        u64 bits = g.bit_aligned
+            ? (u64)g.width * g.height * strike->bit_depth
+            : ((u64)g.width * strike->bit_depth + 7) / 8 * 8 * g.height;
+        if ((bits + 7) / 8 > g.image_length)
+            return false;
+
+        *out_glyph = g;
+        return true;
+    }
+
+    return false;
+}
+
+// NOTE: Row y of a strike glyph as 1 bit pixels, MSB first. Byte aligned 1
+//   bit rows are returned in place, all others are converted into row (which
+//   needs 32 bytes, strike glyphs are at most 255 pixels wide). Deeper pixels
+//   are set when their value, scaled to 0..255, reaches gray_threashold.
+static const u8* pfb__strike_row(const pfb__Strike_Glyph* g, u32 bit_depth, u32 y, u8 gray_threashold, u8* row) {
+    if (!g->bit_aligned && bit_depth == 1)
+        return g->image + (u64)y * ((g->width + 7) / 8);
+
+    u64 row_bits = (u64)g->width * bit_depth;
+    u64 bit      = g->bit_aligned ? y * row_bits : y * ((row_bits + 7) / 8 * 8);
+    memset(row, 0, 32);
+
+    if (bit_depth == 1) {
+        u64 byte  = bit / 8;
+        u32 shift = bit % 8;
+        u64 last  = (bit + row_bits + 7) / 8; // one past the last byte holding the row
+        for (u32 i = 0; i * 8 < g->width; ++i, ++byte) {
+            u32 next = byte + 1 < last ? g->image[byte + 1] : 0;
+            row[i] = (u8)((g->image[byte] << shift) | (next >> (8 - shift)));
+        }
+        if (g->width % 8)
+            row[g->width / 8] &= (u8)(0xff00 >> (g->width % 8));
+        return row;
+    }
+
+    u32 max_value = (1u << bit_depth) - 1;
+    for (u32 x = 0; x < g->width; ++x, bit += bit_depth) {
+        u32 value = (g->image[bit / 8] >> (8 - bit_depth - bit % 8)) & max_value;
+        if (value * 255 / max_value >= gray_threashold)
+            row[x / 8] |= (u8)(0x80 >> (x % 8));
+    }
+    return row;
+}
+
+//
+//  Fixed point rasterizer
+//
+
+// NOTE: An integer only rasterizer for the threshold bake, for targets
+//   without an FPU where stb_truetype's float rasterizer runs in soft-float.
+//   The outline is scaled by a 32.32 fixed point scale into 24.8 pixel
+//   coordinates and its curves are flattened into the same polygon stb
+//   flattens them into (the flatness is decided from the font units, like
+//   stb does, not from the rounded points). Every pixel row is sampled at PFB__FIXED_SUBROWS
+//   rows, stepping the edges in 16.16, and along a sample row the spans are
+//   exact to 1/256 px. Where stb computes the exact area, this is off by at
+//   most about one sample row's worth (16 of 255) where an edge runs nearly
+//   horizontal or ends inside a pixel. So after thresholding a pixel can only
+//   differ from the float bake when stb's coverage is within 16 of the
+//   threshold, bench/fixed_raster_bench.cpp checks that.
+#define PFB__FIXED_SUBROWS          16
+#define PFB__FIXED_FULL             (256 * PFB__FIXED_SUBROWS) // coverage of a fully covered pixel
+#define PFB__FIXED_FLATNESS_SQUARED 526133494ll // (0.35 px)^2 with 32 fraction bits, how far a flattened curve may stray
+
+// NOTE: An edge of the flattened outline, top end first.
+struct pfb__Fixed_Edge {
+    s32 x0, y0;  // 24.8
+    s32 x1, y1;
+    s32 winding;
+    s32 x;       // at the current sample row, 16.16
+    s32 step;    // per sample row, 16.16
+};
+
+// NOTE: The bake's (oversampled) font_scale as 32.32 fixed point, from the
+//   font's integer metrics like stbtt_ScaleForPixelHeight and
+//   stbtt_ScaleForMappingEmToPixels compute it. 0 if the font's metrics are
+//   broken.
+static s64 pfb__fixed_font_scale(const stbtt_fontinfo* font, const pfb__Ttf_Strike* strike,
+                                 s32 char_height_in_px, s32 supersample)
+{
+    if (strike) {
+        const u8* head = font->data + font->head;
+        s32 units_per_em = head[18] << 8 | head[19];
+        return units_per_em ? ((s64)strike->ppem * supersample << 32) / units_per_em : 0;
+    }
+
+    s32 ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(font, &ascent, &descent, &line_gap);
+    return ascent != descent ? ((s64)char_height_in_px << 32) / (ascent - descent) : 0;
+}
+
+// NOTE: stbtt_GetGlyphBitmapBox with a fixed point scale: the scaled box
+//   with y pointing down, its top left rounded down and its bottom right up.
+static void pfb__fixed_glyph_box(const stbtt_fontinfo* font, s32 glyph, s64 scale,
+                                 s32* out_x0, s32* out_y0, s32* out_x1, s32* out_y1)
+{
+    s32 x0, y0, x1, y1;
+    if (!stbtt_GetGlyphBox(font, glyph, &x0, &y0, &x1, &y1)) {
+        *out_x0 = *out_y0 = *out_x1 = *out_y1 = 0;
+        return;
+    }
+
+    *out_x0 =  (s32)((x0 * scale) >> 32);
+    *out_y0 =  (s32)((-y1 * scale) >> 32);
+    *out_x1 = -(s32)((-x1 * scale) >> 32);
+    *out_y1 = -(s32)((y0 * scale) >> 32);
+}
+
+// NOTE: With edges == nullptr the edge is only counted.
+static void pfb__fixed_add_edge(pfb__Fixed_Edge* edges, u32* count, s32 x0, s32 y0, s32 x1, s32 y1) {
+    if (y0 == y1)
+        return;
+    if (edges) {
+        pfb__Fixed_Edge* e = edges + *count;
+        if (y0 < y1) *e = { x0, y0, x1, y1,  1, 0, 0 };
+        else         *e = { x1, y1, x0, y0, -1, 0, 0 };
+    }
+    ++*count;
+}
+
+// NOTE: How many segments (1 << shift) a quadratic needs to stay within
+//   PFB__FIXED_FLATNESS_SQUARED of its outline, given its second difference
+//   (dx, dy) in font units. A segment's midpoint strays a quarter of that
+//   from its chord, and halving the curve quarters it. stb_truetype halves
+//   quadratics the same way (up to 16 times), measuring in font units, so
+//   this measures from the font units too: the 24.8 points are rounded by
+//   up to 1/512 px, enough to tip curves near the limit the other way and
+//   leave a segment 0.35 px off stb's. Both bends are truncated towards 0,
+//   flooring the negative one would tip a curve sitting exactly at the
+//   limit into another halving, which stb does not do. Bends are clamped
+//   to 16384 px.
+static s32 pfb__fixed_curve_shift(s32 dx, s32 dy, s64 scale) {
+    s64 x = min(abs(dx * scale) >> 16, (s64)1 << 30); // 16.16 px
+    s64 y = min(abs(dy * scale) >> 16, (s64)1 << 30);
+    s64 stray_squared = (x*x + y*y) >> 4;
+    s32 shift = 0;
+    for (; shift < 16 && stray_squared > PFB__FIXED_FLATNESS_SQUARED; ++shift)
+        stray_squared >>= 4;
+    return shift;
+}
+
+static u64 pfb__isqrt(u64 value) {
+    u64 root = 0;
+    u64 bit  = 1ull << 62;
+    while (bit > value)
+        bit >>= 2;
+    for (; bit; bit >>= 2) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
+
+// NOTE: Cubics are halved until their control polygon is hardly longer than
+//   their chord, the way stb_truetype does it (up to 16 times). The points
+//   have 20 fraction bits here, taken straight from the font units, so
+//   the halving does not round away the curve and curves near the limit
+//   split like stb's. Edges end at the floor of the points, as in to_x, so
+//   they meet the neighbouring edges. Control polygons over 2048 px are
+//   always halved, their squared length would not fit.
+static void pfb__fixed_flatten_cubic(pfb__Fixed_Edge* edges, u32* count, s64 x0, s64 y0, s64 x1, s64 y1,
+                                     s64 x2, s64 y2, s64 x3, s64 y3, s32 depth)
+{
+    auto length = [](s64 dx, s64 dy) {
+        s32 shift = 0;
+        while (abs(dx) >> shift >= (s64)1 << 30 || abs(dy) >> shift >= (s64)1 << 30)
+            ++shift;
+        dx >>= shift;
+        dy >>= shift;
+        return (s64)pfb__isqrt((u64)(dx*dx + dy*dy)) << shift;
+    };
+    s64 long_length  = length(x1 - x0, y1 - y0) + length(x2 - x1, y2 - y1) + length(x3 - x2, y3 - y2);
+    s64 short_length = length(x3 - x0, y3 - y0);
+
+    if (depth >= 16 || (long_length < (s64)1 << 31 &&
+                        long_length*long_length - short_length*short_length <= PFB__FIXED_FLATNESS_SQUARED << 8)) {
+        pfb__fixed_add_edge(edges, count, (s32)(x0 >> 12), (s32)(y0 >> 12), (s32)(x3 >> 12), (s32)(y3 >> 12));
+        return;
+    }
+
+    s64 x01 = (x0 + x1) >> 1, y01 = (y0 + y1) >> 1;
+    s64 x12 = (x1 + x2) >> 1, y12 = (y1 + y2) >> 1;
+    s64 x23 = (x2 + x3) >> 1, y23 = (y2 + y3) >> 1;
+    s64 xa  = (x01 + x12) >> 1, ya = (y01 + y12) >> 1;
+    s64 xb  = (x12 + x23) >> 1, yb = (y12 + y23) >> 1;
+    s64 mx  = (xa + xb) >> 1,   my = (ya + yb) >> 1;
+    pfb__fixed_flatten_cubic(edges, count, x0, y0, x01, y01, xa, ya, mx, my, depth + 1);
+    pfb__fixed_flatten_cubic(edges, count, mx, my, xb, yb, x23, y23, x3, y3, depth + 1);
+}
+
+// NOTE: Turns the outline into edges in 24.8 bitmap coordinates, closing
+//   every contour. Returns the number of edges, with edges == nullptr only
+//   counts them. Points on quadratics are evaluated directly from the
+//   Bernstein form, so no error accumulates along a curve.
+static u32 pfb__fixed_flatten(const stbtt_vertex* vertices, s32 vertex_count, s64 scale,
+                              s32 x_origin, s32 y_origin, pfb__Fixed_Edge* edges)
+{
+    auto to_x = [&](s32 v) { return (s32)((v * scale) >> 24) - x_origin * 256; };
+    auto to_y = [&](s32 v) { return (s32)((-v * scale) >> 24) - y_origin * 256; };
+
+    u32 count   = 0;
+    s32 start_x = 0, start_y = 0;
+    s32 x = 0, y = 0;
+    s32 font_x = 0, font_y = 0; // (x, y) in font units
+    for (s32 i = 0; i < vertex_count; ++i) {
+        const stbtt_vertex* v = vertices + i;
+        s32 vx = to_x(v->x);
+        s32 vy = to_y(v->y);
+
+        switch (v->type) {
+        case STBTT_vmove: {
+            pfb__fixed_add_edge(edges, &count, x, y, start_x, start_y);
+            start_x = vx;
+            start_y = vy;
+        } break;
+        case STBTT_vline: {
+            pfb__fixed_add_edge(edges, &count, x, y, vx, vy);
+        } break;
+        case STBTT_vcurve: {
+            s32 cx = to_x(v->cx);
+            s32 cy = to_y(v->cy);
+            s32 shift = pfb__fixed_curve_shift(font_x - 2*v->cx + v->x, font_y - 2*v->cy + v->y, scale);
+            s64 n     = (s64)1 << shift;
+            s64 half  = n*n / 2;
+            s32 px = x, py = y;
+            for (s64 t = 1; t <= n; ++t) {
+                s64 u  = n - t;
+                s32 qx = (s32)((u*u*x + 2*t*u*cx + t*t*vx + half) >> 2*shift);
+                s32 qy = (s32)((u*u*y + 2*t*u*cy + t*t*vy + half) >> 2*shift);
+                pfb__fixed_add_edge(edges, &count, px, py, qx, qy);
+                px = qx;
+                py = qy;
+            }
+        } break;
+        case STBTT_vcubic: {
+            auto fine_x = [&](s32 v) { return ((v * scale) >> 12) - ((s64)x_origin << 20); };
+            auto fine_y = [&](s32 v) { return ((-v * scale) >> 12) - ((s64)y_origin << 20); };
+            pfb__fixed_flatten_cubic(edges, &count, fine_x(font_x), fine_y(font_y), fine_x(v->cx), fine_y(v->cy),
+                                     fine_x(v->cx1), fine_y(v->cy1), fine_x(v->x), fine_y(v->y), 0);
+        } break;
+        }
+
+        x      = vx;
+        y      = vy;
+        font_x = v->x;
+        font_y = v->y;
+    }
+    pfb__fixed_add_edge(edges, &count, x, y, start_x, start_y);
+
+    return count;
+}
+
+// NOTE: Adds the span [x0, x1) (24.8) of one sample row, weighted by its
+//   winding number. Whole pixels go into full as a difference (+256 where
+//   they start, -256 past the end), which is summed up once per pixel row.
+static void pfb__fixed_add_span(s32* coverage, s32* full, s32 x0, s32 x1, s32 winding, s32 right) {
+    x0 = max(x0, 0);
+    x1 = min(x1, right);
+    if (x0 >= x1)
+        return;
+
+    s32 p0 = x0 >> 8;
+    s32 p1 = x1 >> 8;
+    if (p0 == p1) {
+        coverage[p0] += winding * (x1 - x0);
+        return;
+    }
+    coverage[p0] += winding * (256 - (x0 & 255));
+    full[p0 + 1] += winding * 256;
+    full[p1]     -= winding * 256;
+    coverage[p1] += winding * (x1 & 255);
+}
+
+// NOTE: The state of a glyph being rasterized by pfb__fixed_raster_rows,
+//   which continues where the last call stopped, so a glyph can be rendered
+//   a strip of rows at a time.
+struct pfb__Fixed_Raster {
+    u8*               memory;
+    pfb__Fixed_Edge** active;
+    pfb__Fixed_Edge*  edges;
+    s32*              coverage;
+    s32*              full;
+    u32               edge_count;
+    u32               next;         // first edge not active yet
+    u32               active_count;
+    s32               width;
+    s32               row;          // next row to be rasterized
+};
+
+// NOTE: Flattens the outline (from stbtt_GetGlyphShape) with row 0 and
+//   column 0 of the bitmap at (x_origin, y_origin) of the scaled outline.
+//   Returns false if the edges could not be allocated.
+static bool pfb__fixed_raster_begin(const stbtt_vertex* vertices, s32 vertex_count, s64 scale,
+                                    s32 x_origin, s32 y_origin, s32 width, pfb__Fixed_Raster* out_raster)
+{
+    *out_raster = {};
+    out_raster->width = width;
+
+    u32 edge_count = pfb__fixed_flatten(vertices, vertex_count, scale, x_origin, y_origin, nullptr);
+    if (edge_count == 0 || width <= 0)
+        return true;
+
+    // NOTE: The active edges (pointers first, for their alignment), the edges
+    //   and the coverage and full pixel differences of one pixel row.
+    u64 memory_size = (u64)edge_count * (sizeof(pfb__Fixed_Edge*) + sizeof(pfb__Fixed_Edge))
+        + 2 * ((u64)width + 1) * sizeof(s32);
+    u8* memory = (u8*)pfb__allocate(memory_size, Pixel_Font_Allocation_Stage::RASTERIZE);
+    if (!memory)
+        return false;
+
+    pfb__Fixed_Edge** active = (pfb__Fixed_Edge**)memory;
+    pfb__Fixed_Edge*  edges  = (pfb__Fixed_Edge*)(active + edge_count);
+    pfb__fixed_flatten(vertices, vertex_count, scale, x_origin, y_origin, edges);
+
+    // NOTE: Sorted by their top. A glyph has a few dozen edges, which insertion
+    //   sort handles faster than qsort's calls through a function pointer.
+    for (u32 i = 1; i < edge_count; ++i) {
+        pfb__Fixed_Edge e = edges[i];
+        u32 j = i;
+        for (; j > 0 && edges[j - 1].y0 > e.y0; --j)
+            edges[j] = edges[j - 1];
+        edges[j] = e;
+    }
+
+    out_raster->memory     = memory;
+    out_raster->active     = active;
+    out_raster->edges      = edges;
+    out_raster->coverage   = (s32*)(edges + edge_count);
+    out_raster->full       = out_raster->coverage + width + 1;
+    out_raster->edge_count = edge_count;
+    return true;
+}
+
+static void pfb__fixed_raster_end(pfb__Fixed_Raster* raster) {
+    pfb__deallocate(raster->memory, Pixel_Font_Allocation_Stage::RASTERIZE);
+    raster->memory = nullptr;
+}
+
+// NOTE: Renders the next row_count rows into bitmap (rows of stride bytes).
+//   Like stb_truetype, a pixel's coverage is the area it shares with the
+//   outline weighted by winding number, so overlapping contours add up (and
+//   are clamped) and contours of opposite direction cancel. Rows below the
+//   outline are left alone.
+static void pfb__fixed_raster_rows(pfb__Fixed_Raster* raster, u8* bitmap, s32 row_count, s32 stride) {
+    pfb__Fixed_Edge** active   = raster->active;
+    pfb__Fixed_Edge*  edges    = raster->edges;
+    s32*              coverage = raster->coverage;
+    s32*              full     = raster->full;
+    s32               width    = raster->width;
+    s32               right    = width << 8;
+    s32               first    = raster->row;
+    raster->row += row_count;
+
+    for (s32 row = first; row < first + row_count; ++row) {
+        if (raster->next == raster->edge_count && raster->active_count == 0)
+            break;
+
+        memset(coverage, 0, 2 * ((u64)width + 1) * sizeof(s32));
+
+        for (s32 sub = 0; sub < PFB__FIXED_SUBROWS; ++sub) {
+            s32 y = (row << 8) + sub * (256 / PFB__FIXED_SUBROWS) + 128 / PFB__FIXED_SUBROWS;
+
+            // NOTE: Step the edges still crossing this sample row, drop the
+            //   others and add the ones that start above it.
+            u32 kept = 0;
+            for (u32 i = 0; i < raster->active_count; ++i) {
+                pfb__Fixed_Edge* e = active[i];
+                if (e->y1 <= y)
+                    continue;
+                e->x += e->step;
+                active[kept++] = e;
+            }
+            raster->active_count = kept;
+
+            for (; raster->next < raster->edge_count && edges[raster->next].y0 <= y; ++raster->next) {
+                pfb__Fixed_Edge* e = edges + raster->next;
+                if (e->y1 <= y)
+                    continue;
+                s64 dx = e->x1 - e->x0;
+                s64 dy = e->y1 - e->y0;
+                e->x    = (s32)((s64)e->x0 * 256 + (s64)(y - e->y0) * dx * 256 / dy);
+                e->step = (s32)(dx * (256 / PFB__FIXED_SUBROWS) * 256 / dy);
+                active[raster->active_count++] = e;
+            }
+
+            // NOTE: Stepping keeps the edges almost sorted by x, so insertion
+            //   sort does next to no work.
+            for (u32 i = 1; i < raster->active_count; ++i) {
+                pfb__Fixed_Edge* e = active[i];
+                u32 j = i;
+                for (; j > 0 && active[j - 1]->x > e->x; --j)
+                    active[j] = active[j - 1];
+                active[j] = e;
+            }
+
+            s32 winding = 0;
+            for (u32 i = 0; i < raster->active_count; ++i) {
+                if (winding)
+                    pfb__fixed_add_span(coverage, full, active[i - 1]->x >> 8, active[i]->x >> 8, winding, right);
+                winding += active[i]->winding;
+            }
+        }
+
+        u8* out = bitmap + (u64)(row - first) * stride;
+        s32 run = 0;
+        for (s32 x = 0; x < width; ++x) {
+            run += full[x];
+            s32 c = abs(coverage[x] + run);
+            out[x] = (u8)min(255, (c * 255 + PFB__FIXED_FULL / 2) / PFB__FIXED_FULL);
+        }
+    }
+}
+
+// NOTE: Renders an outline (from stbtt_GetGlyphShape) into the gray bitmap
+//   (width*height, rows of stride bytes) like stbtt_MakeGlyphBitmap does,
+//   with the bitmap's top left at (x_origin, y_origin) of the scaled outline.
+//   Uses no floating point. Returns false if the edges could not be
+//   allocated, the bitmap is left alone then.
+static bool pfb__rasterize_fixed(const stbtt_vertex* vertices, s32 vertex_count, s64 scale,
+                                 s32 x_origin, s32 y_origin, u8* bitmap, s32 width, s32 height, s32 stride)
+{
+    pfb__Fixed_Raster raster;
+    if (!pfb__fixed_raster_begin(vertices, vertex_count, scale, x_origin, y_origin, width, &raster))
+        return false;
+    pfb__fixed_raster_rows(&raster, bitmap, height, stride);
+    pfb__fixed_raster_end(&raster);
+    return true;
+}
+
+static inline void pfb__box_prefilter_line(u8* p, s32 count, s32 step, s32 kernel) {
+    u8 history[256];
+    memset(history, 0, (u64)kernel);
+    u32 total = 0;
+    for (s32 i = 0; i < count; ++i) {
+        u8 value = p[(u64)i * step];
+        total   += value;
+        total   -= history[i % kernel];
+        history[i % kernel] = value;
+        p[(u64)i * step]    = (u8)(total / (u32)kernel);
+    }
+}
+
+// NOTE: stb_truetype's oversampling prefilter with integers: every one of
+//   the count pixels (step bytes apart) of each of the lines becomes the
+//   average of itself and the kernel - 1 pixels before it. Run along the
+//   rows and then along the columns it gives what
+//   stbtt_MakeGlyphBitmapSubpixelPrefilter gives. Like stb's, the common
+//   kernels get their own loop so the divisions are by a constant.
+static void pfb__box_prefilter(u8* pixels, s32 count, s32 step, s32 lines, s32 line_step, s32 kernel) {
+    for (s32 line = 0; line < lines; ++line) {
+        u8* p = pixels + (u64)line * line_step;
+        switch (kernel) {
+            case 2:  pfb__box_prefilter_line(p, count, step, 2);      break;
+            case 3:  pfb__box_prefilter_line(p, count, step, 3);      break;
+            case 4:  pfb__box_prefilter_line(p, count, step, 4);      break;
+            default: pfb__box_prefilter_line(p, count, step, kernel); break;
+        }
+    }
+}
+
+// NOTE: The ttf bake is split into two stages: rasterize (outline
+//   decode + stb rasterizer into an oversampled gray bitmap) and pack
+//   (threshold into the 1-bpp table). Without worker threads both stages run
+//   back to back on the calling thread, otherwise every rasterizer thread
+//   feeds its own bounded single-producer/single-consumer ring and the caller
+//   packs the glyphs in codepoint order.
+struct pfb__Ttf_Baker {
+    stbtt_fontinfo font;
+    f32 font_scale;
+    s32 char_width_in_px;  // oversampled
+    s32 char_height_in_px; // oversampled
+    s32 ascend;
+    s32 supersample;
+    s64 fixed_scale; // font_scale in 32.32 for pfb__rasterize_fixed, 0 to rasterize with stb_truetype
+    s32 strip_rows;  // oversampled rows rasterized at a time, 0 rasterizes whole glyphs
+    u8  gray_threashold;
+    const pfb__Ttf_Strike* strike; // nullptr if the font has none of the requested height
+    Pixel_Font_Glyph_Metrics* glyph_metrics; // nullptr unless asked for, indexed by cp - unicode_cp_start
+    Pixel_Font* out_font;
+    f64 bake_start;
+};
+
+// NOTE: Every ring slot starts with this header, followed by the gray
+//   bitmap of char_width_in_px*char_height_in_px bytes, or by the packed
+//   glyph (bytes_per_glyph) when rasterizing in strips.
+struct pfb__Raster_Slot {
+    u32 code_point;
+    s32 x_offset;
+    s32 y_offset;
+    u32 strike_glyph; // glyph index + 1 if the glyph is copied from the strike, 0 if rasterized
+};
+
+struct pfb__Spsc_Ring {
+    u8* slots;
+    u32 slot_size;
+    u32 capacity;
+    alignas(64) std::atomic<u32> head; // only written by the producer
+    alignas(64) std::atomic<u32> tail; // only written by the consumer
+};
+
+// NOTE: A rasterizer thread and the stats only it writes, on their own cache
+//   line.
+struct pfb__Raster_Worker {
+    alignas(64) std::thread thread;
+    Pixel_Font_Bake_Stage_Stats stats;
+};
+
+static f64 pfb__seconds_now() {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static u8* pfb__ring_begin_push(pfb__Spsc_Ring* ring) {
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) == ring->capacity)
+        return nullptr;
+    return ring->slots + (u64)(head % ring->capacity) * ring->slot_size;
+}
+
+static void pfb__ring_end_push(pfb__Spsc_Ring* ring) {
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+static u8* pfb__ring_begin_pop(pfb__Spsc_Ring* ring) {
+    u32 tail = ring->tail.load(std::memory_order_relaxed);
+    if (ring->head.load(std::memory_order_acquire) == tail)
+        return nullptr;
+    return ring->slots + (u64)(tail % ring->capacity) * ring->slot_size;
+}
+
+static void pfb__ring_end_pop(pfb__Spsc_Ring* ring) {
+    ring->tail.store(ring->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// NOTE: The file stays in memory as font->data until pfb__free_ttf.
+static Pixel_Font_Baker_Error pfb__read_ttf(const char* font_path, stbtt_fontinfo* font,
+                                            u64* out_file_length = nullptr)
+{
+    pfb__File_Contents ttf;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_font_file(font_path, &ttf);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    if (out_file_length)
+        *out_file_length = ttf.length;
+
+    u8* ttf_buffer = (u8*)ttf.data;
+    s32 offset     = stbtt_GetFontOffsetForIndex(ttf_buffer, 0);
+    if (offset < 0 || stbtt_InitFont(font, ttf_buffer, offset) == 0) {
+        pfb__deallocate(ttf_buffer, Pixel_Font_Allocation_Stage::FONT_FILE);
+        return Pixel_Font_Baker_Error::STB_TRUETYPE_FAILED;
+    }
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+static void pfb__free_ttf(stbtt_fontinfo* font) {
+    pfb__deallocate(font->data, Pixel_Font_Allocation_Stage::FONT_FILE);
+}
+
+// NOTE: The cell is as wide as the advance of 'W' and the baseline sits
+//   ascend pixels below its top edge.
+static void pfb__ttf_cell_size(const stbtt_fontinfo* font, s32 char_height_in_px,
+                               f32* out_scale, s32* out_char_width_in_px, s32* out_ascend)
+{
+    f32 font_scale = stbtt_ScaleForPixelHeight(font, (f32)char_height_in_px);
+
+    s32 char_width_in_px;
+    stbtt_GetCodepointHMetrics(font, 'W', &char_width_in_px, nullptr);
+    char_width_in_px = (s32)ceil(char_width_in_px*font_scale);
+
+    s32 ascend;
+    s32 descend;
+    s32 line_gap;
+    stbtt_GetFontVMetrics(font, &ascend, &descend, &line_gap);
+    ascend = (int)(ascend*font_scale +.5f);
+
+    *out_scale            = font_scale;
+    *out_char_width_in_px = char_width_in_px;
+    *out_ascend           = ascend;
+}
+
+// NOTE: pfb__ttf_cell_size for a bake from a strike: the cell is as wide as
+//   the advance of the strike's 'W' (the outline's, scaled to the strike's
+//   em, if the strike has none), the baseline sits at the strike's ascender,
+//   and font_scale maps the em to the strike's ppem for the glyphs that are
+//   rasterized.
+static void pfb__strike_cell_size(const stbtt_fontinfo* font, const pfb__Ttf_Strike* strike,
+                                  f32* out_scale, s32* out_char_width_in_px, s32* out_ascend)
+{
+    f32 font_scale = stbtt_ScaleForMappingEmToPixels(font, (f32)strike->ppem);
+
+    s32 char_width_in_px;
+    pfb__Strike_Glyph w;
+    if (pfb__strike_glyph(strike, stbtt_FindGlyphIndex(font, 'W'), &w) && w.advance > 0) {
+        char_width_in_px = w.advance;
+    } else {
+        stbtt_GetCodepointHMetrics(font, 'W', &char_width_in_px, nullptr);
+        char_width_in_px = (s32)ceil(char_width_in_px*font_scale);
+    }
+
+    *out_scale            = font_scale;
+    *out_char_width_in_px = char_width_in_px;
+    *out_ascend           = strike->ascender;
+}
+
+// NOTE: The metrics of a rasterized glyph come from its horizontal metrics
+//   and box at the final (not oversampled) scale, not from the thresholded
+//   pixels.
+static void pfb__measure_glyph(const pfb__Ttf_Baker* baker, u32 cp) {
+    s32 advance;
+    stbtt_GetCodepointHMetrics(&baker->font, (s32)cp, &advance, nullptr);
+
+    s32 x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    if (baker->fixed_scale) {
+        s64 scale = baker->fixed_scale / baker->supersample;
+        pfb__fixed_glyph_box(&baker->font, stbtt_FindGlyphIndex(&baker->font, (s32)cp), scale, &x0, &y0, &x1, &y1);
+        advance = (s32)((advance * scale + (1ll << 31)) >> 32);
+    } else {
+        f32 scale = baker->font_scale / baker->supersample;
+        stbtt_GetCodepointBitmapBox(&baker->font, (s32)cp, scale, scale, &x0, &y0, &x1, &y1);
+        advance = (s32)roundf(advance * scale);
+    }
+
+    baker->glyph_metrics[cp - baker->out_font->unicode_cp_start] = {
+        pfb__clamp_s16(advance), pfb__clamp_s16(x0), pfb__clamp_s16(y0),
+        pfb__clamp_u16(x1 - x0), pfb__clamp_u16(y1 - y0)
+    };
+}
+
+static s32 pfb__ceil_div(s32 a, s32 b) {
+    return a >= 0 ? (a + b - 1) / b : -(-a / b);
+}
+
+// NOTE: Bitmap column (or row) of the oversampled pixel at which cell
+//   column (or row) 0 is sampled. Cell pixel x covers the oversampled cell
+//   pixels s*x to s*x + s - 1, and the box prefilter leaves the average of
+//   s pixels in the last of them. The bitmap starts offset oversampled
+//   pixels into the cell (x_offset, or ascend + y_offset for rows).
+static s32 pfb__first_sample(s32 s, s32 offset) {
+    return s - 1 - offset;
+}
+
+// NOTE: Cell pixel (x, y) samples the oversampled bitmap at
+//   (s*x + x_first, s*y + y_first), see pfb__first_sample. Packs the cell rows
+//   that sample a bitmap row in [row_begin, row_end), rows points at bitmap
+//   row row_begin. Pixels that would sample outside of the bitmap are
+//   clipped instead of walking the read pointer into the neighbouring row
+//   (or glyph).
+static void pfb__pack_rows(const pfb__Ttf_Baker* baker, const pfb__Raster_Slot* slot,
+                           const u8* rows, s32 row_begin, s32 row_end, u8* glyph)
+{
+    Pixel_Font* font = baker->out_font;
+    s32 s = baker->supersample;
+
+    s32 x_first = pfb__first_sample(s, slot->x_offset);
+    s32 y_first = pfb__first_sample(s, baker->ascend + slot->y_offset);
+
+    s32 x_begin = max(0, pfb__ceil_div(-x_first, s));
+    s32 y_begin = max(0, pfb__ceil_div(row_begin - y_first, s));
+    s32 x_end   = min((s32)font->char_px_width,  pfb__ceil_div(baker->char_width_in_px - x_first, s));
+    s32 y_end   = min((s32)font->char_px_height, pfb__ceil_div(row_end - y_first, s));
+
+    if (x_begin >= x_end)
+        return;
+
+    for (s32 y = y_begin; y < y_end; ++y) {
+        const u8* src = rows + baker->char_width_in_px*(s*y + y_first - row_begin) + s*x_begin + x_first;
+        u8*       row = glyph + y*font->bytes_per_line;
+        pfb__threshold_pack(src, s, x_end - x_begin, baker->gray_threashold, row, x_begin);
+    }
+}
+
+#if defined(STB_TRUETYPE_IMPLEMENTATION) && STBTT_RASTERIZER_VERSION == 2
+// NOTE: The edges stbtt_Rasterize builds for an outline, sorted by their top,
+//   plus room for the sentinel. out_strip_edges gets as many again for the
+//   edges of one strip, see pfb__rasterize_strip_edges.
+static stbtt__edge* pfb__stb_edges(stbtt_vertex* vertices, s32 vertex_count, f32 scale, void* userdata,
+                                   s32* out_count, stbtt__edge** out_strip_edges)
+{
+    *out_count       = 0;
+    *out_strip_edges = nullptr;
+
+    s32  winding_count   = 0;
+    s32* winding_lengths = nullptr;
+    stbtt__point* windings = stbtt_FlattenCurves(vertices, vertex_count, 0.35f / scale, &winding_lengths,
+                                                 &winding_count, userdata);
+    if (!windings)
+        return nullptr;
+    defer {
+        STBTT_free(winding_lengths, userdata);
+        STBTT_free(windings, userdata);
+    };
+
+    s32 point_count = 0;
+    for (s32 i = 0; i < winding_count; ++i)
+        point_count += winding_lengths[i];
+
+    stbtt__edge* edges = (stbtt__edge*)STBTT_malloc(sizeof(stbtt__edge) * 2 * (point_count + 1), userdata);
+    if (!edges)
+        return nullptr;
+
+    // NOTE: Like stbtt__rasterize, inverted (y down), one vertical sample.
+    s32 n = 0;
+    const stbtt__point* p = windings;
+    for (s32 i = 0; i < winding_count; p += winding_lengths[i++]) {
+        for (s32 k = 0, j = winding_lengths[i] - 1; k < winding_lengths[i]; j = k++) {
+            if (p[j].y == p[k].y)
+                continue;
+            s32 a = k, b = j;
+            edges[n].invert = 0;
+            if (p[j].y > p[k].y) {
+                edges[n].invert = 1;
+                a = j, b = k;
+            }
+            edges[n].x0 =  p[a].x * scale;
+            edges[n].y0 = -p[a].y * scale;
+            edges[n].x1 =  p[b].x * scale;
+            edges[n].y1 = -p[b].y * scale;
+            ++n;
+        }
+    }
+    stbtt__sort_edges(edges, n);
+
+    *out_count       = n;
+    *out_strip_edges = edges + point_count + 1;
+    return edges;
+}
+
+// NOTE: stbtt_Rasterize into a strip whose top is at y_off. stb clamps every
+//   edge that ends above the bitmap into its first row, where it covers
+//   nothing but still walks the whole row, so those edges are left out. The
+//   pixels are the same as stbtt_Rasterize's.
+static void pfb__rasterize_strip_edges(stbtt__bitmap* bitmap, const stbtt__edge* edges, s32 edge_count,
+                                       stbtt__edge* strip_edges, s32 x_off, s32 y_off, void* userdata)
+{
+    s32 n = 0;
+    for (s32 i = 0; i < edge_count; ++i) {
+        if (edges[i].y1 > (f32)y_off)
+            strip_edges[n++] = edges[i];
+    }
+    stbtt__rasterize_sorted_edges(bitmap, strip_edges, n, 1, x_off, y_off, userdata);
+}
+#endif
+
+// NOTE: Rasterizes a glyph strip_rows oversampled rows at a time into
+//   strip_memory and packs every strip into glyph before the next one, so a
+//   large glyph never needs its whole gray bitmap. Filtering and sampling are
+//   the same as for a whole glyph: the vertical prefilter of a strip's first
+//   rows needs the s - 1 rows above them, so those are carried over (before
+//   their vertical filtering) on top of the next strip. Rows below the last
+//   one the pack samples are not rasterized at all.
+static void pfb__rasterize_strips(const pfb__Ttf_Baker* baker, u32 cp, pfb__Raster_Slot* slot,
+                                  u8* strip_memory, u8* glyph)
+{
+    s32 s       = baker->supersample;
+    s32 w       = baker->char_width_in_px;
+    s32 h       = baker->char_height_in_px;
+    s32 history = s - 1;
+    u8* strip   = strip_memory;                                            // history rows, then strip_rows + 1 rows
+    u8* carried = strip_memory + (u64)(history + baker->strip_rows + 1) * w; // history rows
+    u8* rows    = strip + (u64)history * w;
+
+    memset(glyph, 0, baker->out_font->bytes_per_glyph);
+
+    s32 glyph_index = stbtt_FindGlyphIndex(&baker->font, (s32)cp);
+    stbtt_vertex* vertices = nullptr;
+    s32 vertex_count = stbtt_GetGlyphShape(&baker->font, glyph_index, &vertices);
+    defer {
+        if (vertices)
+            stbtt_FreeShape(&baker->font, vertices);
+    };
+
+    pfb__Fixed_Raster fixed = {};
+    defer { pfb__fixed_raster_end(&fixed); };
+    if (baker->fixed_scale) {
+        s32 x1, y1;
+        pfb__fixed_glyph_box(&baker->font, glyph_index, baker->fixed_scale, &slot->x_offset, &slot->y_offset, &x1, &y1);
+        if (!pfb__fixed_raster_begin(vertices, vertex_count, baker->fixed_scale, slot->x_offset, slot->y_offset,
+                                     w - history, &fixed))
+            return;
+    } else {
+        stbtt_GetGlyphBitmapBox(&baker->font, glyph_index, baker->font_scale, baker->font_scale,
+                                &slot->x_offset, &slot->y_offset, nullptr, nullptr);
+    }
+
+#if defined(STB_TRUETYPE_IMPLEMENTATION) && STBTT_RASTERIZER_VERSION == 2
+    s32          edge_count  = 0;
+    stbtt__edge* strip_edges = nullptr;
+    stbtt__edge* edges       = nullptr;
+    if (!baker->fixed_scale && vertex_count > 0) {
+        edges = pfb__stb_edges(vertices, vertex_count, baker->font_scale, baker->font.userdata,
+                               &edge_count, &strip_edges);
+    }
+    defer {
+        if (edges)
+            STBTT_free(edges, baker->font.userdata);
+    };
+#endif
+
+    s32 y_first   = pfb__first_sample(s, baker->ascend + slot->y_offset);
+    s32 row_limit = min(h, s*((s32)baker->out_font->char_px_height - 1) + y_first + 1);
+
+    memset(strip, 0, (u64)history * w);
+    for (s32 row = 0, row_count; row < row_limit; row += row_count) {
+        row_count = min(baker->strip_rows, row_limit - row);
+
+        // NOTE: stbtt_Rasterize only clips the edges that end above the bitmap
+        //   when the bitmap's top is not at y 0 of the outline, so no strip
+        //   may start there.
+        if (row + row_count == -slot->y_offset && row + row_count < row_limit)
+            ++row_count;
+
+        memset(rows, 0, (u64)row_count * w);
+
+        // NOTE: Like stbtt_MakeGlyphBitmapSubpixelPrefilter, the outline is
+        //   rasterized into the bitmap minus the prefilter's tail.
+        s32 raster_rows = min(row_count, h - history - row);
+        if (raster_rows > 0 && w - history > 0) {
+            if (baker->fixed_scale) {
+                pfb__fixed_raster_rows(&fixed, rows, raster_rows, w);
+            } else {
+                stbtt__bitmap bitmap = { w - history, raster_rows, w, rows };
+#if defined(STB_TRUETYPE_IMPLEMENTATION) && STBTT_RASTERIZER_VERSION == 2
+                if (edges) {
+                    pfb__rasterize_strip_edges(&bitmap, edges, edge_count, strip_edges,
+                                               slot->x_offset, slot->y_offset + row, baker->font.userdata);
+                }
+#else
+                stbtt_Rasterize(&bitmap, 0.35f, vertices, vertex_count, baker->font_scale, baker->font_scale,
+                                0, 0, slot->x_offset, slot->y_offset + row, 1, baker->font.userdata);
+#endif
+            }
+        }
+
+        if (history) {
+            pfb__box_prefilter(rows, w, 1, row_count, w, s);
+            memcpy(carried, strip + (u64)row_count * w, (u64)history * w);
+            pfb__box_prefilter(strip, history + row_count, w, w, 1, s);
+        }
+        pfb__pack_rows(baker, slot, rows, row, row + row_count, glyph);
+        if (history)
+            memcpy(strip, carried, (u64)history * w);
+    }
+}
+
+// NOTE: bitmap gets the gray bitmap, or the packed glyph when rasterizing in
+//   strips, which then use strip_memory.
+static void pfb__rasterize_glyph(const pfb__Ttf_Baker* baker, u32 cp, pfb__Raster_Slot* slot,
+                                 u8* bitmap, u8* strip_memory)
+{
+    slot->code_point   = cp;
+    slot->strike_glyph = 0;
+
+    // NOTE: Glyphs of the strike are copied by the pack stage.
+    if (baker->strike) {
+        u32 glyph = (u32)stbtt_FindGlyphIndex(&baker->font, (s32)cp);
+        pfb__Strike_Glyph g;
+        if (pfb__strike_glyph(baker->strike, glyph, &g)) {
+            slot->strike_glyph = glyph + 1;
+            if (baker->glyph_metrics) {
+                baker->glyph_metrics[cp - baker->out_font->unicode_cp_start] = {
+                    pfb__clamp_s16((s32)g.advance), pfb__clamp_s16(g.bearing_x), pfb__clamp_s16(-g.bearing_y),
+                    pfb__clamp_u16((s32)g.width), pfb__clamp_u16((s32)g.height)
+                };
+            }
+            return;
+        }
+    }
+
+    if (baker->glyph_metrics)
+        pfb__measure_glyph(baker, cp);
+
+    if (baker->strip_rows) {
+        pfb__rasterize_strips(baker, cp, slot, strip_memory, bitmap);
+        return;
+    }
+
+    if (baker->fixed_scale) {
+        s32 glyph = stbtt_FindGlyphIndex(&baker->font, (s32)cp);
+        s32 x1, y1;
+        pfb__fixed_glyph_box(&baker->font, glyph, baker->fixed_scale, &slot->x_offset, &slot->y_offset, &x1, &y1);
+
+        stbtt_vertex* vertices = nullptr;
+        s32 vertex_count = stbtt_GetGlyphShape(&baker->font, glyph, &vertices);
+
+        // NOTE: Like the float path: rasterized into the cell minus the
+        //   prefilter's tail, then box filtered when supersampling.
+        s32 s = baker->supersample;
+        s32 w = baker->char_width_in_px;
+        s32 h = baker->char_height_in_px;
+        memset(bitmap, 0, w*h);
+        pfb__rasterize_fixed(vertices, vertex_count, baker->fixed_scale, slot->x_offset, slot->y_offset,
+                             bitmap, w - (s - 1), h - (s - 1), w);
+        if (vertices)
+            stbtt_FreeShape(&baker->font, vertices);
+        if (s > 1) {
+            pfb__box_prefilter(bitmap, w, 1, h, w, s);
+            pfb__box_prefilter(bitmap, h, w, w, 1, s);
+        }
+        return;
+    }
+
+    stbtt_GetCodepointBitmapBox(&baker->font, cp, baker->font_scale, baker->font_scale,
+                                &slot->x_offset, &slot->y_offset, nullptr, nullptr);
+
+    memset(bitmap, 0, baker->char_width_in_px*baker->char_height_in_px);
+
+    f32 sub_x, sub_y;
+    stbtt_MakeCodepointBitmapSubpixelPrefilter(&baker->font, bitmap,
+                                               baker->char_width_in_px, baker->char_height_in_px,
+                                               baker->char_width_in_px, // NOTE(Felix): stride
+                                               baker->font_scale, baker->font_scale, // font scales x and y
+                                               0, 0, // subpixel shift x and y
+                                               baker->supersample, baker->supersample, // oversample x and y
+                                               &sub_x, &sub_y,
+                                               cp);
+}
+
+// NOTE: The glyph's pen sits on the left edge of the cell and its baseline
+//   ascender rows below the top, anything outside the cell is clipped.
+static void pfb__pack_strike_glyph(const pfb__Ttf_Baker* baker, u32 glyph_index, u8* glyph) {
+    const pfb__Ttf_Strike* strike = baker->strike;
+    Pixel_Font* font = baker->out_font;
+
+    pfb__Strike_Glyph g;
+    if (!pfb__strike_glyph(strike, glyph_index, &g))
+        return;
+
+    s32 x_start = g.bearing_x;
+    s32 y_start = strike->ascender - g.bearing_y;
+
+    s32 x_begin = max(0, x_start);
+    s32 y_begin = max(0, y_start);
+    s32 x_end   = min((s32)font->char_px_width,  x_start + (s32)g.width);
+    s32 y_end   = min((s32)font->char_px_height, y_start + (s32)g.height);
+
+    if (x_begin >= x_end)
+        return;
+
+    u8 row_buffer[32];
+    for (s32 y = y_begin; y < y_end; ++y) {
+        const u8* src = pfb__strike_row(&g, strike->bit_depth, y - y_start, baker->gray_threashold, row_buffer);
+        pfb__blit_row(glyph + y*font->bytes_per_line, x_start, src, x_begin - x_start, x_end - x_start);
+    }
+}
+
+static void pfb__pack_glyph(const pfb__Ttf_Baker* baker, const pfb__Raster_Slot* slot, const u8* bitmap, u8* glyph) {
+    if (slot->strike_glyph) {
+        pfb__pack_strike_glyph(baker, slot->strike_glyph - 1, glyph);
+        return;
+    }
+
+    // NOTE: Glyphs rasterized in strips were packed strip by strip already.
+    if (baker->strip_rows) {
+        memcpy(glyph, bitmap, baker->out_font->bytes_per_glyph);
+        return;
+    }
+
+    pfb__pack_rows(baker, slot, bitmap, 0, baker->char_height_in_px, glyph);
+}
+
+// NOTE: Where the pack stage puts its glyphs. Without a file the glyphs go
+//   straight into the table of the Pixel_Font. When streaming, only
+//   window_glyphs glyphs are kept in a block that is handed to the write stage
+//   once it is full, so the memory needed does not depend on the range size.
+struct pfb__Glyph_Sink {
+    u8*  table;
+    u64  bytes_per_glyph;
+    u32  unicode_cp_start;
+    u32  unicode_cp_end;
+
+    FILE* file;
+    u32   window_glyphs;
+    u8*   block;           // block the pack stage is currently filling
+    pfb__Spsc_Ring* ring;  // full blocks for the write thread, nullptr writes inline
+    bool  write_failed;
+};
+
+// NOTE: Every block in the write ring starts with this header, followed by
+//   window_glyphs*bytes_per_glyph bytes of table.
+struct pfb__Block_Slot {
+    u64 byte_count;
+};
+
+static u8* pfb__sink_begin_glyph(pfb__Glyph_Sink* sink, u32 cp, Pixel_Font_Bake_Stats* stats) {
+    u64 glyph_index = cp - sink->unicode_cp_start;
+    if (!sink->file)
+        return sink->table + glyph_index * sink->bytes_per_glyph;
+
+    u64 index_in_block = glyph_index % sink->window_glyphs;
+    if (index_in_block == 0) {
+        if (sink->ring) {
+            f64 t0 = pfb__seconds_now();
+            u8* slot_memory;
+            while (!(slot_memory = pfb__ring_begin_push(sink->ring)))
+                std::this_thread::yield();
+            stats->pack.stall_seconds += pfb__seconds_now() - t0;
+            sink->block = slot_memory + sizeof(pfb__Block_Slot);
+        }
+        memset(sink->block, 0, sink->window_glyphs * sink->bytes_per_glyph);
+    }
+    return sink->block + index_in_block * sink->bytes_per_glyph;
+}
+
+static void pfb__sink_end_glyph(pfb__Glyph_Sink* sink, u32 cp, Pixel_Font_Bake_Stats* stats) {
+    if (!sink->file)
+        return;
+
+    u64 index_in_block = (cp - sink->unicode_cp_start) % sink->window_glyphs;
+    if (index_in_block != sink->window_glyphs - 1 && cp != sink->unicode_cp_end)
+        return;
+
+    u64 byte_count = (index_in_block + 1) * sink->bytes_per_glyph;
+    if (sink->ring) {
+        ((pfb__Block_Slot*)(sink->block - sizeof(pfb__Block_Slot)))->byte_count = byte_count;
+        pfb__ring_end_push(sink->ring);
+    } else {
+        f64 t0 = pfb__seconds_now();
+        if (fwrite(sink->block, 1, byte_count, sink->file) != byte_count)
+            sink->write_failed = true;
+        stats->write.busy_seconds += pfb__seconds_now() - t0;
+        ++stats->write.items;
+    }
+}
+
+static void pfb__write_blocks(pfb__Glyph_Sink* sink, u64 block_count, Pixel_Font_Bake_Stage_Stats* stats) {
+    for (u64 i = 0; i < block_count; ++i) {
+        f64 t0 = pfb__seconds_now();
+        u8* slot_memory;
+        while (!(slot_memory = pfb__ring_begin_pop(sink->ring)))
+            std::this_thread::yield();
+        f64 t1 = pfb__seconds_now();
+
+        u64 byte_count = ((pfb__Block_Slot*)slot_memory)->byte_count;
+        if (fwrite(slot_memory + sizeof(pfb__Block_Slot), 1, byte_count, sink->file) != byte_count)
+            sink->write_failed = true;
+        pfb__ring_end_pop(sink->ring);
+
+        stats->stall_seconds += t1 - t0;
+        stats->busy_seconds  += pfb__seconds_now() - t1;
+        ++stats->items;
+    }
+}
+
+static void pfb__bake_sequential(const pfb__Ttf_Baker* baker, pfb__Glyph_Sink* sink,
+                                 u8* bitmap_memory, u8* strip_memory, Pixel_Font_Bake_Stats* stats)
+{
+    // NOTE: u64, so a range ending at 0xFFFFFFFF ends
+    for (u64 cp = sink->unicode_cp_start; cp <= sink->unicode_cp_end; ++cp) {
+        pfb__Raster_Slot slot;
+
+        f64 t0 = pfb__seconds_now();
+        pfb__rasterize_glyph(baker, (u32)cp, &slot, bitmap_memory, strip_memory);
+        f64 t1 = pfb__seconds_now();
+        pfb__pack_glyph(baker, &slot, bitmap_memory, pfb__sink_begin_glyph(sink, (u32)cp, stats));
+        f64 t2 = pfb__seconds_now();
+        pfb__sink_end_glyph(sink, (u32)cp, stats);
+        stats->strike_glyphs += slot.strike_glyph != 0;
+
+        stats->rasterize.busy_seconds += t1 - t0;
+        stats->pack.busy_seconds      += t2 - t1;
+        if (stats->pack.items == 0)
+            stats->first_glyph_seconds = t2 - baker->bake_start;
+        ++stats->rasterize.items;
+        ++stats->pack.items;
+    }
+}
+
+static void pfb__bake_pipelined(const pfb__Ttf_Baker* baker, pfb__Glyph_Sink* sink, u32 thread_count,
+                                pfb__Spsc_Ring* rings, pfb__Raster_Worker* workers,
+                                u8* strip_memory, u64 strip_size, Pixel_Font_Bake_Stats* stats)
+{
+    u32 unicode_cp_start = sink->unicode_cp_start;
+    u32 unicode_cp_end   = sink->unicode_cp_end;
+
+    for (u32 t = 0; t < thread_count; ++t) {
+        new (&workers[t]) pfb__Raster_Worker();
+        workers[t].thread = std::thread([=]() {
+            pfb__Spsc_Ring* ring = &rings[t];
+            Pixel_Font_Bake_Stage_Stats* st = &workers[t].stats;
+            u8* strip = strip_memory + t * strip_size;
+
+            // NOTE: Worker t rasterizes every thread_count-th codepoint, so
+            //   the packer knows which ring the next glyph arrives on.
+            for (u64 cp = unicode_cp_start + t; cp <= unicode_cp_end; cp += thread_count) {
+                f64 t0 = pfb__seconds_now();
+                u8* slot_memory;
+                while (!(slot_memory = pfb__ring_begin_push(ring)))
+                    std::this_thread::yield();
+                f64 t1 = pfb__seconds_now();
+
+                pfb__rasterize_glyph(baker, (u32)cp, (pfb__Raster_Slot*)slot_memory,
+                                     slot_memory + sizeof(pfb__Raster_Slot), strip);
+                pfb__ring_end_push(ring);
+
+                st->stall_seconds += t1 - t0;
+                st->busy_seconds  += pfb__seconds_now() - t1;
+                ++st->items;
+            }
+        });
+    }
+
+    std::thread writer;
+    if (sink->ring) {
+        u64 block_count = ((u64)unicode_cp_end - unicode_cp_start + sink->window_glyphs) / sink->window_glyphs;
+        writer = std::thread(pfb__write_blocks, sink, block_count, &stats->write);
+    }
+
+    for (u64 cp = unicode_cp_start; cp <= unicode_cp_end; ++cp) {
+        pfb__Spsc_Ring* ring = &rings[(cp - unicode_cp_start) % thread_count];
+
+        f64 t0 = pfb__seconds_now();
+        u8* slot_memory;
+        while (!(slot_memory = pfb__ring_begin_pop(ring)))
+            std::this_thread::yield();
+        f64 t1 = pfb__seconds_now();
+
+        pfb__Raster_Slot* slot = (pfb__Raster_Slot*)slot_memory;
+        pfb__pack_glyph(baker, slot, slot_memory + sizeof(pfb__Raster_Slot),
+                        pfb__sink_begin_glyph(sink, (u32)cp, stats));
+        stats->strike_glyphs += slot->strike_glyph != 0;
+        pfb__ring_end_pop(ring);
+        pfb__sink_end_glyph(sink, (u32)cp, stats);
+
+        f64 t2 = pfb__seconds_now();
+        stats->pack.stall_seconds += t1 - t0;
+        stats->pack.busy_seconds  += t2 - t1;
+        if (stats->pack.items == 0)
+            stats->first_glyph_seconds = t2 - baker->bake_start;
+        ++stats->pack.items;
+    }
+
+    for (u32 t = 0; t < thread_count; ++t) {
+        workers[t].thread.join();
+        stats->rasterize.items         += workers[t].stats.items;
+        stats->rasterize.busy_seconds  += workers[t].stats.busy_seconds;
+        stats->rasterize.stall_seconds += workers[t].stats.stall_seconds;
+        workers[t].~pfb__Raster_Worker();
+    }
+    if (writer.joinable())
+        writer.join();
+}
+
+// NOTE: Row and glyph strides of the word row layout, packed for 0 and 0.
+static Pixel_Font_Baker_Error pfb__row_layout(u32 char_px_width, u32 char_px_height,
+                                              u32 row_word_bytes, u32 glyph_alignment,
+                                              u32* out_bytes_per_line, u32* out_bytes_per_glyph)
+{
+    u32 packed = (char_px_width + 7) / 8;
+    bool valid =
+        (row_word_bytes == 0 || row_word_bytes == 1 || row_word_bytes == 2 ||
+         row_word_bytes == 4 || row_word_bytes == 8) &&
+        (glyph_alignment == 0 || glyph_alignment == 16 || glyph_alignment == 64) &&
+        row_word_bytes >= (row_word_bytes ? packed : 0);
+    if (!valid)
+        return Pixel_Font_Baker_Error::ROW_LAYOUT_INVALID;
+
+    u32 bytes_per_line  = row_word_bytes ? row_word_bytes : packed;
+    u32 bytes_per_glyph = bytes_per_line * char_px_height;
+    if (glyph_alignment)
+        bytes_per_glyph = (bytes_per_glyph + glyph_alignment - 1) / glyph_alignment * glyph_alignment;
+
+    *out_bytes_per_line  = bytes_per_line;
+    *out_bytes_per_glyph = bytes_per_glyph;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+// NOTE: The smallest row word packed row bytes fit in, 0 if none does.
+static u32 pfb__row_word_bytes(u32 packed_bytes) {
+    for (u32 word_bytes : { 1u, 2u, 4u, 8u }) {
+        if (packed_bytes <= word_bytes)
+            return word_bytes;
+    }
+    return 0;
+}
+
+static Pixel_Font_Header pfb__header_from_font(const Pixel_Font* font) {
+    Pixel_Font_Header header = {};
+    memcpy(header.magic, PIXEL_FONT_FILE_MAGIC, sizeof(header.magic));
+    header.version          = PIXEL_FONT_FILE_VERSION;
+    header.header_size      = sizeof(Pixel_Font_Header);
+    header.char_px_width    = font->char_px_width;
+    header.char_px_height   = font->char_px_height;
+    header.bytes_per_line   = font->bytes_per_line;
+    header.bytes_per_glyph  = font->bytes_per_glyph;
+    header.unicode_cp_start = font->unicode_cp_start;
+    header.unicode_cp_end   = font->unicode_cp_end;
+    header.table_size       = ((u64)font->unicode_cp_end - font->unicode_cp_start + 1) * font->bytes_per_glyph;
+    header.flags            = font->glyph_metrics ? PIXEL_FONT_FILE_GLYPH_METRICS : 0;
+    header.cell_x           = font->cell_x;
+    header.baseline         = font->baseline;
+    header.line_height      = font->line_height;
+    return header;
+}
+
+// NOTE: Shared by create_pixel_font_from_ttf and bake_pixel_font_file_from_ttf.
+//   With an out_file the glyphs are streamed into it after the header and
+//   out_font only receives the dimensions, its table stays nullptr.
+static Pixel_Font_Baker_Error pfb__bake_ttf(const char* font_path, u16 char_height_in_px,
+                                            u32 unicode_cp_start, u32 unicode_cp_end,
+                                            u8 gray_threashold, u8 supersample, FILE* out_file,
+                                            const Pixel_Font_Bake_Options* options, Pixel_Font* out_font)
+{
+    Pixel_Font_Bake_Options default_options;
+    if (!options)
+        options = &default_options;
+
+    Pixel_Font_Bake_Stats local_stats = {};
+    Pixel_Font_Bake_Stats* stats = options->stats ? options->stats : &local_stats;
+    *stats = {};
+
+    f64 bake_start = pfb__seconds_now();
+
+    pfb__Ttf_Baker baker = {};
+    stbtt_fontinfo& font = baker.font;
+    u64 file_length;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_ttf(font_path, &font, &file_length);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    defer { pfb__free_ttf(&font); };
+
+    pfb__Ttf_Strike strike;
+    if (options->embedded_bitmaps &&
+        pfb__find_ttf_strike(font.data, file_length, (u32)font.fontstart, char_height_in_px, &strike))
+    {
+        baker.strike = &strike;
+        log_debug("strike:          %u ppem, %u bit", strike.ppem, strike.bit_depth);
+    }
+
+    // internally calculate with higher resolution
+    char_height_in_px *= supersample;
+
+    //
+    //  Preparing one-char-bitmap
+    //
+
+    s32 char_width_in_px;
+    s32 ascend;
+    f32 font_scale;
+    if (baker.strike) {
+        pfb__strike_cell_size(&font, &strike, &font_scale, &char_width_in_px, &ascend);
+        font_scale       *= supersample;
+        char_width_in_px *= supersample;
+        ascend           *= supersample;
+    } else {
+        pfb__ttf_cell_size(&font, char_height_in_px, &font_scale, &char_width_in_px, &ascend);
+        // NOTE: The baseline sits between two cell rows, as it does without
+        //   supersampling, so baseline and the glyph metrics describe the
+        //   packed pixels.
+        ascend = (ascend + supersample / 2) / supersample * supersample;
+    }
+
+    // NOTE: With a budget the layout only depends on the cell, so it is
+    //   chosen here and the glyphs are baked straight into it.
+    u32 row_word_bytes  = options->row_word_bytes;
+    u32 glyph_alignment = options->glyph_alignment;
+    if (options->table_budget_bytes) {
+        Pixel_Font cell = {};
+        cell.char_px_width    = (u16)(char_width_in_px  / supersample);
+        cell.char_px_height   = (u16)(char_height_in_px / supersample);
+        cell.unicode_cp_start = unicode_cp_start;
+        cell.unicode_cp_end   = unicode_cp_end;
+
+        Pixel_Font_Layout_Choice local_choice;
+        Pixel_Font_Layout_Choice* choice = options->layout_choice ? options->layout_choice : &local_choice;
+        Pixel_Font_Baker_Error error = choose_pixel_font_layout(&cell, options->table_budget_bytes,
+                                                                options->layout_preference, choice);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+
+        bool word_rows  = choice->chosen == Pixel_Font_Table_Layout::WORD_ROWS;
+        row_word_bytes  = word_rows ? pfb__row_word_bytes((cell.char_px_width + 7) / 8) : 0;
+        glyph_alignment = word_rows ? 64 : 0;
+    }
+
+    // get number of bytes per pixel line and per char
+    u32 bytes_per_line;
+    u32 bytes_per_glyph;
+    {
+        Pixel_Font_Baker_Error error =
+            pfb__row_layout(char_width_in_px / supersample, char_height_in_px / supersample,
+                            row_word_bytes, glyph_alignment, &bytes_per_line, &bytes_per_glyph);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+
+    out_font->char_px_width     = char_width_in_px  / supersample;
+    out_font->char_px_height    = char_height_in_px / supersample;
+    out_font->table             = nullptr;
+    out_font->bytes_per_line    = bytes_per_line;
+    out_font->bytes_per_glyph   = bytes_per_glyph;
+    out_font->unicode_cp_start  = unicode_cp_start;
+    out_font->unicode_cp_end    = unicode_cp_end;
+    out_font->table_is_borrowed = false;
+    out_font->glyph_metrics     = nullptr;
+    out_font->cell_x            = 0;
+    out_font->baseline          = pfb__clamp_s16(ascend / supersample);
+    {
+        s32 ascent, descent, line_gap;
+        stbtt_GetFontVMetrics(&font, &ascent, &descent, &line_gap);
+        f32 scale = font_scale / supersample;
+        s32 line_height = baker.strike
+            ? strike.ascender - strike.descender + (s32)roundf(line_gap * scale)
+            : (s32)roundf((ascent - descent + line_gap) * scale);
+        out_font->line_height = pfb__clamp_s16(line_height);
+    }
+
+    log_debug("width:           %i", out_font->char_px_width);
+    log_debug("height:          %i", out_font->char_px_height);
+    log_debug("bytes per line:  %i", out_font->bytes_per_line);
+    log_debug("bytes per glyph: %i", out_font->bytes_per_glyph);
+
+    pfb__Glyph_Sink sink = {};
+    sink.bytes_per_glyph  = out_font->bytes_per_glyph;
+    sink.unicode_cp_start = unicode_cp_start;
+    sink.unicode_cp_end   = unicode_cp_end;
+
+    u64 unicode_cp_size = (u64)unicode_cp_end - unicode_cp_start + 1;
+    if (out_file)
+        sink.window_glyphs = (u32)min((u64)max(1u, options->stream_window_glyphs), unicode_cp_size);
+
+    baker.font_scale        = font_scale;
+    baker.char_width_in_px  = char_width_in_px;
+    baker.char_height_in_px = char_height_in_px;
+    baker.ascend            = ascend;
+    baker.supersample       = supersample;
+    baker.fixed_scale       = options->fixed_point_rasterizer
+        ? pfb__fixed_font_scale(&font, baker.strike, char_height_in_px, supersample)
+        : 0;
+    baker.strip_rows        = 0;
+    baker.gray_threashold   = gray_threashold;
+    baker.out_font          = out_font;
+    baker.bake_start        = bake_start;
+
+    //
+    //  Allocating everything but the table
+    //
+
+    // NOTE: Without threads the stages share one gray bitmap. With threads
+    //   all rings, workers and ring slots live in one block, followed by the
+    //   stream blocks when baking to a file and the strips of the workers.
+    //   Threaded bakes double buffer the stream blocks, so packing can go on
+    //   while the write thread is busy with the previous block. Glyphs baked
+    //   in strips pass the packed glyph instead of the gray bitmap, and every
+    //   rasterizer has its strip (with a spare row and the prefilter's history
+    //   rows twice).
+    //   The table is allocated last, so no failure after it has to free it
+    //   again.
+    u32 thread_count = options->rasterize_threads;
+    u32 queue_depth  = max(1u, options->queue_depth);
+    u64 bitmap_size  = (u64)char_height_in_px*char_width_in_px;
+    u64 strip_size   = 0;
+    if (options->raster_strip_bytes && bitmap_size > options->raster_strip_bytes) {
+        baker.strip_rows = max(1, (s32)(options->raster_strip_bytes / (u32)char_width_in_px));
+        bitmap_size      = out_font->bytes_per_glyph;
+        strip_size       = ((u64)baker.strip_rows + 1 + 2*(supersample - 1)) * char_width_in_px;
+    }
+    u64 slot_size    = (sizeof(pfb__Raster_Slot) + bitmap_size + 63) & ~(u64)63;
+    u64 block_size   = sizeof(pfb__Block_Slot) + (u64)sink.window_glyphs * sink.bytes_per_glyph;
+    u32 block_count  = out_file ? (thread_count ? 2 : 1) : 0;
+    u32 ring_count   = thread_count ? thread_count + (out_file ? 1 : 0) : 0;
+
+    u8* bitmap_memory   = nullptr;
+    u8* pipeline_memory = nullptr;
+    u8* metrics_memory  = nullptr;
+    defer {
+        pfb__deallocate(bitmap_memory,   Pixel_Font_Allocation_Stage::RASTERIZE);
+        pfb__deallocate(pipeline_memory, Pixel_Font_Allocation_Stage::PIPELINE);
+        pfb__deallocate(metrics_memory,  Pixel_Font_Allocation_Stage::PIPELINE);
+    };
+
+    if (thread_count == 0) {
+        bitmap_memory = (u8*)pfb__allocate(bitmap_size + strip_size, Pixel_Font_Allocation_Stage::RASTERIZE);
+        if (!bitmap_memory)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    }
+
+    pfb__Spsc_Ring*     rings        = nullptr;
+    pfb__Raster_Worker* workers      = nullptr;
+    u8*                 block_memory = nullptr;
+    u8*                 strip_memory = bitmap_memory ? bitmap_memory + bitmap_size : nullptr;
+    if (thread_count || out_file) {
+        u64 pipeline_size =
+            63 + ring_count * sizeof(pfb__Spsc_Ring) + thread_count * sizeof(pfb__Raster_Worker) +
+            (u64)thread_count * queue_depth * slot_size + block_count * block_size + thread_count * strip_size;
+        pipeline_memory = (u8*)pfb__allocate(pipeline_size, Pixel_Font_Allocation_Stage::PIPELINE);
+        if (!pipeline_memory)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+
+        u8* cursor   = (u8*)(((uintptr_t)pipeline_memory + 63) & ~(uintptr_t)63);
+        rings        = (pfb__Spsc_Ring*)cursor;
+        cursor      += ring_count * sizeof(pfb__Spsc_Ring);
+        workers      = (pfb__Raster_Worker*)cursor;
+        cursor      += thread_count * sizeof(pfb__Raster_Worker);
+        u8* slots    = cursor;
+        block_memory = slots + (u64)thread_count * queue_depth * slot_size;
+        if (thread_count)
+            strip_memory = block_memory + block_count * block_size;
+
+        for (u32 t = 0; t < thread_count; ++t) {
+            new (&rings[t]) pfb__Spsc_Ring();
+            rings[t].slots     = slots + (u64)t * queue_depth * slot_size;
+            rings[t].slot_size = (u32)slot_size;
+            rings[t].capacity  = queue_depth;
+            rings[t].head.store(0);
+            rings[t].tail.store(0);
+        }
+
+        if (out_file && thread_count) {
+            pfb__Spsc_Ring* block_ring = &rings[thread_count];
+            new (block_ring) pfb__Spsc_Ring();
+            block_ring->slots     = block_memory;
+            block_ring->slot_size = (u32)block_size;
+            block_ring->capacity  = 2;
+            block_ring->head.store(0);
+            block_ring->tail.store(0);
+            sink.ring = block_ring;
+        }
+    }
+
+    // NOTE: When baking to a file the glyph metrics are only 10 bytes a
+    //   glyph, so they are kept in memory and written after the table.
+    u64 total_byte_size = unicode_cp_size * out_font->bytes_per_glyph;
+    u64 metrics_size    = options->glyph_metrics ? unicode_cp_size * sizeof(Pixel_Font_Glyph_Metrics) : 0;
+    if (out_file && metrics_size) {
+        metrics_memory = (u8*)pfb__allocate(metrics_size, Pixel_Font_Allocation_Stage::PIPELINE);
+        if (!metrics_memory)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+        baker.glyph_metrics = (Pixel_Font_Glyph_Metrics*)metrics_memory;
+    }
+
+    if (!out_file) {
+        u64 block_size = metrics_size ? pfb__glyph_metrics_offset(total_byte_size) + metrics_size : total_byte_size;
+        u8* font_data = pfb__allocate_table(block_size, options->table_pages);
+        if (!font_data)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+
+        memset((void*)font_data, 0, block_size);
+        out_font->table = font_data;
+        sink.table      = font_data;
+        if (metrics_size) {
+            out_font->glyph_metrics = (Pixel_Font_Glyph_Metrics*)(font_data + pfb__glyph_metrics_offset(total_byte_size));
+            baker.glyph_metrics     = out_font->glyph_metrics;
+        }
+    } else {
+        Pixel_Font_Header header = pfb__header_from_font(out_font);
+        if (metrics_size)
+            header.flags |= PIXEL_FONT_FILE_GLYPH_METRICS;
+        if (fwrite(&header, sizeof(header), 1, out_file) != 1)
+            return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+        sink.file  = out_file;
+        sink.block = block_memory;
+    }
+
+    if (thread_count == 0)
+        pfb__bake_sequential(&baker, &sink, bitmap_memory, strip_memory, stats);
+    else
+        pfb__bake_pipelined(&baker, &sink, thread_count, rings, workers, strip_memory, strip_size, stats);
+
+    stats->total_seconds = pfb__seconds_now() - bake_start;
+
+    log_debug("rasterize:       %llu glyphs, %.3fs busy, %.3fs stalled",
+              (unsigned long long)stats->rasterize.items,
+              stats->rasterize.busy_seconds, stats->rasterize.stall_seconds);
+    log_debug("pack:            %llu glyphs, %.3fs busy, %.3fs stalled",
+              (unsigned long long)stats->pack.items,
+              stats->pack.busy_seconds, stats->pack.stall_seconds);
+    if (baker.strike)
+        log_debug("from the strike: %llu glyphs", (unsigned long long)stats->strike_glyphs);
+    if (out_file) {
+        log_debug("write:           %llu blocks, %.3fs busy, %.3fs stalled",
+                  (unsigned long long)stats->write.items,
+                  stats->write.busy_seconds, stats->write.stall_seconds);
+    }
+
+    if (sink.write_failed)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+    if (out_file && metrics_size) {
+        static const u8 zeros[8] = {};
+        u64 padding = pfb__glyph_metrics_offset(total_byte_size) - total_byte_size;
+        if ((padding && fwrite(zeros, padding, 1, out_file) != 1) ||
+            fwrite(metrics_memory, metrics_size, 1, out_file) != 1)
+        {
+            return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+        }
+    }
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error create_pixel_font_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                  u32 unicode_cp_start, u32 unicode_cp_end,
+                                                  u8 gray_threashold, u8 supersample, Pixel_Font* out_font,
+                                                  const Pixel_Font_Bake_Options* options)
+{
+    return pfb__bake_ttf(font_path, char_height_in_px, unicode_cp_start, unicode_cp_end,
+                         gray_threashold, supersample, nullptr, options, out_font);
+}
+
+// NOTE: Every file the baker writes goes to out_path.part first, which only
+//   replaces out_path once it is complete (pfb__commit_part_file). A failed
+//   write neither leaves a truncated file behind nor destroys the previous
+//   one: pfb__close_part_file, deferred right after opening, removes the
+//   .part file unless it was committed.
+struct pfb__Part_File {
+    char* path;
+    FILE* file;
+};
+
+static Pixel_Font_Baker_Error pfb__open_part_file(const char* out_path, pfb__Part_File* out_part) {
+    *out_part = {};
+
+    u64 path_length = strlen(out_path);
+    out_part->path = (char*)pfb__allocate(path_length + sizeof(".part"), Pixel_Font_Allocation_Stage::PIPELINE);
+    if (!out_part->path)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    memcpy(out_part->path, out_path, path_length);
+    memcpy(out_part->path + path_length, ".part", sizeof(".part"));
+
+    out_part->file = fopen(out_part->path, "wb");
+    if (!out_part->file)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+static Pixel_Font_Baker_Error pfb__commit_part_file(pfb__Part_File* part, const char* out_path) {
+    FILE* file = part->file;
+    part->file = nullptr;
+    if (fclose(file) != 0 || rename(part->path, out_path) != 0)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+    pfb__deallocate(part->path, Pixel_Font_Allocation_Stage::PIPELINE);
+    part->path = nullptr;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+static void pfb__close_part_file(pfb__Part_File* part) {
+    if (part->file)
+        fclose(part->file);
+    if (part->path) {
+        remove(part->path);
+        pfb__deallocate(part->path, Pixel_Font_Allocation_Stage::PIPELINE);
+    }
+    *part = {};
+}
+
+Pixel_Font_Baker_Error bake_pixel_font_file_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                     u32 unicode_cp_start, u32 unicode_cp_end,
+                                                     u8 gray_threashold, u8 supersample, const char* out_path,
+                                                     const Pixel_Font_Bake_Options* options)
+{
+    pfb__Part_File out;
+    Pixel_Font_Baker_Error error = pfb__open_part_file(out_path, &out);
+    defer { pfb__close_part_file(&out); };
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+
+    Pixel_Font font = {};
+    error = pfb__bake_ttf(font_path, char_height_in_px, unicode_cp_start, unicode_cp_end,
+                          gray_threashold, supersample, out.file, options, &font);
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+
+    return pfb__commit_part_file(&out, out_path);
+}
+
+static void pfb__layout_sizes(Pixel_Font_Size_Estimate* e) {
+    u64 index_size = e->unique_glyphs > 0xffff ? 4 : 2;
+
+    e->dense_bytes        = e->glyphs_in_range * e->bytes_per_glyph;
+    e->sparse_bytes       = e->glyphs_covered  * e->bytes_per_glyph + e->covered_runs * 12;
+    e->deduplicated_bytes = e->glyphs_in_range * index_size + e->unique_glyphs * e->bytes_per_glyph;
+    e->compressed_bytes   = e->glyphs_in_range * 8 + e->ink_bytes;
+}
+
+static u64 pfb__count_runs(const u8* bits, u64 bit_count) {
+    u64 runs = 0;
+    bool previous = false;
+    for (u64 i = 0; i < bit_count; ++i) {
+        bool current = (bits[i / 8] >> (i % 8)) & 1;
+        runs += current && !previous;
+        previous = current;
+    }
+    return runs;
+}
+
+Pixel_Font_Baker_Error estimate_pixel_font_size_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                         u32 unicode_cp_start, u32 unicode_cp_end,
+                                                         u8 supersample, Pixel_Font_Size_Estimate* out_estimate)
+{
+    stbtt_fontinfo font;
+    u64 file_length;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_ttf(font_path, &font, &file_length);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    defer { pfb__free_ttf(&font); };
+
+    // NOTE: Same cell size as create_pixel_font_from_ttf (with its default
+    //   options), the ink boxes are measured at the final (not oversampled)
+    //   resolution. With a strike they come from the outlines all the same.
+    f32 font_scale;
+    s32 char_width_in_px;
+    s32 ascend;
+    pfb__Ttf_Strike strike;
+    if (pfb__find_ttf_strike(font.data, file_length, (u32)font.fontstart, char_height_in_px, &strike)) {
+        pfb__strike_cell_size(&font, &strike, &font_scale, &char_width_in_px, &ascend);
+        char_width_in_px *= supersample;
+    } else {
+        pfb__ttf_cell_size(&font, char_height_in_px * supersample, &font_scale, &char_width_in_px, &ascend);
+        font_scale /= supersample;
+        ascend     /= supersample;
+    }
+
+    Pixel_Font_Size_Estimate e = {};
+    e.char_px_width   = (u16)(char_width_in_px / supersample);
+    e.char_px_height  = char_height_in_px;
+    e.bytes_per_glyph = ((e.char_px_width + 7) / 8) * e.char_px_height;
+    e.glyphs_in_range = (u64)unicode_cp_end - unicode_cp_start + 1;
+
+    // NOTE: Codepoints that map to the same glyph index bake to the same
+    //   bitmap, as do all glyphs without ink, so the number of distinct glyph
+    //   indices is an upper bound for the deduplicated glyph count.
+    u64 seen_glyphs_size = (font.numGlyphs + 8) / 8;
+    u8* seen_glyphs = (u8*)pfb__allocate(seen_glyphs_size, Pixel_Font_Allocation_Stage::SCRATCH);
+    if (!seen_glyphs)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    defer { pfb__deallocate(seen_glyphs, Pixel_Font_Allocation_Stage::SCRATCH); };
+    memset(seen_glyphs, 0, seen_glyphs_size);
+
+    bool previous_covered = false;
+    bool blank_seen       = false;
+
+    for (u64 cp = unicode_cp_start; cp <= unicode_cp_end; ++cp) {
+        s32 glyph = stbtt_FindGlyphIndex(&font, (s32)cp);
+
+        bool covered = glyph != 0;
+        e.glyphs_covered += covered;
+        e.covered_runs   += covered && !previous_covered;
+        previous_covered  = covered;
+
+        s32 x0, y0, x1, y1;
+        stbtt_GetGlyphBitmapBox(&font, glyph, font_scale, font_scale, &x0, &y0, &x1, &y1);
+        x0 = max(x0, 0);
+        x1 = min(x1, (s32)e.char_px_width);
+        y0 = max(ascend + y0, 0);
+        y1 = min(ascend + y1, (s32)e.char_px_height);
+
+        if (x1 <= x0 || y1 <= y0) {
+            e.unique_glyphs += !blank_seen;
+            blank_seen = true;
+            continue;
+        }
+
+        e.ink_bytes += ((u64)(x1 - x0) * (y1 - y0) + 7) / 8;
+
+        if (glyph < font.numGlyphs && !(seen_glyphs[glyph / 8] & (1 << (glyph % 8)))) {
+            seen_glyphs[glyph / 8] |= (u8)(1 << (glyph % 8));
+            ++e.unique_glyphs;
+        }
+    }
+
+    pfb__layout_sizes(&e);
+    *out_estimate = e;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+static int pfb__compare_u64(const void* a, const void* b) {
+    u64 x = *(const u64*)a;
+    u64 y = *(const u64*)b;
+    return (x > y) - (x < y);
+}
+
+Pixel_Font_Baker_Error estimate_pixel_font_size_from_bdf(const char* font_path,
+                                                         u32 unicode_cp_start, u32 unicode_cp_end,
+                                                         Pixel_Font_Size_Estimate* out_estimate)
+{
+    pfb__File_Contents file_content;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_font_file(font_path, &file_content);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    defer { pfb__deallocate(file_content.data, Pixel_Font_Allocation_Stage::FONT_FILE); };
+
+    Pixel_Font_Size_Estimate e = {};
+    e.glyphs_in_range = (u64)unicode_cp_end - unicode_cp_start + 1;
+
+    u64 covered_size = (e.glyphs_in_range + 7) / 8;
+    u8* covered = (u8*)pfb__allocate(covered_size, Pixel_Font_Allocation_Stage::SCRATCH);
+    if (!covered)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    defer { pfb__deallocate(covered, Pixel_Font_Allocation_Stage::SCRATCH); };
+    memset(covered, 0, covered_size);
+
+    u64* bitmap_hashes   = nullptr;
+    u64  hash_count      = 0;
+    u64  hash_capacity   = 0;
+    defer { pfb__deallocate(bitmap_hashes, Pixel_Font_Allocation_Stage::SCRATCH); };
+
+    bool have_bounding_box = false;
+    s32  code_point        = -1;
+    s32  bbx_w = 0, bbx_h = 0;
+    bool in_bitmap         = false;
+    u64  bitmap_hash       = 0;
+
+    // NOTE: Only scans the lines, the hex data is hashed as text instead of
+    //   being decoded. Glyphs with the same BBX and BITMAP text are duplicates.
+    const char* cursor = file_content.data;
+    const char* end    = file_content.data + file_content.length;
+    while (cursor < end) {
+        const char* line     = cursor;
+        const char* line_end = line;
+        while (line_end < end && *line_end != '\n' && *line_end != '\r')
+            ++line_end;
+        cursor = line_end;
+        while (cursor < end && (*cursor == '\n' || *cursor == '\r'))
+            ++cursor;
+
+        u64 length = line_end - line;
+        auto starts_with = [&](const char* prefix, u64 prefix_length) -> bool {
+            return length >= prefix_length && strncmp(line, prefix, prefix_length) == 0;
+        };
+
+        if (in_bitmap) {
+            if (starts_with("ENDCHAR", 7)) {
+                in_bitmap = false;
+                if (code_point < (s32)unicode_cp_start || code_point > (s32)unicode_cp_end)
+                    continue;
+
+                u64 index = code_point - unicode_cp_start;
+                if (covered[index / 8] & (1 << (index % 8)))
+                    continue;
+                covered[index / 8] |= (u8)(1 << (index % 8));
+                ++e.glyphs_covered;
+
+                u64 ink_w = min((u64)max(bbx_w, 0), (u64)e.char_px_width);
+                u64 ink_h = min((u64)max(bbx_h, 0), (u64)e.char_px_height);
+                e.ink_bytes += (ink_w * ink_h + 7) / 8;
+
+                if (hash_count == hash_capacity) {
+                    hash_capacity = max(hash_capacity * 2, (u64)256);
+                    u64* grown = (u64*)pfb__allocate(hash_capacity * sizeof(u64), Pixel_Font_Allocation_Stage::SCRATCH);
+                    if (!grown)
+                        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+                    if (hash_count)
+                        memcpy(grown, bitmap_hashes, hash_count * sizeof(u64));
+                    pfb__deallocate(bitmap_hashes, Pixel_Font_Allocation_Stage::SCRATCH);
+                    bitmap_hashes = grown;
+                }
+                bitmap_hashes[hash_count++] = bitmap_hash;
+            } else {
+                // NOTE: FNV-1a
+                for (const char* c = line; c < line_end; ++c)
+                    bitmap_hash = (bitmap_hash ^ (u8)*c) * 0x100000001b3ull;
+                bitmap_hash = (bitmap_hash ^ '\n') * 0x100000001b3ull;
+            }
+        } else if (starts_with("FONTBOUNDINGBOX ", 16)) {
+            s32 font_size_x, font_size_y, start_x, start_y;
+            if (sscanf(line + 16, "%d %d %d %d", &font_size_x, &font_size_y, &start_x, &start_y) != 4)
+                return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX_CORRECTLY;
+            e.char_px_width   = (u16)font_size_x;
+            e.char_px_height  = (u16)font_size_y;
+            e.bytes_per_glyph = ((font_size_x + 7) / 8) * font_size_y;
+            have_bounding_box = true;
+        } else if (starts_with("ENCODING ", 9)) {
+            if (sscanf(line + 9, "%d", &code_point) != 1)
+                return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_CODEPOINT_CORRECTLY;
+            bbx_w = e.char_px_width;
+            bbx_h = e.char_px_height;
+        } else if (starts_with("BBX ", 4)) {
+            sscanf(line + 4, "%d %d", &bbx_w, &bbx_h);
+        } else if (starts_with("BITMAP", 6)) {
+            in_bitmap   = true;
+            bitmap_hash = 0xcbf29ce484222325ull;
+            for (s32 v : {bbx_w, bbx_h})
+                bitmap_hash = (bitmap_hash ^ (u32)v) * 0x100000001b3ull;
+        }
+    }
+
+    if (!have_bounding_box)
+        return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX;
+
+    e.covered_runs = pfb__count_runs(covered, e.glyphs_in_range);
+
+    qsort(bitmap_hashes, hash_count, sizeof(u64), pfb__compare_u64);
+    for (u64 i = 0; i < hash_count; ++i)
+        e.unique_glyphs += (i == 0 || bitmap_hashes[i] != bitmap_hashes[i - 1]);
+
+    // NOTE: Codepoints the font does not have are filled with one and the
+    //   same placeholder pattern over the whole cell.
+    u64 uncovered = e.glyphs_in_range - e.glyphs_covered;
+    if (uncovered) {
+        ++e.unique_glyphs;
+        e.ink_bytes += uncovered * (((u64)e.char_px_width * e.char_px_height + 7) / 8);
+    }
+
+    pfb__layout_sizes(&e);
+    *out_estimate = e;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error save_pixel_font(const Pixel_Font* font, const char* out_path) {
+    pfb__Part_File out;
+    Pixel_Font_Baker_Error error = pfb__open_part_file(out_path, &out);
+    defer { pfb__close_part_file(&out); };
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+    FILE* out_file = out.file;
+
+    Pixel_Font_Header header = pfb__header_from_font(font);
+    if (fwrite(&header, sizeof(header), 1, out_file) != 1 ||
+        fwrite(font->table, 1, header.table_size, out_file) != header.table_size)
+    {
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+    }
+
+    if (font->glyph_metrics) {
+        static const u8 zeros[8] = {};
+        u64 padding      = pfb__glyph_metrics_offset(header.table_size) - header.table_size;
+        u64 metrics_size = ((u64)font->unicode_cp_end - font->unicode_cp_start + 1) * sizeof(Pixel_Font_Glyph_Metrics);
+        if (fwrite(zeros, 1, padding, out_file) != padding ||
+            fwrite(font->glyph_metrics, 1, metrics_size, out_file) != metrics_size)
+        {
+            return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+        }
+    }
+
+    return pfb__commit_part_file(&out, out_path);
+}
+
+Pixel_Font_Baker_Error load_pixel_font(const char* font_path, Pixel_Font* out_font,
+                                       Pixel_Font_Table_Pages table_pages)
+{
+    FILE* font_file = fopen(font_path, "rb");
+    if (!font_file)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+    defer { fclose(font_file); };
+
+    // NOTE: Version 1 headers end at flags, read that part first and the
+    //   rest only for version 2.
+    const u64 version_1_header_size = offsetof(Pixel_Font_Header, flags);
+    Pixel_Font_Header header = {};
+    if (fread(&header, version_1_header_size, 1, font_file) != 1 ||
+        memcmp(header.magic, PIXEL_FONT_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        (header.version != 1 && header.version != PIXEL_FONT_FILE_VERSION) ||
+        header.header_size < (header.version == 1 ? version_1_header_size : sizeof(Pixel_Font_Header)) ||
+        header.unicode_cp_end < header.unicode_cp_start ||
+        header.table_size != ((u64)header.unicode_cp_end - header.unicode_cp_start + 1) * header.bytes_per_glyph)
+    {
+        return Pixel_Font_Baker_Error::BAKED_FONT_FILE_INVALID;
+    }
+
+    if (header.version == PIXEL_FONT_FILE_VERSION &&
+        fread((u8*)&header + version_1_header_size, sizeof(header) - version_1_header_size, 1, font_file) != 1)
+    {
+        return Pixel_Font_Baker_Error::BAKED_FONT_FILE_INVALID;
+    }
+
+    // NOTE: The metrics are read together with the table and the padding
+    //   before them, straight into their place in the block.
+    u64 read_size    = header.table_size;
+    u64 metrics_size = 0;
+    if (header.flags & PIXEL_FONT_FILE_GLYPH_METRICS) {
+        metrics_size = ((u64)header.unicode_cp_end - header.unicode_cp_start + 1) * sizeof(Pixel_Font_Glyph_Metrics);
+        read_size    = pfb__glyph_metrics_offset(header.table_size) + metrics_size;
+    }
+
+    u8* table = pfb__allocate_table(read_size, table_pages);
+    if (!table)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+
+    if (fseek(font_file, header.header_size, SEEK_SET) != 0 ||
+        fread(table, 1, read_size, font_file) != read_size)
+    {
+        pfb__deallocate_table(table);
+        return Pixel_Font_Baker_Error::BAKED_FONT_FILE_INVALID;
+    }
+
+    out_font->glyph_metrics = metrics_size
+        ? (Pixel_Font_Glyph_Metrics*)(table + pfb__glyph_metrics_offset(header.table_size))
+        : nullptr;
+    out_font->cell_x            = header.cell_x;
+    out_font->baseline          = header.baseline;
+    out_font->line_height       = header.line_height;
+    out_font->table             = table;
+    out_font->char_px_width     = header.char_px_width;
+    out_font->char_px_height    = header.char_px_height;
+    out_font->bytes_per_line    = header.bytes_per_line;
+    out_font->bytes_per_glyph   = header.bytes_per_glyph;
+    out_font->unicode_cp_start  = header.unicode_cp_start;
+    out_font->unicode_cp_end    = header.unicode_cp_end;
+    out_font->table_is_borrowed = false;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+struct pfb__Bundle_Item {
+    Pixel_Font_Bundle_Entry entry;
+    const Pixel_Font*       font;
+};
+
+static int pfb__compare_bundle_keys(const char* name_a, u16 size_a, u16 style_a,
+                                    const char* name_b, u16 size_b, u16 style_b)
+{
+    int names = strncmp(name_a, name_b, PIXEL_FONT_BUNDLE_NAME_LENGTH);
+    if (names != 0)
+        return names;
+    if (size_a != size_b)
+        return size_a < size_b ? -1 : 1;
+    if (style_a != style_b)
+        return style_a < style_b ? -1 : 1;
+    return 0;
+}
+
+static int pfb__compare_bundle_items(const void* a, const void* b) {
+    const Pixel_Font_Bundle_Entry* x = &((const pfb__Bundle_Item*)a)->entry;
+    const Pixel_Font_Bundle_Entry* y = &((const pfb__Bundle_Item*)b)->entry;
+    return pfb__compare_bundle_keys(x->name, x->size, x->style, y->name, y->size, y->style);
+}
+
+static u64 pfb__align_up(u64 value, u64 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static u64 pfb__bundle_metrics_size(const Pixel_Font_Bundle_Entry* e) {
+    if (!(e->flags & PIXEL_FONT_FILE_GLYPH_METRICS))
+        return 0;
+    return ((u64)e->unicode_cp_end - e->unicode_cp_start + 1) * sizeof(Pixel_Font_Glyph_Metrics);
+}
+
+// NOTE: Where the entry's table and its glyph metrics end, relative to
+//   table_offset.
+static u64 pfb__bundle_entry_extent(const Pixel_Font_Bundle_Entry* e) {
+    u64 metrics_size = pfb__bundle_metrics_size(e);
+    return metrics_size ? pfb__glyph_metrics_offset(e->table_size) + metrics_size : e->table_size;
+}
+
+Pixel_Font_Baker_Error write_pixel_font_bundle(const Pixel_Font_Bundle_Font* fonts, u32 font_count,
+                                               const char* out_path)
+{
+    pfb__Bundle_Item* items =
+        (pfb__Bundle_Item*)pfb__allocate((u64)max(font_count, 1u) * sizeof(pfb__Bundle_Item),
+                                         Pixel_Font_Allocation_Stage::SCRATCH);
+    if (!items)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    defer { pfb__deallocate(items, Pixel_Font_Allocation_Stage::SCRATCH); };
+
+    for (u32 i = 0; i < font_count; ++i) {
+        const Pixel_Font* font = fonts[i].font;
+        if (strlen(fonts[i].name) >= PIXEL_FONT_BUNDLE_NAME_LENGTH)
+            return Pixel_Font_Baker_Error::FONT_NAME_TOO_LONG;
+
+        Pixel_Font_Bundle_Entry& e = items[i].entry;
+        e = {};
+        strncpy(e.name, fonts[i].name, PIXEL_FONT_BUNDLE_NAME_LENGTH);
+        e.size             = fonts[i].size;
+        e.style            = fonts[i].style;
+        e.char_px_width    = font->char_px_width;
+        e.char_px_height   = font->char_px_height;
+        e.bytes_per_line   = font->bytes_per_line;
+        e.bytes_per_glyph  = font->bytes_per_glyph;
+        e.unicode_cp_start = font->unicode_cp_start;
+        e.unicode_cp_end   = font->unicode_cp_end;
+        e.flags            = font->glyph_metrics ? PIXEL_FONT_FILE_GLYPH_METRICS : 0;
+        e.cell_x           = font->cell_x;
+        e.baseline         = font->baseline;
+        e.line_height      = font->line_height;
+        e.table_size       = ((u64)font->unicode_cp_end - font->unicode_cp_start + 1) * font->bytes_per_glyph;
+        items[i].font = font;
+    }
+
+    qsort(items, font_count, sizeof(pfb__Bundle_Item), pfb__compare_bundle_items);
+
+    // NOTE: Table offsets are relative to data_offset first, which depends on
+    //   the number of block checksums, which depends on the data size.
+    u64 data_size = 0;
+    for (u32 i = 0; i < font_count; ++i) {
+        if (i > 0 && pfb__compare_bundle_items(&items[i - 1], &items[i]) == 0)
+            return Pixel_Font_Baker_Error::DUPLICATE_FONT_IN_BUNDLE;
+        items[i].entry.table_offset = data_size;
+        data_size = pfb__align_up(data_size + pfb__bundle_entry_extent(&items[i].entry), PIXEL_FONT_BUNDLE_ALIGNMENT);
+    }
+
+    Pixel_Font_Bundle_Header header = {};
+    memcpy(header.magic, PIXEL_FONT_BUNDLE_MAGIC, sizeof(header.magic));
+    header.version          = PIXEL_FONT_BUNDLE_VERSION;
+    header.header_size      = sizeof(Pixel_Font_Bundle_Header);
+    header.entry_count      = font_count;
+    header.entry_size       = sizeof(Pixel_Font_Bundle_Entry);
+    header.block_size       = PIXEL_FONT_BUNDLE_BLOCK_SIZE;
+    header.block_count      = (u32)((data_size + header.block_size - 1) / header.block_size);
+    header.checksums_offset = sizeof(Pixel_Font_Bundle_Header) + (u64)font_count * sizeof(Pixel_Font_Bundle_Entry);
+    header.data_offset      = pfb__align_up(header.checksums_offset + (u64)header.block_count * sizeof(u32),
+                                            PIXEL_FONT_BUNDLE_ALIGNMENT);
+    header.file_size        = header.data_offset + data_size;
+    for (u32 i = 0; i < font_count; ++i)
+        items[i].entry.table_offset += header.data_offset;
+
+    u32* checksums = (u32*)pfb__allocate((u64)max(header.block_count, 1u) * sizeof(u32),
+                                         Pixel_Font_Allocation_Stage::SCRATCH);
+    if (!checksums)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    defer { pfb__deallocate(checksums, Pixel_Font_Allocation_Stage::SCRATCH); };
+
+    // NOTE: Hands the data region (tables, their glyph metrics and the
+    //   padding between them) to piece in file order, first to checksum it,
+    //   then to write it.
+    static const u8 zeros[PIXEL_FONT_BUNDLE_ALIGNMENT] = {};
+    auto for_each_data_piece = [&](auto piece) -> bool {
+        u64 at = header.data_offset;
+        for (u32 i = 0; i < font_count; ++i) {
+            const Pixel_Font_Bundle_Entry& e = items[i].entry;
+            if (!piece(zeros, e.table_offset - at) || !piece(items[i].font->table, e.table_size))
+                return false;
+            u64 metrics_size = pfb__bundle_metrics_size(&e);
+            if (metrics_size &&
+                (!piece(zeros, pfb__glyph_metrics_offset(e.table_size) - e.table_size) ||
+                 !piece((const u8*)items[i].font->glyph_metrics, metrics_size)))
+            {
+                return false;
+            }
+            at = e.table_offset + pfb__bundle_entry_extent(&e);
+        }
+        return piece(zeros, header.file_size - at);
+    };
+
+    {
+        u32 block     = 0;
+        u64 block_end = header.data_offset + header.block_size;
+        u64 at        = header.data_offset;
+        u32 crc       = 0;
+        for_each_data_piece([&](const u8* bytes, u64 length) -> bool {
+            while (length > 0) {
+                u64 n = min(length, block_end - at);
+                crc = pfb__crc32c(crc, bytes, n);
+                bytes += n;
+                length -= n;
+                at += n;
+                if (at == block_end) {
+                    checksums[block++] = crc;
+                    crc        = 0;
+                    block_end += header.block_size;
+                }
+            }
+            return true;
+        });
+        if (block < header.block_count)
+            checksums[block] = crc;
+    }
+
+    header.metadata_crc = pfb__crc32c(0, (const u8*)&header, sizeof(header));
+    for (u32 i = 0; i < font_count; ++i)
+        header.metadata_crc = pfb__crc32c(header.metadata_crc, (const u8*)&items[i].entry, sizeof(Pixel_Font_Bundle_Entry));
+    header.metadata_crc = pfb__crc32c(header.metadata_crc, (const u8*)checksums, (u64)header.block_count * sizeof(u32));
+
+    pfb__Part_File out;
+    Pixel_Font_Baker_Error error = pfb__open_part_file(out_path, &out);
+    defer { pfb__close_part_file(&out); };
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+    FILE* out_file = out.file;
+
+    bool ok = fwrite(&header, sizeof(header), 1, out_file) == 1;
+    for (u32 i = 0; i < font_count && ok; ++i)
+        ok = fwrite(&items[i].entry, sizeof(Pixel_Font_Bundle_Entry), 1, out_file) == 1;
+
+    u64 padding = header.data_offset - header.checksums_offset - (u64)header.block_count * sizeof(u32);
+    ok = ok &&
+        fwrite(checksums, sizeof(u32), header.block_count, out_file) == header.block_count &&
+        fwrite(zeros, 1, padding, out_file) == padding &&
+        for_each_data_piece([&](const u8* bytes, u64 length) -> bool {
+            return fwrite(bytes, 1, length, out_file) == length;
+        });
+
+    if (!ok)
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+    return pfb__commit_part_file(&out, out_path);
+}
+
+// NOTE: Block states for Pixel_Font_Bundle_Verify::LAZY
+enum : u8 {
+    PFB__BLOCK_UNCHECKED = 0,
+    PFB__BLOCK_GOOD      = 1,
+    PFB__BLOCK_CORRUPT   = 2,
+};
+
+static bool pfb__bundle_block_is_good(const Pixel_Font_Bundle* bundle, u32 block) {
+    const Pixel_Font_Bundle_Header* header = bundle->header;
+    u64 begin = header->data_offset + (u64)block * header->block_size;
+    u64 end   = min(begin + header->block_size, header->file_size);
+    return pfb__crc32c(0, bundle->data + begin, end - begin) == bundle->block_checksums[block];
+}
+
+Pixel_Font_Baker_Error open_pixel_font_bundle(const char* bundle_path, Pixel_Font_Bundle* out_bundle,
+                                              Pixel_Font_Bundle_Verify verify)
+{
+    Pixel_Font_Bundle bundle = {};
+
+#if PIXEL_FONT_BAKER_MMAP
+    {
+        int fd = open(bundle_path, O_RDONLY);
+        if (fd < 0)
+            return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+        defer { close(fd); };
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+        if ((u64)st.st_size < sizeof(Pixel_Font_Bundle_Header))
+            return Pixel_Font_Baker_Error::BAKED_FONT_FILE_INVALID;
+
+        void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+            return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_OPENED;
+
+        bundle.data   = (const u8*)map;
+        bundle.size   = (u64)st.st_size;
+        bundle.mapped = true;
+    }
+#else
+    {
+        pfb__File_Contents contents;
+        Pixel_Font_Baker_Error error = pfb__read_file(bundle_path, &contents);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+
+        bundle.data   = (const u8*)contents.data;
+        bundle.size   = contents.length;
+        bundle.mapped = false;
+    }
+#endif
+
+    bool valid = bundle.size >= sizeof(Pixel_Font_Bundle_Header);
+    const Pixel_Font_Bundle_Header* header = (const Pixel_Font_Bundle_Header*)bundle.data;
+    valid = valid &&
+        memcmp(header->magic, PIXEL_FONT_BUNDLE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version     == PIXEL_FONT_BUNDLE_VERSION &&
+        header->header_size >= sizeof(Pixel_Font_Bundle_Header) && header->header_size % 8 == 0 &&
+        header->entry_size  >= sizeof(Pixel_Font_Bundle_Entry)  && header->entry_size  % 8 == 0 &&
+        header->file_size   == bundle.size &&
+        header->block_size  > 0 &&
+        header->data_offset % PIXEL_FONT_BUNDLE_ALIGNMENT == 0 && header->data_offset <= bundle.size &&
+        header->block_count == (bundle.size - header->data_offset + header->block_size - 1) / header->block_size &&
+        header->checksums_offset % sizeof(u32) == 0 &&
+        header->checksums_offset >= header->header_size + (u64)header->entry_count * header->entry_size &&
+        header->checksums_offset + (u64)header->block_count * sizeof(u32) <= header->data_offset;
+
+    // NOTE: Only the directory is checked, so opening does not page in any
+    //   table. A truncated file is caught by the file_size check above.
+    for (u32 i = 0; valid && i < header->entry_count; ++i) {
+        const Pixel_Font_Bundle_Entry* e =
+            (const Pixel_Font_Bundle_Entry*)(bundle.data + header->header_size + (u64)i * header->entry_size);
+        valid =
+            e->name[PIXEL_FONT_BUNDLE_NAME_LENGTH - 1] == '\0' &&
+            e->unicode_cp_end >= e->unicode_cp_start &&
+            e->bytes_per_line >= (e->char_px_width + 7u) / 8 &&
+            e->bytes_per_glyph >= e->bytes_per_line * e->char_px_height &&
+            e->table_size == ((u64)e->unicode_cp_end - e->unicode_cp_start + 1) * e->bytes_per_glyph &&
+            e->table_offset % PIXEL_FONT_BUNDLE_ALIGNMENT == 0 && e->table_offset >= header->data_offset &&
+            e->table_offset <= bundle.size && pfb__bundle_entry_extent(e) <= bundle.size - e->table_offset;
+
+        if (valid && i > 0) {
+            const Pixel_Font_Bundle_Entry* p = (const Pixel_Font_Bundle_Entry*)((const u8*)e - header->entry_size);
+            valid = pfb__compare_bundle_keys(p->name, p->size, p->style, e->name, e->size, e->style) < 0;
+        }
+    }
+
+    if (!valid) {
+        close_pixel_font_bundle(&bundle);
+        return Pixel_Font_Baker_Error::BAKED_FONT_FILE_INVALID;
+    }
+
+    bundle.header          = header;
+    bundle.entries         = (const Pixel_Font_Bundle_Entry*)(bundle.data + header->header_size);
+    bundle.block_checksums = (const u32*)(bundle.data + header->checksums_offset);
+
+    if (verify != Pixel_Font_Bundle_Verify::NONE) {
+        // NOTE: a few KiB even for big bundles, the tables are not touched
+        u32 zero = 0;
+        u64 crc_at = offsetof(Pixel_Font_Bundle_Header, metadata_crc);
+        u32 crc = pfb__crc32c(0, bundle.data, crc_at);
+        crc = pfb__crc32c(crc, (const u8*)&zero, sizeof(zero));
+        crc = pfb__crc32c(crc, bundle.data + crc_at + sizeof(zero), header->header_size - crc_at - sizeof(zero));
+        crc = pfb__crc32c(crc, (const u8*)bundle.entries, (u64)header->entry_count * header->entry_size);
+        crc = pfb__crc32c(crc, (const u8*)bundle.block_checksums, (u64)header->block_count * sizeof(u32));
+        valid = crc == header->metadata_crc;
+    }
+
+    if (valid && verify == Pixel_Font_Bundle_Verify::FULL) {
+        for (u32 block = 0; valid && block < header->block_count; ++block)
+            valid = pfb__bundle_block_is_good(&bundle, block);
+    }
+
+    if (valid && verify == Pixel_Font_Bundle_Verify::LAZY && header->block_count > 0) {
+        std::atomic<u8>* states = (std::atomic<u8>*)pfb__allocate((u64)header->block_count * sizeof(std::atomic<u8>),
+                                                                  Pixel_Font_Allocation_Stage::FONT_FILE);
+        if (!states) {
+            close_pixel_font_bundle(&bundle);
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+        }
+        for (u32 block = 0; block < header->block_count; ++block)
+            new (&states[block]) std::atomic<u8>(PFB__BLOCK_UNCHECKED);
+        bundle.block_states = states;
+    }
+
+    if (!valid) {
+        close_pixel_font_bundle(&bundle);
+        return Pixel_Font_Baker_Error::BAKED_FONT_FILE_CHECKSUM_MISMATCH;
+    }
+
+    *out_bundle = bundle;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error find_pixel_font_in_bundle(const Pixel_Font_Bundle* bundle, const char* name,
+                                                 u16 size, u16 style, Pixel_Font* out_font)
+{
+    u32 entry_size = bundle->header->entry_size;
+    u32 lo = 0;
+    u32 hi = bundle->header->entry_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        const Pixel_Font_Bundle_Entry* e =
+            (const Pixel_Font_Bundle_Entry*)((const u8*)bundle->entries + (u64)mid * entry_size);
+
+        int order = pfb__compare_bundle_keys(e->name, e->size, e->style, name, size, style);
+        if (order < 0) {
+            lo = mid + 1;
+        } else if (order > 0) {
+            hi = mid;
+        } else {
+            out_font->table             = (u8*)(bundle->data + e->table_offset);
+            out_font->glyph_metrics     = pfb__bundle_metrics_size(e)
+                ? (Pixel_Font_Glyph_Metrics*)(out_font->table + pfb__glyph_metrics_offset(e->table_size))
+                : nullptr;
+            out_font->cell_x            = e->cell_x;
+            out_font->baseline          = e->baseline;
+            out_font->line_height       = e->line_height;
+            out_font->char_px_width     = e->char_px_width;
+            out_font->char_px_height    = e->char_px_height;
+            out_font->bytes_per_line    = e->bytes_per_line;
+            out_font->bytes_per_glyph   = e->bytes_per_glyph;
+            out_font->unicode_cp_start  = e->unicode_cp_start;
+            out_font->unicode_cp_end    = e->unicode_cp_end;
+            out_font->table_is_borrowed = true;
+            return Pixel_Font_Baker_Error::SUCCESS;
+        }
+    }
+
+    return Pixel_Font_Baker_Error::FONT_NOT_IN_BUNDLE;
+}
+
+// NOTE: Checks the blocks holding the bytes [begin, end) of the bundle, each
+//   only the first time.
+static Pixel_Font_Baker_Error pfb__verify_bundle_range(const Pixel_Font_Bundle* bundle, u64 begin, u64 end) {
+    if (begin == end)
+        return Pixel_Font_Baker_Error::SUCCESS;
+
+    const Pixel_Font_Bundle_Header* header = bundle->header;
+    std::atomic<u8>* states = (std::atomic<u8>*)bundle->block_states;
+    u32 first_block = (u32)((begin   - header->data_offset) / header->block_size);
+    u32 last_block  = (u32)((end - 1 - header->data_offset) / header->block_size);
+    for (u32 block = first_block; block <= last_block; ++block) {
+        u8 state = states[block].load(std::memory_order_acquire);
+        if (state == PFB__BLOCK_UNCHECKED) {
+            // NOTE: two threads may both check the same block, they agree
+            state = pfb__bundle_block_is_good(bundle, block) ? PFB__BLOCK_GOOD : PFB__BLOCK_CORRUPT;
+            states[block].store(state, std::memory_order_release);
+        }
+        if (state == PFB__BLOCK_CORRUPT)
+            return Pixel_Font_Baker_Error::BAKED_FONT_FILE_CHECKSUM_MISMATCH;
+    }
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error verify_pixel_font_bundle_glyphs(const Pixel_Font_Bundle* bundle, const Pixel_Font* font,
+                                                       u32 cp_first, u32 cp_last)
+{
+    if (!bundle->block_states)
+        return Pixel_Font_Baker_Error::SUCCESS;
+
+    const Pixel_Font_Bundle_Header* header = bundle->header;
+    if (font->table < bundle->data + header->data_offset || font->table >= bundle->data + bundle->size)
+        return Pixel_Font_Baker_Error::FONT_NOT_IN_BUNDLE;
+
+    cp_first = max(cp_first, font->unicode_cp_start);
+    cp_last  = min(cp_last,  font->unicode_cp_end);
+    if (cp_first > cp_last)
+        return Pixel_Font_Baker_Error::SUCCESS;
+
+    u64 begin = (u64)(font->table - bundle->data) + (u64)(cp_first - font->unicode_cp_start) * font->bytes_per_glyph;
+    u64 end   = begin + ((u64)cp_last - cp_first + 1) * font->bytes_per_glyph;
+    Pixel_Font_Baker_Error error = pfb__verify_bundle_range(bundle, begin, end);
+    if (error != Pixel_Font_Baker_Error::SUCCESS || !font->glyph_metrics)
+        return error;
+
+    begin = (u64)((const u8*)font->glyph_metrics - bundle->data) +
+            (u64)(cp_first - font->unicode_cp_start) * sizeof(Pixel_Font_Glyph_Metrics);
+    end   = begin + ((u64)cp_last - cp_first + 1) * sizeof(Pixel_Font_Glyph_Metrics);
+    return pfb__verify_bundle_range(bundle, begin, end);
+}
+
+void close_pixel_font_bundle(Pixel_Font_Bundle* bundle) {
+    pfb__deallocate(bundle->block_states, Pixel_Font_Allocation_Stage::FONT_FILE);
+
+    if (!bundle->data) {
+        *bundle = {};
+        return;
+    }
+
+#if PIXEL_FONT_BAKER_MMAP
+    if (bundle->mapped)
+        munmap((void*)bundle->data, (size_t)bundle->size);
+    else
+#endif
+        pfb__deallocate((void*)bundle->data, Pixel_Font_Allocation_Stage::FONT_FILE);
+
+    *bundle = {};
+}
+
+Pixel_Font_Baker_Error write_pixel_font_as_c_source(const Pixel_Font* font, const char* name,
+                                                    const char* out_path)
+{
+    pfb__Part_File out;
+    Pixel_Font_Baker_Error error = pfb__open_part_file(out_path, &out);
+    defer { pfb__close_part_file(&out); };
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+    FILE* out_file = out.file;
+
+    fprintf(out_file,
+            "// %ux%u pixel font, codepoints U+%04X to U+%04X\n"
+            "#include \"fonts.h\"\n\n"
+            "const uint8_t %s_Table[] = {\n",
+            font->char_px_width, font->char_px_height,
+            font->unicode_cp_start, font->unicode_cp_end, name);
+
+    for (u32 cp = font->unicode_cp_start; cp <= font->unicode_cp_end; ++cp) {
+        const u8* glyph = font->table + (u64)(cp - font->unicode_cp_start) * font->bytes_per_glyph;
+        fprintf(out_file, "    // U+%04X\n", cp);
+        for (u32 row = 0; row < font->char_px_height; ++row) {
+            fprintf(out_file, "   ");
+            for (u32 col = 0; col < font->bytes_per_line; ++col)
+                fprintf(out_file, " 0x%02X,", glyph[row * font->bytes_per_line + col]);
+            fprintf(out_file, "\n");
+        }
+        if (cp == font->unicode_cp_end)
+            break;
+    }
+
+    fprintf(out_file,
+            "};\n\n"
+            "sFONT %s = {\n"
+            "    %s_Table,\n"
+            "    %u, /* Width */\n"
+            "    %u, /* Height */\n"
+            "};\n",
+            name, name, font->char_px_width, font->char_px_height);
+
+    // NOTE: sFONT has no room for them, so glyph metrics become arrays of
+    //   their own next to it.
+    if (font->glyph_metrics) {
+        fprintf(out_file,
+                "\n// advance, ink x, ink y, ink width, ink height of every glyph\n"
+                "const int16_t %s_Metrics[][5] = {\n",
+                name);
+        for (u32 cp = font->unicode_cp_start; cp <= font->unicode_cp_end; ++cp) {
+            const Pixel_Font_Glyph_Metrics* m = &font->glyph_metrics[cp - font->unicode_cp_start];
+            fprintf(out_file, "    { %d, %d, %d, %u, %u }, // U+%04X\n",
+                    m->advance, m->ink_x, m->ink_y, m->ink_width, m->ink_height, cp);
+            if (cp == font->unicode_cp_end)
+                break;
+        }
+        fprintf(out_file,
+                "};\n\n"
+                "const int16_t %s_Cell_X      = %d;\n"
+                "const int16_t %s_Baseline    = %d;\n"
+                "const int16_t %s_Line_Height = %d;\n",
+                name, font->cell_x, name, font->baseline, name, font->line_height);
+    }
+
+    if (ferror(out_file))
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+    return pfb__commit_part_file(&out, out_path);
+}
+
+static Pixel_Font_Baker_Error pfb__allocate_gfx_metrics(const Pixel_Font* font, Pixel_Font_Gfx_Metrics* out_metrics) {
+    *out_metrics = {};
+    out_metrics->x_advances =
+        (u8*)pfb__allocate((u64)font->unicode_cp_end - font->unicode_cp_start + 1, Pixel_Font_Allocation_Stage::TABLE);
+    if (!out_metrics->x_advances)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error pixel_font_gfx_metrics_from_ttf(const char* font_path, u16 char_height_in_px,
+                                                       const Pixel_Font* font, Pixel_Font_Gfx_Metrics* out_metrics)
+{
+    stbtt_fontinfo info;
+    u64 file_length;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_ttf(font_path, &info, &file_length);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    defer { pfb__free_ttf(&info); };
+
+    Pixel_Font_Baker_Error error = pfb__allocate_gfx_metrics(font, out_metrics);
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+
+    // NOTE: With a strike of that height (which create_pixel_font_from_ttf
+    //   uses by default) the baseline, the line height and the advances of
+    //   the glyphs it has come from the strike.
+    f32 font_scale;
+    s32 char_width_in_px;
+    s32 ascend;
+    pfb__Ttf_Strike strike;
+    bool has_strike = pfb__find_ttf_strike(info.data, file_length, (u32)info.fontstart, char_height_in_px, &strike);
+    if (has_strike)
+        pfb__strike_cell_size(&info, &strike, &font_scale, &char_width_in_px, &ascend);
+    else
+        pfb__ttf_cell_size(&info, char_height_in_px, &font_scale, &char_width_in_px, &ascend);
+
+    s32 ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&info, &ascent, &descent, &line_gap);
+
+    out_metrics->baseline  = ascend;
+    out_metrics->x_origin  = 0;
+    out_metrics->y_advance = has_strike
+        ? strike.ascender - strike.descender + (s32)(line_gap*font_scale + .5f)
+        : (s32)((ascent - descent + line_gap)*font_scale + .5f);
+
+    for (u32 cp = font->unicode_cp_start; ; ++cp) {
+        s32 advance;
+        stbtt_GetCodepointHMetrics(&info, cp, &advance, nullptr);
+        advance = (s32)(advance*font_scale + .5f);
+
+        pfb__Strike_Glyph g;
+        if (has_strike && pfb__strike_glyph(&strike, (u32)stbtt_FindGlyphIndex(&info, (s32)cp), &g))
+            advance = g.advance;
+
+        out_metrics->x_advances[cp - font->unicode_cp_start] = (u8)min(255, advance);
+        if (cp == font->unicode_cp_end)
+            break;
+    }
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+// NOTE: The baseline and the pen come from FONTBOUNDINGBOX, the advances
+//   from DWIDTH (the bounding box width for glyphs without one, or that are
+//   missing).
+Pixel_Font_Baker_Error pixel_font_gfx_metrics_from_bdf(const char* font_path, const Pixel_Font* font,
+                                                       Pixel_Font_Gfx_Metrics* out_metrics)
+{
+    pfb__File_Contents file_content;
+    {
+        Pixel_Font_Baker_Error error = pfb__read_font_file(font_path, &file_content);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+    defer { pfb__deallocate(file_content.data, Pixel_Font_Allocation_Stage::FONT_FILE); };
+
+    Pixel_Font_Baker_Error error = pfb__allocate_gfx_metrics(font, out_metrics);
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+
+    bool found_bounding_box = false;
+    s32  code_point = -1;
+    u64  glyph_count = (u64)font->unicode_cp_end - font->unicode_cp_start + 1;
+
+    const char* line = file_content.data;
+    const char* end  = file_content.data + file_content.length;
+    while (line < end) {
+        if (strncmp(line, "FONTBOUNDINGBOX ", 16) == 0) {
+            s32 width, height, x_offset, y_offset;
+            if (sscanf(line + 16, "%d %d %d %d", &width, &height, &x_offset, &y_offset) != 4)
+                break;
+            out_metrics->baseline  = height + y_offset;
+            out_metrics->x_origin  = x_offset;
+            out_metrics->y_advance = height;
+            memset(out_metrics->x_advances, (u8)max(0, min(255, width)), glyph_count);
+            found_bounding_box = true;
+        } else if (strncmp(line, "ENCODING ", 9) == 0) {
+            if (sscanf(line + 9, "%d", &code_point) != 1)
+                code_point = -1;
+        } else if (strncmp(line, "DWIDTH ", 7) == 0 && found_bounding_box &&
+                   code_point >= (s32)font->unicode_cp_start && code_point <= (s32)font->unicode_cp_end)
+        {
+            s32 advance;
+            if (sscanf(line + 7, "%d", &advance) == 1)
+                out_metrics->x_advances[code_point - font->unicode_cp_start] = (u8)max(0, min(255, advance));
+        }
+
+        const char* next = (const char*)memchr(line, '\n', end - line);
+        line = next ? next + 1 : end;
+    }
+
+    if (!found_bounding_box) {
+        destroy_pixel_font_gfx_metrics(out_metrics);
+        return Pixel_Font_Baker_Error::BDF_DID_NOT_SPECIFY_FONTBOUNDINGBOX;
+    }
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+void destroy_pixel_font_gfx_metrics(Pixel_Font_Gfx_Metrics* metrics) {
+    pfb__deallocate(metrics->x_advances, Pixel_Font_Allocation_Stage::TABLE);
+    *metrics = {};
+}
+
+static bool pfb__glyph_pixel(const Pixel_Font* font, const u8* glyph, u32 x, u32 y) {
+    return (glyph[y * font->bytes_per_line + x / 8] >> (7 - x % 8)) & 1;
+}
+
+// NOTE: The tight box around the set pixels of a glyph, empty (all zero) for
+//   blank glyphs. Bits past char_px_width are padding and ignored.
+static void pfb__glyph_ink_box(const Pixel_Font* font, const u8* glyph,
+                               u32* out_x, u32* out_y, u32* out_width, u32* out_height)
+{
+    u32 x_begin = font->char_px_width,  x_end = 0;
+    u32 y_begin = font->char_px_height, y_end = 0;
+    for (u32 y = 0; y < font->char_px_height; ++y) {
+        for (u32 x = 0; x < font->char_px_width; ++x) {
+            if (!pfb__glyph_pixel(font, glyph, x, y))
+                continue;
+            x_begin = min(x_begin, x);
+            x_end   = max(x_end,   x + 1);
+            y_begin = min(y_begin, y);
+            y_end   = max(y_end,   y + 1);
+        }
+    }
+
+    if (x_end == 0) {
+        *out_x = *out_y = *out_width = *out_height = 0;
+        return;
+    }
+    *out_x      = x_begin;
+    *out_y      = y_begin;
+    *out_width  = x_end - x_begin;
+    *out_height = y_end - y_begin;
+}
+
+Pixel_Font_Baker_Error write_pixel_font_as_adafruit_gfx(const Pixel_Font* font, const Pixel_Font_Gfx_Metrics* metrics,
+                                                        const char* name, const char* out_path)
+{
+    if (font->unicode_cp_end > 0xFFFF)
+        return Pixel_Font_Baker_Error::FONT_TOO_LARGE_FOR_GFX;
+
+    const Pixel_Font_Glyph_Metrics* glyph_metrics = metrics ? nullptr : font->glyph_metrics;
+
+    s32 baseline  = metrics ? metrics->baseline  : (s32)font->char_px_height;
+    s32 x_origin  = metrics ? metrics->x_origin  : 0;
+    s32 y_advance = metrics ? metrics->y_advance : (s32)font->char_px_height;
+    if (glyph_metrics) {
+        baseline  = font->baseline;
+        x_origin  = font->cell_x;
+        y_advance = font->line_height;
+    }
+    if (y_advance > 255 || (!metrics && !glyph_metrics && font->char_px_width > 255))
+        return Pixel_Font_Baker_Error::FONT_TOO_LARGE_FOR_GFX;
+
+    // NOTE: First pass: boxes and bitmap offsets, so the size limits are
+    //   checked before anything is written.
+    struct Glyph_Box {
+        u32 offset;
+        u32 x, y, width, height;
+    };
+    u64 glyph_count = (u64)font->unicode_cp_end - font->unicode_cp_start + 1;
+    Glyph_Box* boxes = (Glyph_Box*)pfb__allocate(glyph_count * sizeof(Glyph_Box), Pixel_Font_Allocation_Stage::SCRATCH);
+    if (!boxes)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    defer { pfb__deallocate(boxes, Pixel_Font_Allocation_Stage::SCRATCH); };
+
+    u64 bitmap_size = 0;
+    for (u64 i = 0; i < glyph_count; ++i) {
+        Glyph_Box* box = &boxes[i];
+        pfb__glyph_ink_box(font, font->table + i * font->bytes_per_glyph, &box->x, &box->y, &box->width, &box->height);
+        box->offset = (u32)bitmap_size;
+        bitmap_size += ((u64)box->width * box->height + 7) / 8;
+
+        s32 x_offset = x_origin + (s32)box->x;
+        s32 y_offset = (s32)box->y - baseline;
+        if (box->width > 255 || box->height > 255 || x_offset < -128 || x_offset > 127 ||
+            y_offset < -128 || y_offset > 127 || box->offset > 0xFFFF)
+        {
+            return Pixel_Font_Baker_Error::FONT_TOO_LARGE_FOR_GFX;
+        }
+    }
+
+    pfb__Part_File out;
+    Pixel_Font_Baker_Error error = pfb__open_part_file(out_path, &out);
+    defer { pfb__close_part_file(&out); };
+    if (error != Pixel_Font_Baker_Error::SUCCESS)
+        return error;
+    FILE* out_file = out.file;
+
+    fprintf(out_file,
+            "// %ux%u pixel font, codepoints U+%04X to U+%04X, Adafruit GFX format\n"
+            "#pragma once\n"
+            "#include <Adafruit_GFX.h>\n\n"
+            "const uint8_t %sBitmaps[] PROGMEM = {\n",
+            font->char_px_width, font->char_px_height,
+            font->unicode_cp_start, font->unicode_cp_end, name);
+
+    // NOTE: The rows of a glyph follow each other bit by bit, MSB first, only
+    //   the last byte of every glyph is padded.
+    u32 bytes_in_line = 0;
+    auto emit_byte = [&](u8 byte) -> void {
+        fprintf(out_file, bytes_in_line == 0 ? "    0x%02X," : " 0x%02X,", byte);
+        if (++bytes_in_line == 12) {
+            fprintf(out_file, "\n");
+            bytes_in_line = 0;
+        }
+    };
+
+    for (u64 i = 0; i < glyph_count; ++i) {
+        const Glyph_Box* box   = &boxes[i];
+        const u8*        glyph = font->table + i * font->bytes_per_glyph;
+        u8  byte      = 0;
+        u32 bit_count = 0;
+        for (u32 y = box->y; y < box->y + box->height; ++y) {
+            for (u32 x = box->x; x < box->x + box->width; ++x) {
+                byte = (u8)(byte << 1 | pfb__glyph_pixel(font, glyph, x, y));
+                if (++bit_count % 8 == 0) {
+                    emit_byte(byte);
+                    byte = 0;
+                }
+            }
+        }
+        if (bit_count % 8 != 0)
+            emit_byte((u8)(byte << (8 - bit_count % 8)));
+    }
+    // NOTE: C does not allow empty arrays
+    if (bitmap_size == 0)
+        emit_byte(0);
+    if (bytes_in_line != 0)
+        fprintf(out_file, "\n");
+
+    fprintf(out_file,
+            "};\n\n"
+            "const GFXglyph %sGlyphs[] PROGMEM = {\n",
+            name);
+
+    for (u64 i = 0; i < glyph_count; ++i) {
+        const Glyph_Box* box = &boxes[i];
+        u32 cp = font->unicode_cp_start + (u32)i;
+        u32 x_advance = metrics ? metrics->x_advances[i] : font->char_px_width;
+        if (glyph_metrics)
+            x_advance = (u32)max(0, min(255, (s32)glyph_metrics[i].advance));
+        fprintf(out_file, "    { %5u, %3u, %3u, %3u, %4d, %4d }, // U+%04X\n",
+                box->offset, box->width, box->height, x_advance,
+                x_origin + (s32)box->x, (s32)box->y - baseline, cp);
+    }
+
+    fprintf(out_file,
+            "};\n\n"
+            "const GFXfont %s PROGMEM = {\n"
+            "    (uint8_t  *)%sBitmaps,\n"
+            "    (GFXglyph *)%sGlyphs,\n"
+            "    0x%04X, 0x%04X, %d\n"
+            "};\n\n"
+            "// %llu bytes of bitmaps, %llu bytes of glyphs\n",
+            name, name, name, font->unicode_cp_start, font->unicode_cp_end, y_advance,
+            (unsigned long long)bitmap_size, (unsigned long long)glyph_count * 7);
+
+    if (ferror(out_file))
+        return Pixel_Font_Baker_Error::FONT_FILE_COULD_NOT_BE_WRITTEN;
+
+    return pfb__commit_part_file(&out, out_path);
+}
+
+u32 pixel_font_decode_utf8(const char** cursor) {
+    const u8* c = (const u8*)*cursor;
+
+    u32 length;
+    u32 cp;
+    if      (c[0] < 0x80)           { *cursor += 1; return c[0]; }
+    else if ((c[0] & 0xe0) == 0xc0) { length = 2; cp = c[0] & 0x1f; }
+    else if ((c[0] & 0xf0) == 0xe0) { length = 3; cp = c[0] & 0x0f; }
+    else if ((c[0] & 0xf8) == 0xf0) { length = 4; cp = c[0] & 0x07; }
+    else                            { *cursor += 1; return 0xfffd; }
+
+    for (u32 i = 1; i < length; ++i) {
+        if ((c[i] & 0xc0) != 0x80) {
+            *cursor += 1;
+            return 0xfffd;
+        }
+        cp = (cp << 6) | (c[i] & 0x3f);
+    }
+
+    // NOTE: reject overlong encodings, surrogates and everything past U+10FFFF
+    static const u32 min_cp[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (cp < min_cp[length] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        *cursor += 1;
+        return 0xfffd;
+    }
+
+    *cursor += length;
+    return cp;
+}
+
+void pixel_font_draw_glyph(Pixel_Font_Framebuffer* fb, const Pixel_Font* font, u32 code_point, s32 x, s32 y) {
+    if (code_point < font->unicode_cp_start || code_point > font->unicode_cp_end)
+        return;
+
+    s32 width  = font->char_px_width;
+    s32 height = font->char_px_height;
+
+    s32 col_begin = max(0, -x);
+    s32 col_end   = min(width,  (s32)fb->width  - x);
+    s32 row_begin = max(0, -y);
+    s32 row_end   = min(height, (s32)fb->height - y);
+    if (col_begin >= col_end || row_begin >= row_end)
+        return;
+
+    const u8* glyph = font->table + (u64)(code_point - font->unicode_cp_start) * font->bytes_per_glyph;
+
+    // NOTE: Rows that are one aligned word (the word row layout, but also
+    //   packed fonts up to 16 px wide) take the single load blitter.
+    u32 bytes_per_line = font->bytes_per_line;
+    bool word_rows =
+        (bytes_per_line == 1 || bytes_per_line == 2 || bytes_per_line == 4 || bytes_per_line == 8) &&
+        ((uintptr_t)glyph % bytes_per_line) == 0;
+
+    if (word_rows) {
+        for (s32 row = row_begin; row < row_end; ++row) {
+            pfb__blit_row_word(fb->data + (u64)(y + row) * fb->stride, fb->stride, x,
+                               glyph + row * bytes_per_line, bytes_per_line, col_begin, col_end);
+        }
+        return;
+    }
+
+    for (s32 row = row_begin; row < row_end; ++row) {
+        pfb__blit_row(fb->data + (u64)(y + row) * fb->stride, x,
+                      glyph + row * bytes_per_line, col_begin, col_end);
+    }
+}
+
+u32 pixel_font_draw_string(Pixel_Font_Framebuffer* fb, const Pixel_Font* font, const char* utf8, s32 x, s32 y) {
+    u32 drawn  = 0;
+    s32 cursor = x;
+
+    while (*utf8) {
+        u32 cp = (u8)*utf8 < 0x80 ? (u8)*utf8++ : pixel_font_decode_utf8(&utf8);
+        if (cp == '\n') {
+            cursor = x;
+            y += font->char_px_height;
+            continue;
+        }
+
+        if (cp >= font->unicode_cp_start && cp <= font->unicode_cp_end) {
+            pixel_font_draw_glyph(fb, font, cp, cursor, y);
+            ++drawn;
+        }
+        cursor += font->char_px_width;
+    }
+
+    return drawn;
+}
+
+Pixel_Font_Baker_Error pixel_font_draw_list_add(Pixel_Font_Draw_List* list, const Pixel_Font* font,
+                                                const char* utf8, s32 x, s32 y)
+{
+    if (list->run_count == list->run_capacity) {
+        u32 capacity = max(64u, list->run_capacity * 2);
+        Pixel_Font_Draw_Run* runs =
+            (Pixel_Font_Draw_Run*)pfb__allocate((u64)capacity * sizeof(Pixel_Font_Draw_Run),
+                                                Pixel_Font_Allocation_Stage::SCRATCH);
+        if (!runs)
+            return Pixel_Font_Baker_Error::MALLOC_FAILED;
+        if (list->run_count)
+            memcpy(runs, list->runs, (u64)list->run_count * sizeof(Pixel_Font_Draw_Run));
+        pfb__deallocate(list->runs, Pixel_Font_Allocation_Stage::SCRATCH);
+        list->runs         = runs;
+        list->run_capacity = capacity;
+    }
+
+    // NOTE: A codepoint takes at least one byte, so bytes per line bound
+    //   the width without decoding.
+    u64 lines     = 1;
+    u64 max_bytes = 0;
+    const char* line = utf8;
+    while (const char* end = strchr(line, '\n')) {
+        max_bytes = max(max_bytes, (u64)(end - line));
+        line = end + 1;
+        ++lines;
+    }
+    max_bytes = max(max_bytes, (u64)strlen(line));
+
+    Pixel_Font_Draw_Run* run = &list->runs[list->run_count++];
+    run->font     = font;
+    run->utf8     = utf8;
+    run->x        = x;
+    run->y        = y;
+    run->right    = (s32)min((s64)x + (s64)(max_bytes * font->char_px_width), (s64)0x7fffffff);
+    run->bottom   = (s32)min((s64)y + (s64)(lines * font->char_px_height), (s64)0x7fffffff);
+    run->sort_key = 0;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+static int pfb__compare_draw_runs(const void* a, const void* b) {
+    u64 x = ((const Pixel_Font_Draw_Run*)a)->sort_key;
+    u64 y = ((const Pixel_Font_Draw_Run*)b)->sort_key;
+    return x < y ? -1 : x > y;
+}
+
+// NOTE: pixel_font_draw_string for a run that is known to touch the
+//   framebuffer: lines above or below it and the part of a line right of
+//   it are skipped without decoding, glyphs left of it without drawing.
+static u32 pfb__draw_run(Pixel_Font_Framebuffer* fb, const Pixel_Font_Draw_Run* run) {
+    const Pixel_Font* font = run->font;
+    s32 width  = font->char_px_width;
+    s32 height = font->char_px_height;
+
+    u32 drawn = 0;
+    s32 y     = run->y;
+    const char* utf8 = run->utf8;
+    while (*utf8) {
+        if (y >= (s32)fb->height)
+            break;
+
+        bool line_visible = y + height > 0;
+        s32  cursor       = run->x;
+        while (*utf8 && *utf8 != '\n') {
+            if (!line_visible || cursor >= (s32)fb->width) {
+                const char* end = strchr(utf8, '\n');
+                utf8 = end ? end : utf8 + strlen(utf8);
+                break;
+            }
+
+            u32 cp = (u8)*utf8 < 0x80 ? (u8)*utf8++ : pixel_font_decode_utf8(&utf8);
+            if (cp >= font->unicode_cp_start && cp <= font->unicode_cp_end && cursor + width > 0) {
+                pixel_font_draw_glyph(fb, font, cp, cursor, y);
+                ++drawn;
+            }
+            cursor += width;
+        }
+
+        if (*utf8 == '\n') {
+            ++utf8;
+            y += height;
+        }
+    }
+
+    return drawn;
+}
+
+// NOTE: Bands of this many rows are drawn one after the other, so the
+//   framebuffer rows of a band stay in the cache while its runs are drawn.
+#define PFB__DRAW_LIST_BAND_ROWS 16
+
+u32 pixel_font_draw_list_render(Pixel_Font_Framebuffer* fb, Pixel_Font_Draw_List* list) {
+    // NOTE: Runs that are off screen sort after all others and are not
+    //   drawn.
+    u32 culled = 0;
+    for (u32 i = 0; i < list->run_count; ++i) {
+        Pixel_Font_Draw_Run* run = &list->runs[i];
+        if (run->right <= 0 || run->bottom <= 0 || run->x >= (s32)fb->width || run->y >= (s32)fb->height) {
+            run->sort_key = ~(u64)0;
+            ++culled;
+            continue;
+        }
+
+        u64 band = (u64)max(0, run->y) / PFB__DRAW_LIST_BAND_ROWS;
+        run->sort_key = band << 32 | (u64)max(0, run->x);
+    }
+    list->culled_runs = culled;
+
+    qsort(list->runs, list->run_count, sizeof(Pixel_Font_Draw_Run), pfb__compare_draw_runs);
+
+    u32 drawn = 0;
+    for (u32 i = 0; i < list->run_count - culled; ++i)
+        drawn += pfb__draw_run(fb, &list->runs[i]);
+
+    return drawn;
+}
+
+void pixel_font_draw_list_clear(Pixel_Font_Draw_List* list) {
+    list->run_count   = 0;
+    list->culled_runs = 0;
+}
+
+void destroy_pixel_font_draw_list(Pixel_Font_Draw_List* list) {
+    pfb__deallocate(list->runs, Pixel_Font_Allocation_Stage::SCRATCH);
+    *list = {};
+}
+
+// NOTE: A cached string: this header, the bitmap (height rows of stride
+//   bytes, a multiple of 8) and the text, in one allocation.
+struct pfb__String_Cache_Entry {
+    u64 hash;
+    const Pixel_Font* font;
+    const u8* table;
+    pfb__String_Cache_Entry* next_in_bucket;
+    pfb__String_Cache_Entry* newer;
+    pfb__String_Cache_Entry* older;
+    u64 size;
+    u32 text_length;
+    u32 width;
+    u32 height;
+    u32 stride;
+    u32 glyphs;
+};
+
+static u8* pfb__string_cache_bitmap(pfb__String_Cache_Entry* entry) {
+    return (u8*)(entry + 1);
+}
+
+static const char* pfb__string_cache_text(pfb__String_Cache_Entry* entry) {
+    return (const char*)(entry + 1) + (u64)entry->stride * entry->height;
+}
+
+// NOTE: FNV-1a over the text, then the font's address and table mixed in.
+static u64 pfb__string_cache_hash(const char* utf8, u64 length, const Pixel_Font* font) {
+    u64 hash = 0xcbf29ce484222325ull;
+    for (u64 i = 0; i < length; ++i)
+        hash = (hash ^ (u8)utf8[i]) * 0x100000001b3ull;
+    hash ^= (u64)(uintptr_t)font * 0x9e3779b97f4a7c15ull;
+    hash ^= (u64)(uintptr_t)font->table * 0xc2b2ae3d27d4eb4full;
+    return hash ^ (hash >> 29);
+}
+
+static void pfb__string_cache_unlink_lru(Pixel_Font_String_Cache* cache, pfb__String_Cache_Entry* entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else              cache->newest       = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else              cache->oldest       = entry->newer;
+    entry->newer = entry->older = nullptr;
+}
+
+static void pfb__string_cache_push_newest(Pixel_Font_String_Cache* cache, pfb__String_Cache_Entry* entry) {
+    pfb__String_Cache_Entry* newest = (pfb__String_Cache_Entry*)cache->newest;
+    entry->newer = nullptr;
+    entry->older = newest;
+    if (newest) newest->newer = entry;
+    else        cache->oldest = entry;
+    cache->newest = entry;
+}
+
+static void pfb__string_cache_remove(Pixel_Font_String_Cache* cache, pfb__String_Cache_Entry* entry) {
+    pfb__String_Cache_Entry** link =
+        &((pfb__String_Cache_Entry**)cache->buckets)[entry->hash & (cache->bucket_count - 1)];
+    while (*link != entry)
+        link = &(*link)->next_in_bucket;
+    *link = entry->next_in_bucket;
+
+    pfb__string_cache_unlink_lru(cache, entry);
+    cache->stats.bytes -= entry->size;
+    cache->stats.entries -= 1;
+    pfb__deallocate(entry, Pixel_Font_Allocation_Stage::CACHE);
+}
+
+Pixel_Font_Baker_Error create_pixel_font_string_cache(u64 budget_bytes, Pixel_Font_String_Cache* out_cache) {
+    // NOTE: One chain per 256 bytes of budget, short labels take about that.
+    u32 bucket_count = 64;
+    while (bucket_count < (1u << 20) && (u64)bucket_count * 256 < budget_bytes)
+        bucket_count *= 2;
+
+    void* buckets = pfb__allocate((u64)bucket_count * sizeof(pfb__String_Cache_Entry*),
+                                  Pixel_Font_Allocation_Stage::CACHE);
+    if (!buckets)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    memset(buckets, 0, (u64)bucket_count * sizeof(pfb__String_Cache_Entry*));
+
+    *out_cache = {};
+    out_cache->budget_bytes = budget_bytes;
+    out_cache->buckets      = buckets;
+    out_cache->bucket_count = bucket_count;
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+// NOTE: Renders the string into a new entry, nullptr if it does not fit
+//   into the budget or there is no memory.
+static pfb__String_Cache_Entry* pfb__string_cache_render(Pixel_Font_String_Cache* cache, const Pixel_Font* font,
+                                                         const char* utf8, u64 length, u64 hash)
+{
+    // NOTE: Every codepoint advances the pen, also those the font lacks.
+    u64 lines = 1, columns = 0, max_columns = 0;
+    for (const char* c = utf8; *c;) {
+        u32 cp = (u8)*c < 0x80 ? (u8)*c++ : pixel_font_decode_utf8(&c);
+        if (cp == '\n') {
+            ++lines;
+            columns = 0;
+        } else {
+            max_columns = max(max_columns, ++columns);
+        }
+    }
+
+    // NOTE: Rows are whole 64-bit words, so they are drawn a word at a time.
+    u64 width  = max_columns * font->char_px_width;
+    u64 height = lines * font->char_px_height;
+    u64 stride = (width + 63) / 64 * 8;
+    u64 size   = sizeof(pfb__String_Cache_Entry) + stride * height + length;
+    if (size > cache->budget_bytes || width > 0xffffffffull || height > 0xffffffffull)
+        return nullptr;
+
+    while (cache->stats.bytes + size > cache->budget_bytes) {
+        pfb__string_cache_remove(cache, (pfb__String_Cache_Entry*)cache->oldest);
+        cache->stats.evictions += 1;
+    }
+
+    pfb__String_Cache_Entry* entry =
+        (pfb__String_Cache_Entry*)pfb__allocate(size, Pixel_Font_Allocation_Stage::CACHE);
+    if (!entry)
+        return nullptr;
+
+    *entry = {};
+    entry->hash        = hash;
+    entry->font        = font;
+    entry->table       = font->table;
+    entry->size        = size;
+    entry->text_length = (u32)length;
+    entry->width       = (u32)width;
+    entry->height      = (u32)height;
+    entry->stride      = (u32)stride;
+
+    u8* bitmap = pfb__string_cache_bitmap(entry);
+    memset(bitmap, 0, stride * height);
+    memcpy(bitmap + stride * height, utf8, length);
+
+    Pixel_Font_Framebuffer target = { bitmap, (u32)width, (u32)height, (u32)stride };
+    entry->glyphs = pixel_font_draw_string(&target, font, utf8, 0, 0);
+
+    pfb__String_Cache_Entry** bucket =
+        &((pfb__String_Cache_Entry**)cache->buckets)[hash & (cache->bucket_count - 1)];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    pfb__string_cache_push_newest(cache, entry);
+    cache->stats.bytes   += size;
+    cache->stats.entries += 1;
+
+    return entry;
+}
+
+u32 pixel_font_draw_string_cached(Pixel_Font_String_Cache* cache, Pixel_Font_Framebuffer* fb,
+                                  const Pixel_Font* font, const char* utf8, s32 x, s32 y)
+{
+    u64 length = strlen(utf8);
+    u64 hash   = pfb__string_cache_hash(utf8, length, font);
+
+    pfb__String_Cache_Entry* entry = ((pfb__String_Cache_Entry**)cache->buckets)[hash & (cache->bucket_count - 1)];
+    while (entry && !(entry->hash == hash && entry->font == font && entry->table == font->table &&
+                      entry->text_length == length && memcmp(pfb__string_cache_text(entry), utf8, length) == 0))
+    {
+        entry = entry->next_in_bucket;
+    }
+
+    if (entry) {
+        cache->stats.hits += 1;
+        pfb__string_cache_unlink_lru(cache, entry);
+        pfb__string_cache_push_newest(cache, entry);
+    } else {
+        cache->stats.misses += 1;
+        entry = length <= 0xffffffffull ? pfb__string_cache_render(cache, font, utf8, length, hash) : nullptr;
+        if (!entry) {
+            cache->stats.uncached += 1;
+            return pixel_font_draw_string(fb, font, utf8, x, y);
+        }
+    }
+
+    s32 col_begin = max(0, -x);
+    s32 col_end   = (s32)min((s64)entry->width,  (s64)fb->width  - x);
+    s32 row_begin = max(0, -y);
+    s32 row_end   = (s32)min((s64)entry->height, (s64)fb->height - y);
+    const u8* bitmap = pfb__string_cache_bitmap(entry);
+    for (s32 row = row_begin; col_begin < col_end && row < row_end; ++row) {
+        u8*       dst = fb->data + (u64)(y + row) * fb->stride;
+        const u8* src = bitmap + (u64)row * entry->stride;
+        for (s32 word = col_begin / 64; word * 64 < col_end; ++word) {
+            s32 c0 = word * 64;
+            pfb__blit_row_word(dst, fb->stride, x + c0, src + word * 8, 8,
+                               max(col_begin - c0, 0), min(col_end - c0, 64));
+        }
+    }
+
+    return entry->glyphs;
+}
+
+void pixel_font_string_cache_clear(Pixel_Font_String_Cache* cache) {
+    while (cache->oldest)
+        pfb__string_cache_remove(cache, (pfb__String_Cache_Entry*)cache->oldest);
+}
+
+void destroy_pixel_font_string_cache(Pixel_Font_String_Cache* cache) {
+    if (cache->buckets)
+        pixel_font_string_cache_clear(cache);
+    pfb__deallocate(cache->buckets, Pixel_Font_Allocation_Stage::CACHE);
+    *cache = {};
+}
+
+void pixel_font_framebuffer_to_2bpp(const Pixel_Font_Framebuffer* fb, u8 foreground, u8 background,
+                                    u8* out_data, u32 out_stride)
+{
+    for (u32 row = 0; row < fb->height; ++row) {
+        pfb__expand_row_2bpp(fb->data + (u64)row * fb->stride, fb->width, foreground, background,
+                             out_data + (u64)row * out_stride);
+    }
+}
+
+void pixel_font_framebuffer_to_4bpp(const Pixel_Font_Framebuffer* fb, u8 foreground, u8 background,
+                                    u8* out_data, u32 out_stride)
+{
+    for (u32 row = 0; row < fb->height; ++row) {
+        pfb__expand_row_4bpp(fb->data + (u64)row * fb->stride, fb->width, foreground, background,
+                             out_data + (u64)row * out_stride);
+    }
+}
+
+Pixel_Font_Baker_Error create_pixel_font_with_row_layout(const Pixel_Font* font, u32 row_word_bytes,
+                                                         u32 glyph_alignment, Pixel_Font* out_font)
+{
+    u32 bytes_per_line;
+    u32 bytes_per_glyph;
+    {
+        Pixel_Font_Baker_Error error = pfb__row_layout(font->char_px_width, font->char_px_height,
+                                                       row_word_bytes, glyph_alignment,
+                                                       &bytes_per_line, &bytes_per_glyph);
+        if (error != Pixel_Font_Baker_Error::SUCCESS)
+            return error;
+    }
+
+    u64 glyph_count  = (u64)font->unicode_cp_end - font->unicode_cp_start + 1;
+    u64 table_size   = glyph_count * bytes_per_glyph;
+    u64 metrics_size = font->glyph_metrics ? glyph_count * sizeof(Pixel_Font_Glyph_Metrics) : 0;
+    u64 block_size   = metrics_size ? pfb__glyph_metrics_offset(table_size) + metrics_size : table_size;
+    u8* table = pfb__allocate_table(block_size, pixel_font_table_pages(font));
+    if (!table)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    memset(table, 0, block_size);
+
+    u32 row_bytes = min(font->bytes_per_line, bytes_per_line);
+    for (u64 i = 0; i < glyph_count; ++i) {
+        const u8* src = font->table + i * font->bytes_per_glyph;
+        u8*       dst = table + i * bytes_per_glyph;
+        for (u32 row = 0; row < font->char_px_height; ++row)
+            memcpy(dst + row * bytes_per_line, src + row * font->bytes_per_line, row_bytes);
+    }
+
+    *out_font = *font;
+    out_font->glyph_metrics = nullptr;
+    if (metrics_size) {
+        out_font->glyph_metrics = (Pixel_Font_Glyph_Metrics*)(table + pfb__glyph_metrics_offset(table_size));
+        memcpy(out_font->glyph_metrics, font->glyph_metrics, metrics_size);
+    }
+    out_font->table             = table;
+    out_font->bytes_per_line    = bytes_per_line;
+    out_font->bytes_per_glyph   = bytes_per_glyph;
+    out_font->table_is_borrowed = false;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error measure_pixel_font_layouts(const Pixel_Font* font, Pixel_Font_Size_Estimate* out_measured) {
+    Pixel_Font_Size_Estimate e = {};
+    e.char_px_width   = font->char_px_width;
+    e.char_px_height  = font->char_px_height;
+    e.glyphs_in_range = (u64)font->unicode_cp_end - font->unicode_cp_start + 1;
+
+    // NOTE: The layouts are measured with packed rows, whatever rows the
+    //   font has now. Only the packed bytes of a row are compared, the rest
+    //   of a word row is padding.
+    u32 row_bytes = (font->char_px_width + 7) / 8;
+    e.bytes_per_glyph = row_bytes * font->char_px_height;
+
+    // NOTE: (hash, glyph index) of every glyph, sorted by hash. Glyphs with
+    //   equal hashes are compared byte for byte, so the count is exact.
+    struct Glyph_Hash {
+        u64 hash;
+        u64 index;
+    };
+    Glyph_Hash* hashes = (Glyph_Hash*)pfb__allocate(e.glyphs_in_range * sizeof(Glyph_Hash),
+                                                    Pixel_Font_Allocation_Stage::SCRATCH);
+    if (!hashes)
+        return Pixel_Font_Baker_Error::MALLOC_FAILED;
+    defer { pfb__deallocate(hashes, Pixel_Font_Allocation_Stage::SCRATCH); };
+
+    bool previous_covered = false;
+    for (u64 i = 0; i < e.glyphs_in_range; ++i) {
+        const u8* glyph = font->table + i * font->bytes_per_glyph;
+
+        u32 x, y, w, h;
+        pfb__glyph_ink_box(font, glyph, &x, &y, &w, &h);
+        bool covered = w > 0;
+        e.glyphs_covered += covered;
+        e.covered_runs   += covered && !previous_covered;
+        previous_covered  = covered;
+        e.ink_bytes      += ((u64)w * h + 7) / 8;
+
+        u32 hash = 0;
+        for (u32 row = 0; row < font->char_px_height; ++row)
+            hash = pfb__crc32c(hash, glyph + row * font->bytes_per_line, row_bytes);
+        hashes[i] = { hash, i };
+    }
+
+    qsort(hashes, e.glyphs_in_range, sizeof(Glyph_Hash), pfb__compare_u64);
+
+    auto same_glyph = [&](u64 a, u64 b) -> bool {
+        const u8* glyph_a = font->table + a * font->bytes_per_glyph;
+        const u8* glyph_b = font->table + b * font->bytes_per_glyph;
+        for (u32 row = 0; row < font->char_px_height; ++row) {
+            if (memcmp(glyph_a + row * font->bytes_per_line, glyph_b + row * font->bytes_per_line, row_bytes) != 0)
+                return false;
+        }
+        return true;
+    };
+
+    // NOTE: Within a run of equal hashes, a glyph is new if it differs from
+    //   every earlier glyph of the run that was new. Runs are tiny unless
+    //   the glyphs are all the same, then the first one matches.
+    for (u64 run_begin = 0; run_begin < e.glyphs_in_range;) {
+        u64 run_end = run_begin + 1;
+        while (run_end < e.glyphs_in_range && hashes[run_end].hash == hashes[run_begin].hash)
+            ++run_end;
+
+        u64 distinct_end = run_begin;
+        for (u64 i = run_begin; i < run_end; ++i) {
+            bool seen = false;
+            for (u64 j = run_begin; j < distinct_end && !seen; ++j)
+                seen = same_glyph(hashes[j].index, hashes[i].index);
+            if (!seen)
+                hashes[distinct_end++].index = hashes[i].index;
+        }
+        e.unique_glyphs += distinct_end - run_begin;
+        run_begin = run_end;
+    }
+
+    pfb__layout_sizes(&e);
+    *out_measured = e;
+
+    return Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Baker_Error choose_pixel_font_layout(const Pixel_Font* font, u64 budget_bytes,
+                                                Pixel_Font_Layout_Preference preference,
+                                                Pixel_Font_Layout_Choice* out_choice)
+{
+    Pixel_Font_Layout_Choice choice = {};
+    u64 glyph_count = (u64)font->unicode_cp_end - font->unicode_cp_start + 1;
+
+    u32 bytes_per_line;
+    u32 bytes_per_glyph;
+    u32 word_bytes = pfb__row_word_bytes((font->char_px_width + 7) / 8);
+    if (word_bytes &&
+        pfb__row_layout(font->char_px_width, font->char_px_height, word_bytes, 64,
+                        &bytes_per_line, &bytes_per_glyph) == Pixel_Font_Baker_Error::SUCCESS)
+    {
+        choice.layout_bytes[(u32)Pixel_Font_Table_Layout::WORD_ROWS] = glyph_count * bytes_per_glyph;
+    }
+    pfb__row_layout(font->char_px_width, font->char_px_height, 0, 0, &bytes_per_line, &bytes_per_glyph);
+    choice.layout_bytes[(u32)Pixel_Font_Table_Layout::PACKED] = glyph_count * bytes_per_glyph;
+
+    for (u32 i = 0; i < (u32)Pixel_Font_Table_Layout::COUNT; ++i)
+        choice.fits[i] = choice.layout_bytes[i] != 0 && choice.layout_bytes[i] <= budget_bytes;
+
+    // NOTE: The layouts are in order of access cost.
+    choice.chosen = Pixel_Font_Table_Layout::COUNT;
+    for (u32 i = 0; i < (u32)Pixel_Font_Table_Layout::COUNT; ++i) {
+        if (!choice.fits[i])
+            continue;
+        if (choice.chosen == Pixel_Font_Table_Layout::COUNT ||
+            (preference == Pixel_Font_Layout_Preference::SMALLEST &&
+             choice.layout_bytes[i] < choice.layout_bytes[(u32)choice.chosen]))
+        {
+            choice.chosen = (Pixel_Font_Table_Layout)i;
+        }
+    }
+
+    for (u32 i = 0; i < (u32)Pixel_Font_Table_Layout::COUNT; ++i) {
+        log_debug("layout %-12s %12llu bytes%s%s", pixel_font_table_layout_to_string((Pixel_Font_Table_Layout)i),
+                  (unsigned long long)choice.layout_bytes[i], choice.fits[i] ? ", fits" : "",
+                  i == (u32)choice.chosen ? ", chosen" : "");
+    }
+
+    *out_choice = choice;
+    return choice.chosen == Pixel_Font_Table_Layout::COUNT
+        ? Pixel_Font_Baker_Error::TABLE_OVER_BUDGET
+        : Pixel_Font_Baker_Error::SUCCESS;
+}
+
+Pixel_Font_Table_Pages pixel_font_table_pages(const Pixel_Font* font) {
+    if (!font->table || font->table_is_borrowed)
+        return Pixel_Font_Table_Pages::DEFAULT;
+    return (Pixel_Font_Table_Pages)((const pfb__Table_Header*)font->table - 1)->pages;
+}
+
+void destroy_pixel_font(Pixel_Font* font) {
+    if (!font->table_is_borrowed)
+        pfb__deallocate_table(font->table);
+    font->table         = nullptr;
+    font->glyph_metrics = nullptr;
+}
+
+const char* pixel_font_baker_error_to_string(Pixel_Font_Baker_Error e) {
+    switch (e) {
+#define ERROR(key) case Pixel_Font_Baker_Error::key: return #key;
+        PIXEL_FONT_BAKER_ERRORS
 #undef ERROR
         default: return "Unkown Pixel_Font_Baker_Error";
     }
 }
 
+const char* pixel_font_table_layout_to_string(Pixel_Font_Table_Layout layout) {
+    switch (layout) {
+#define LAYOUT(key) case Pixel_Font_Table_Layout::key: return #key;
+        PIXEL_FONT_TABLE_LAYOUTS
+#undef LAYOUT
+        default: return "UNKNOWN";
+    }
+}
+
+const char* pixel_font_allocation_stage_to_string(Pixel_Font_Allocation_Stage stage) {
+    switch (stage) {
+#define STAGE(key) case Pixel_Font_Allocation_Stage::key: return #key;
+        PIXEL_FONT_ALLOCATION_STAGES
+#undef STAGE
+        default: return "Unknown Pixel_Font_Allocation_Stage";
+    }
+}
+
 #undef min
 #undef max
 #endif
@@ -0,0 +1,537 @@
+/*
+ * Batch baker: bakes all jobs listed in a manifest file in parallel.
+ *
+ * Build (ftb has to be on the include path):
+ *
+ *   c++ -O2 -std=c++17 -I.. -I<dir containing ftb> pixel_font_bake.cpp -o pixel_font_bake -lpthread
+ *
+ * Manifest: one job per line, '#' starts a comment. Every job is a list of
+ * key=value pairs:
+ *
+ *   out=build/mono16.pxft font=fonts/mono.ttf size=16 range=0x20-0x7e
+ *   out=build/mono16.c    font=fonts/mono.ttf size=16 range=0x20-0x7e format=c name=Mono16
+ *   out=build/sans12.h    font=fonts/sans.ttf size=12 range=0x20-0x7e format=gfx name=Sans12
+ *   out=build/tom.pxft    font=fonts/tom-thumb.bdf range=0x20-0x7e
+ *
+ *   out          output path (required)
+ *   font         .ttf or .bdf source (required)
+ *   size         char height in px (required for ttf)
+ *   range        first-last codepoint, decimal or 0x hex (default 0x20-0x7e)
+ *   threshold    gray threshold for ttf (default 128)
+ *   supersample  oversampling for ttf (default 1)
+ *   format       pxft (baked font file), c (Waveshare style C source) or gfx
+ *                (proportional Adafruit GFX font), defaults to c for .c/.h
+ *                outputs and pxft otherwise
+ *   name         table/sFONT/GFXfont name for format=c and gfx and the name
+ *                in a bundle
+ *                (default: output file name)
+ *   style        style number in a bundle (default 0)
+ *   budget       table budget in bytes for format=pxft: the glyphs are
+ *                stored in word rows or packed, whichever is faster (or
+ *                smaller with prefer=small) and fits, the job fails if
+ *                neither does
+ *   prefer       fast (default) or small
+ *   bitmaps      yes (default) copies the glyphs of an embedded bitmap strike
+ *                of the requested size instead of rasterizing them, no
+ *                always rasterizes (ttf only)
+ *   metrics      yes also bakes the advance and ink box of every glyph into
+ *                pxft outputs (and bundles) and format=c, no (default) does
+ *                not
+ *   raster       float rasterizes ttf outlines with stb_truetype, fixed with
+ *                the integer rasterizer (the default follows
+ *                PIXEL_FONT_BAKER_FIXED_POINT)
+ *   strip        bytes of scratch per rasterized strip, glyphs with a larger
+ *                (oversampled) gray bitmap are rasterized in strips, 0
+ *                (default) rasterizes whole glyphs (ttf only)
+ *
+ * Jobs whose output is newer than both the font and the manifest are
+ * skipped, unless -f is given.
+ *
+ * With -b all pxft outputs are also written into one font bundle, keyed by
+ * name, size (the char height for bdf jobs) and style.
+ */
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#define PIXEL_FONT_BAKER_IMPL
+#include "../pixel_font_baker.hpp"
+
+#include <sys/stat.h>
+#include <atomic>
+#include <initializer_list>
+#include <chrono>
+#include <thread>
+
+enum struct Output_Format {
+    PXFT,
+    C_SOURCE,
+    ADAFRUIT_GFX,
+};
+
+enum struct Job_Status {
+    BAKED,
+    UP_TO_DATE,
+    FAILED,
+};
+
+struct Bake_Job {
+    u32  line;
+    char out_path[512];
+    char font_path[512];
+    char name[128];
+    u32  size;
+    u32  cp_start;
+    u32  cp_end;
+    u32  threshold;
+    u32  supersample;
+    u32  style;
+    u64  budget;
+    Pixel_Font_Layout_Preference preference;
+    bool embedded_bitmaps;
+    bool glyph_metrics;
+    bool fixed_point_rasterizer;
+    u32  strip_bytes;
+    Output_Format format;
+
+    Job_Status status;
+    Pixel_Font_Baker_Error error;
+    Pixel_Font_Layout_Choice layout;
+    f64 seconds;
+};
+
+static bool ends_with(const char* str, const char* suffix) {
+    size_t str_length    = strlen(str);
+    size_t suffix_length = strlen(suffix);
+    return str_length >= suffix_length && strcmp(str + str_length - suffix_length, suffix) == 0;
+}
+
+static bool modification_time(const char* path, s64* out_time) {
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    *out_time = (s64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+static bool parse_range(const char* value, u32* out_start, u32* out_end) {
+    char* rest;
+    *out_start = (u32)strtoul(value, &rest, 0);
+    if (*rest != '-')
+        return false;
+    *out_end = (u32)strtoul(rest + 1, &rest, 0);
+    return *rest == '\0' && *out_start <= *out_end;
+}
+
+static bool parse_job(char* line, u32 line_number, Bake_Job* job) {
+    *job = {};
+    job->line        = line_number;
+    job->cp_start    = 0x20;
+    job->cp_end      = 0x7e;
+    job->threshold   = 128;
+    job->supersample = 1;
+    job->embedded_bitmaps = true;
+    job->fixed_point_rasterizer = Pixel_Font_Bake_Options().fixed_point_rasterizer;
+
+    bool format_given = false;
+
+    for (char* token = strtok(line, " \t\r\n"); token; token = strtok(nullptr, " \t\r\n")) {
+        char* value = strchr(token, '=');
+        if (!value) {
+            fprintf(stderr, "manifest:%u: expected key=value, got '%s'\n", line_number, token);
+            return false;
+        }
+        *value++ = '\0';
+
+        bool ok = true;
+        if      (strcmp(token, "out")  == 0) snprintf(job->out_path,  sizeof(job->out_path),  "%s", value);
+        else if (strcmp(token, "font") == 0) snprintf(job->font_path, sizeof(job->font_path), "%s", value);
+        else if (strcmp(token, "name") == 0) snprintf(job->name,      sizeof(job->name),      "%s", value);
+        else if (strcmp(token, "size")        == 0) job->size        = (u32)strtoul(value, nullptr, 0);
+        else if (strcmp(token, "threshold")   == 0) job->threshold   = (u32)strtoul(value, nullptr, 0);
+        else if (strcmp(token, "supersample") == 0) job->supersample = (u32)strtoul(value, nullptr, 0);
+        else if (strcmp(token, "style")       == 0) job->style       = (u32)strtoul(value, nullptr, 0);
+        else if (strcmp(token, "strip")       == 0) job->strip_bytes = (u32)strtoul(value, nullptr, 0);
+        else if (strcmp(token, "range")       == 0) ok = parse_range(value, &job->cp_start, &job->cp_end);
+        else if (strcmp(token, "budget")      == 0) ok = (job->budget = strtoull(value, nullptr, 0)) != 0;
+        else if (strcmp(token, "prefer")      == 0) {
+            if      (strcmp(value, "fast")  == 0) job->preference = Pixel_Font_Layout_Preference::FASTEST;
+            else if (strcmp(value, "small") == 0) job->preference = Pixel_Font_Layout_Preference::SMALLEST;
+            else ok = false;
+        }
+        else if (strcmp(token, "bitmaps")     == 0) {
+            if      (strcmp(value, "yes") == 0) job->embedded_bitmaps = true;
+            else if (strcmp(value, "no")  == 0) job->embedded_bitmaps = false;
+            else ok = false;
+        }
+        else if (strcmp(token, "metrics")     == 0) {
+            if      (strcmp(value, "yes") == 0) job->glyph_metrics = true;
+            else if (strcmp(value, "no")  == 0) job->glyph_metrics = false;
+            else ok = false;
+        }
+        else if (strcmp(token, "raster")      == 0) {
+            if      (strcmp(value, "fixed") == 0) job->fixed_point_rasterizer = true;
+            else if (strcmp(value, "float") == 0) job->fixed_point_rasterizer = false;
+            else ok = false;
+        }
+        else if (strcmp(token, "format")      == 0) {
+            format_given = true;
+            if      (strcmp(value, "pxft") == 0) job->format = Output_Format::PXFT;
+            else if (strcmp(value, "c")    == 0) job->format = Output_Format::C_SOURCE;
+            else if (strcmp(value, "gfx")  == 0) job->format = Output_Format::ADAFRUIT_GFX;
+            else ok = false;
+        } else {
+            fprintf(stderr, "manifest:%u: unknown key '%s'\n", line_number, token);
+            return false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "manifest:%u: invalid value '%s' for '%s'\n", line_number, value, token);
+            return false;
+        }
+    }
+
+    if (!job->out_path[0] || !job->font_path[0]) {
+        fprintf(stderr, "manifest:%u: 'out' and 'font' are required\n", line_number);
+        return false;
+    }
+
+    bool is_ttf = !ends_with(job->font_path, ".bdf");
+    if (is_ttf && (job->size == 0 || job->size > 0xffff)) {
+        fprintf(stderr, "manifest:%u: ttf jobs need a 'size'\n", line_number);
+        return false;
+    }
+    if (job->threshold > 255 || job->supersample == 0 || job->supersample > 255) {
+        fprintf(stderr, "manifest:%u: threshold must be 0-255 and supersample 1-255\n", line_number);
+        return false;
+    }
+    if (job->style > 0xffff) {
+        fprintf(stderr, "manifest:%u: style must be 0-65535\n", line_number);
+        return false;
+    }
+
+    if (!format_given) {
+        job->format = (ends_with(job->out_path, ".c") || ends_with(job->out_path, ".h"))
+            ? Output_Format::C_SOURCE
+            : Output_Format::PXFT;
+    }
+
+    if (job->budget && job->format != Output_Format::PXFT) {
+        fprintf(stderr, "manifest:%u: 'budget' only works with format=pxft\n", line_number);
+        return false;
+    }
+
+    if (!job->name[0]) {
+        // NOTE: default name is the output file name without directory and
+        //   extension, with everything that can't be in a C identifier
+        //   replaced by '_'
+        const char* base = strrchr(job->out_path, '/');
+        base = base ? base + 1 : job->out_path;
+        u32 i = 0;
+        for (; base[i] && base[i] != '.' && i < sizeof(job->name) - 1; ++i) {
+            char c = base[i];
+            bool is_ident = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+            job->name[i] = is_ident ? c : '_';
+        }
+        job->name[i] = '\0';
+    }
+
+    return true;
+}
+
+static void run_job(Bake_Job* job) {
+    bool is_ttf = !ends_with(job->font_path, ".bdf");
+
+    // NOTE: ttf -> pxft streams straight to disk, everything else goes
+    //   through an in-memory Pixel_Font first.
+    if (is_ttf && job->format == Output_Format::PXFT) {
+        Pixel_Font_Bake_Options options;
+        options.embedded_bitmaps       = job->embedded_bitmaps;
+        options.glyph_metrics          = job->glyph_metrics;
+        options.fixed_point_rasterizer = job->fixed_point_rasterizer;
+        options.raster_strip_bytes     = job->strip_bytes;
+        options.table_budget_bytes     = job->budget;
+        options.layout_preference      = job->preference;
+        options.layout_choice          = &job->layout;
+        job->error = bake_pixel_font_file_from_ttf(job->font_path, (u16)job->size,
+                                                   job->cp_start, job->cp_end,
+                                                   (u8)job->threshold, (u8)job->supersample,
+                                                   job->out_path, &options);
+        return;
+    }
+
+    Pixel_Font font = {};
+    Pixel_Font_Bake_Options options;
+    options.embedded_bitmaps       = job->embedded_bitmaps;
+    options.glyph_metrics          = job->glyph_metrics;
+    options.fixed_point_rasterizer = job->fixed_point_rasterizer;
+    options.raster_strip_bytes     = job->strip_bytes;
+    if (is_ttf) {
+        job->error = create_pixel_font_from_ttf(job->font_path, (u16)job->size,
+                                                job->cp_start, job->cp_end,
+                                                (u8)job->threshold, (u8)job->supersample, &font, &options);
+    } else {
+        job->error = create_pixel_font_from_bdf(job->font_path, job->cp_start, job->cp_end, &font, &options);
+        if (job->error == Pixel_Font_Baker_Error::SUCCESS && job->budget) {
+            job->error = choose_pixel_font_layout(&font, job->budget, job->preference, &job->layout);
+            if (job->error == Pixel_Font_Baker_Error::SUCCESS && job->layout.chosen == Pixel_Font_Table_Layout::WORD_ROWS) {
+                Pixel_Font word_rows;
+                u32 word_bytes = font.bytes_per_line <= 1 ? 1 : font.bytes_per_line <= 2 ? 2 : font.bytes_per_line <= 4 ? 4 : 8;
+                job->error = create_pixel_font_with_row_layout(&font, word_bytes, 64, &word_rows);
+                if (job->error == Pixel_Font_Baker_Error::SUCCESS) {
+                    destroy_pixel_font(&font);
+                    font = word_rows;
+                }
+            }
+        }
+    }
+
+    if (job->error != Pixel_Font_Baker_Error::SUCCESS) {
+        destroy_pixel_font(&font);
+        return;
+    }
+
+    if (job->format == Output_Format::PXFT) {
+        job->error = save_pixel_font(&font, job->out_path);
+    } else if (job->format == Output_Format::C_SOURCE) {
+        job->error = write_pixel_font_as_c_source(&font, job->name, job->out_path);
+    } else {
+        Pixel_Font_Gfx_Metrics metrics;
+        job->error = is_ttf
+            ? pixel_font_gfx_metrics_from_ttf(job->font_path, (u16)job->size, &font, &metrics)
+            : pixel_font_gfx_metrics_from_bdf(job->font_path, &font, &metrics);
+        if (job->error == Pixel_Font_Baker_Error::SUCCESS) {
+            job->error = write_pixel_font_as_adafruit_gfx(&font, &metrics, job->name, job->out_path);
+            destroy_pixel_font_gfx_metrics(&metrics);
+        }
+    }
+
+    destroy_pixel_font(&font);
+}
+
+// NOTE: Loads the pxft outputs of all jobs back in and writes them as one
+//   bundle.
+static Pixel_Font_Baker_Error write_bundle(const Bake_Job* jobs, u32 job_count, const char* bundle_path) {
+    Pixel_Font*             fonts   = (Pixel_Font*)calloc(job_count + 1, sizeof(Pixel_Font));
+    Pixel_Font_Bundle_Font* entries = (Pixel_Font_Bundle_Font*)calloc(job_count + 1, sizeof(Pixel_Font_Bundle_Font));
+    u32 entry_count = 0;
+
+    Pixel_Font_Baker_Error error = Pixel_Font_Baker_Error::SUCCESS;
+    if (!fonts || !entries)
+        error = Pixel_Font_Baker_Error::MALLOC_FAILED;
+
+    for (u32 i = 0; i < job_count && error == Pixel_Font_Baker_Error::SUCCESS; ++i) {
+        const Bake_Job* job = &jobs[i];
+        if (job->format != Output_Format::PXFT)
+            continue;
+
+        error = load_pixel_font(job->out_path, &fonts[entry_count]);
+        if (error != Pixel_Font_Baker_Error::SUCCESS) {
+            fprintf(stderr, "bundle: could not load '%s'\n", job->out_path);
+            break;
+        }
+
+        entries[entry_count].name  = job->name;
+        entries[entry_count].size  = (u16)(job->size ? job->size : fonts[entry_count].char_px_height);
+        entries[entry_count].style = (u16)job->style;
+        entries[entry_count].font  = &fonts[entry_count];
+        ++entry_count;
+    }
+
+    if (error == Pixel_Font_Baker_Error::SUCCESS)
+        error = write_pixel_font_bundle(entries, entry_count, bundle_path);
+
+    for (u32 i = 0; i < entry_count; ++i)
+        destroy_pixel_font(&fonts[i]);
+    free(fonts);
+    free(entries);
+
+    return error;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s [-j threads] [-f] [-s summary_path] [-b bundle_path] manifest\n"
+            "  -j  number of jobs to bake in parallel (default: number of cores)\n"
+            "  -f  bake all jobs, even if their outputs are up to date\n"
+            "  -s  also write the timing summary to this file\n"
+            "  -b  also write all pxft outputs into this font bundle\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    u32 thread_count = std::thread::hardware_concurrency();
+    bool force = false;
+    const char* summary_path  = nullptr;
+    const char* bundle_path   = nullptr;
+    const char* manifest_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = (u32)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            force = true;
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            summary_path = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bundle_path = argv[++i];
+        } else if (argv[i][0] != '-' && !manifest_path) {
+            manifest_path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!manifest_path) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (thread_count == 0)
+        thread_count = 1;
+
+    FILE* manifest = fopen(manifest_path, "rb");
+    if (!manifest) {
+        fprintf(stderr, "could not open manifest '%s'\n", manifest_path);
+        return 2;
+    }
+
+    Bake_Job* jobs = nullptr;
+    u32 job_count  = 0;
+    {
+        char line[4096];
+        u32 line_number = 0;
+        bool manifest_ok = true;
+        while (fgets(line, sizeof(line), manifest)) {
+            ++line_number;
+            if (char* comment = strchr(line, '#'))
+                *comment = '\0';
+            if (strspn(line, " \t\r\n") == strlen(line))
+                continue;
+
+            jobs = (Bake_Job*)realloc(jobs, (job_count + 1) * sizeof(Bake_Job));
+            if (parse_job(line, line_number, &jobs[job_count]))
+                ++job_count;
+            else
+                manifest_ok = false;
+        }
+        fclose(manifest);
+
+        if (!manifest_ok) {
+            free(jobs);
+            return 2;
+        }
+    }
+
+    s64 manifest_time = 0;
+    modification_time(manifest_path, &manifest_time);
+
+    std::atomic<u32> next_job(0);
+    auto worker = [&]() {
+        for (u32 i = next_job++; i < job_count; i = next_job++) {
+            Bake_Job* job = &jobs[i];
+
+            s64 out_time, font_time;
+            if (!force &&
+                modification_time(job->out_path,  &out_time) &&
+                modification_time(job->font_path, &font_time) &&
+                out_time >= font_time && out_time >= manifest_time)
+            {
+                job->status = Job_Status::UP_TO_DATE;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            // NOTE: a failed job leaves the previous output as it was, the
+            //   writers only replace it once the new one is complete
+            run_job(job);
+            job->seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+            job->status  = job->error == Pixel_Font_Baker_Error::SUCCESS
+                ? Job_Status::BAKED
+                : Job_Status::FAILED;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        thread_count = job_count < thread_count ? (job_count ? job_count : 1) : thread_count;
+        std::thread* threads = new std::thread[thread_count];
+        for (u32 t = 0; t < thread_count; ++t)
+            threads[t] = std::thread(worker);
+        for (u32 t = 0; t < thread_count; ++t)
+            threads[t].join();
+        delete[] threads;
+    }
+    f64 total_seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    FILE* summary = summary_path ? fopen(summary_path, "wb") : nullptr;
+    if (summary_path && !summary)
+        fprintf(stderr, "could not open summary file '%s'\n", summary_path);
+
+    u32 baked = 0, up_to_date = 0, failed = 0;
+    for (FILE* out : {stdout, summary}) {
+        if (!out)
+            continue;
+        fprintf(out, "%-10s %9s  %s\n", "status", "seconds", "output");
+        for (u32 i = 0; i < job_count; ++i) {
+            const Bake_Job* job = &jobs[i];
+            switch (job->status) {
+                case Job_Status::BAKED:
+                    if (job->budget) {
+                        fprintf(out, "%-10s %9.3f  %s (%s, %llu bytes)\n", "baked", job->seconds, job->out_path,
+                                pixel_font_table_layout_to_string(job->layout.chosen),
+                                (unsigned long long)job->layout.layout_bytes[(u32)job->layout.chosen]);
+                    } else {
+                        fprintf(out, "%-10s %9.3f  %s\n", "baked", job->seconds, job->out_path);
+                    }
+                    break;
+                case Job_Status::UP_TO_DATE:
+                    fprintf(out, "%-10s %9s  %s\n", "up-to-date", "-", job->out_path);
+                    break;
+                case Job_Status::FAILED:
+                    fprintf(out, "%-10s %9.3f  %s (manifest:%u: %s)\n", "FAILED", job->seconds,
+                            job->out_path, job->line, pixel_font_baker_error_to_string(job->error));
+                    // NOTE: the sizes of both layouts, so the budget can be
+                    //   adjusted
+                    if (job->error == Pixel_Font_Baker_Error::TABLE_OVER_BUDGET) {
+                        for (u32 l = 0; l < (u32)Pixel_Font_Table_Layout::COUNT; ++l) {
+                            fprintf(out, "%-10s %9s    %-12s %12llu bytes\n", "", "",
+                                    pixel_font_table_layout_to_string((Pixel_Font_Table_Layout)l),
+                                    (unsigned long long)job->layout.layout_bytes[l]);
+                        }
+                    }
+                    break;
+            }
+        }
+    }
+
+    for (u32 i = 0; i < job_count; ++i) {
+        switch (jobs[i].status) {
+            case Job_Status::BAKED:      ++baked;      break;
+            case Job_Status::UP_TO_DATE: ++up_to_date; break;
+            case Job_Status::FAILED:     ++failed;     break;
+        }
+    }
+
+    for (FILE* out : {stdout, summary}) {
+        if (!out)
+            continue;
+        fprintf(out, "%u baked, %u up to date, %u failed in %.3fs on %u threads\n",
+                baked, up_to_date, failed, total_seconds, thread_count);
+    }
+
+    if (summary)
+        fclose(summary);
+
+    // NOTE: the bundle is always rewritten, it is cheap compared to baking
+    if (bundle_path && !failed) {
+        Pixel_Font_Baker_Error error = write_bundle(jobs, job_count, bundle_path);
+        if (error != Pixel_Font_Baker_Error::SUCCESS) {
+            fprintf(stderr, "bundle '%s': %s\n", bundle_path, pixel_font_baker_error_to_string(error));
+            failed = 1;
+        } else {
+            printf("wrote bundle %s\n", bundle_path);
+        }
+    }
+
+    free(jobs);
+
+    return failed ? 1 : 0;
+}